@@ -6,10 +6,26 @@ def can_build(env, platform):
 def configure(env):
     pass
 
+def get_opts(platform):
+    from SCons.Variables import EnumVariable
+
+    return [
+        EnumVariable(
+            "sqlite_profile",
+            "SQLite compile options: 'default', or 'performance' to drop the bookkeeping not used by this module",
+            "default",
+            ("default", "performance"),
+        ),
+    ]
+
 def get_doc_classes():
     return [
         "SQLite",
         "SQLiteQuery",
+        "SQLiteSession",
+        "SQLiteBackup",
+        "SQLiteCompiledScript",
+        "SQLiteCArray",
     ]
 
 def get_doc_path():
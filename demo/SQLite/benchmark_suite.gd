@@ -0,0 +1,614 @@
+# Benchmarks of the module, written as JSON and compared against a baseline.
+# godot --headless --path demo -s res://SQLite/benchmark_suite.gd -- --output=after.json --baseline=before.json
+#
+# Options:
+#   --filter=lookup      only runs the cases whose name contains "lookup"
+#   --rows=100000        rows of the scan and insert tables
+#   --repeat=7           runs of each case, the median is reported
+#   --output=path.json   writes the results
+#   --baseline=path.json compares against previous results; exits with code 1
+#                        when a case is slower than the baseline by more
+#                        than --tolerance (default 0.1, so 10%)
+extends SceneTree
+
+const DB_PATH = "user://benchmark_suite.db"
+const ENCRYPTED_PATH = "user://benchmark_suite_encrypted.db"
+const CSV_PATH = "user://benchmark_suite.csv"
+const MIGRATION_PATH = "user://benchmark_suite_migration.db"
+const SEED_ITEMS = 500
+const MAPPED_SCANS = 8
+const LOOKUPS = 10000
+const BLOB_SIZE = 64 * 1024
+const BLOB_COUNT = 256
+const TEXT_ROWS = 20000
+const SCRIPT_RUNS = 1000
+# A per tick maintenance script, which leaves the tables unchanged.
+const MAINTENANCE_SCRIPT = """
+	UPDATE players SET score = score + 1 WHERE id = 1;
+	UPDATE players SET score = score - 1 WHERE id = 1;
+	DELETE FROM blobs WHERE id < 0;
+	SELECT count(*) FROM players WHERE id < 100;
+"""
+
+var rows = 100000
+var repeat = 7
+var filter = ""
+var output_path = ""
+var baseline_path = ""
+var tolerance = 0.1
+
+var db = null
+var rng = RandomNumberGenerator.new()
+
+
+class Player:
+	var id = 0
+	var name = ""
+	var score = 0
+	var ratio = 0.0
+
+
+func _init():
+	for arg in OS.get_cmdline_args():
+		if arg.begins_with("--rows="):
+			rows = arg.trim_prefix("--rows=").to_int()
+		elif arg.begins_with("--repeat="):
+			repeat = max(1, arg.trim_prefix("--repeat=").to_int())
+		elif arg.begins_with("--filter="):
+			filter = arg.trim_prefix("--filter=")
+		elif arg.begins_with("--output="):
+			output_path = arg.trim_prefix("--output=")
+		elif arg.begins_with("--baseline="):
+			baseline_path = arg.trim_prefix("--baseline=")
+		elif arg.begins_with("--tolerance="):
+			tolerance = arg.trim_prefix("--tolerance=").to_float()
+
+	create_database()
+
+	var results = {}
+	# Each case returns the number of operations it did, it's called `repeat`
+	# times after a warm up run.
+	for name in [
+		"open_file",
+		"open_buffered",
+		"open_async_warm_up",
+		"lookup_fetch_assoc_with_args",
+		"lookup_query_execute",
+		"lookup_hot_uncached",
+		"lookup_hot_cached",
+		"insert_batch_execute",
+		"upsert_dictionaries",
+		"upsert_query_with_args",
+		"script_execute_script",
+		"script_compiled_run",
+		"script_query_per_statement",
+		"scan_query_execute",
+		"scan_fetch_array",
+		"scan_fetch_assoc",
+		"scan_integers",
+		"ids_execute_column",
+		"ids_fetch_array",
+		"scalar_execute_scalar",
+		"scalar_fetch_array",
+		"scan_reals",
+		"scan_into_objects",
+		"scan_fetch_assoc_to_objects",
+		"json_execute",
+		"json_execute_columnar",
+		"json_fetch_assoc_stringify",
+		"csv_export",
+		"csv_import",
+		"csv_import_single_thread",
+		"blob_write",
+		"blob_read",
+		"text_decode",
+		"cold_scan_plain",
+		"cold_scan_encrypted",
+		"page_scan_read",
+		"page_scan_mmap",
+		"page_scan_mmap_prefault",
+		"insert_encrypted",
+		"migrate",
+		"migrate_query_per_statement",
+	]:
+		if filter != "" and name.find(filter) == -1:
+			continue
+		results[name] = measure(name)
+		print("%-30s %10.3f ms %14.0f ops/s" % [name, results[name]["median_usec"] / 1000.0, results[name]["ops_per_sec"]])
+
+	var report = {
+		"engine": Engine.get_version_info()["string"],
+		"os": OS.get_name(),
+		"processor": OS.get_processor_name(),
+		"rows": rows,
+		"repeat": repeat,
+		"results": results,
+	}
+	if output_path != "":
+		write_json(output_path, report)
+
+	var exit_code = 0
+	if baseline_path != "":
+		exit_code = compare(results, read_json(baseline_path))
+	quit(exit_code)
+
+
+func measure(name):
+	rng.seed = 1234
+	call(name)
+	var times = []
+	var operations = 0
+	for i in repeat:
+		rng.seed = 1234
+		var start = Time.get_ticks_usec()
+		operations = call(name)
+		times.push_back(Time.get_ticks_usec() - start)
+	times.sort()
+	var median = times[times.size() / 2]
+	return {
+		"median_usec": median,
+		"min_usec": times[0],
+		"operations": operations,
+		"ops_per_sec": operations * 1000000.0 / max(median, 1),
+	}
+
+
+func compare(results, baseline):
+	if baseline == null or not baseline.has("results"):
+		printerr("Cannot read the baseline: ", baseline_path)
+		return 1
+	print("\nAgainst %s (tolerance %d%%):" % [baseline_path, tolerance * 100])
+	var regressions = 0
+	for name in results:
+		if not baseline["results"].has(name):
+			print("%-30s new" % name)
+			continue
+		var before = float(baseline["results"][name]["median_usec"])
+		var after = float(results[name]["median_usec"])
+		var change = after / max(before, 1.0) - 1.0
+		var status = "ok"
+		if change > tolerance:
+			status = "REGRESSION"
+			regressions += 1
+		elif change < -tolerance:
+			status = "faster"
+		print("%-30s %+7.1f%% %s" % [name, change * 100.0, status])
+	return 1 if regressions > 0 else 0
+
+
+func create_database():
+	var dir = Directory.new()
+	for path in [DB_PATH, ENCRYPTED_PATH, CSV_PATH, MIGRATION_PATH]:
+		if dir.file_exists(path):
+			dir.remove(path)
+
+	db = SQLite.new()
+	db.open(DB_PATH)
+	db.query("CREATE TABLE players (id INTEGER PRIMARY KEY, name TEXT NOT NULL, score INTEGER NOT NULL, ratio REAL NOT NULL);")
+	db.query("CREATE TABLE blobs (id INTEGER PRIMARY KEY, data BLOB NOT NULL);")
+	db.query("CREATE TABLE texts (id INTEGER PRIMARY KEY, body TEXT NOT NULL);")
+	db.query("CREATE TABLE integers (a INTEGER, b INTEGER, c INTEGER, d INTEGER);")
+	db.query("CREATE TABLE reals (a REAL, b REAL, c REAL, d REAL);")
+
+	rng.seed = 1234
+	var insert = db.create_query("INSERT INTO players (name, score, ratio) VALUES (?, ?, ?);")
+	db.query("BEGIN;")
+	insert.batch_execute(player_rows(rows))
+	db.query("INSERT INTO integers SELECT id, score, score / 2, id * 3 FROM players;")
+	db.query("INSERT INTO reals SELECT ratio, ratio * 2, ratio / 3, score * 0.5 FROM players;")
+	db.query("COMMIT;")
+
+	# Mixed scripts, so the text isn't only ASCII.
+	var words = ["sword", "épée", "меч", "剣", "schwert", "ξίφος"]
+	var texts = []
+	for i in TEXT_ROWS:
+		var body = ""
+		for w in 32:
+			body += words[rng.randi() % words.size()] + " "
+		texts.push_back([body])
+	db.query("BEGIN;")
+	db.create_query("INSERT INTO texts (body) VALUES (?);").batch_execute(texts)
+	db.query("COMMIT;")
+	blob_write()
+
+	var encrypted = SQLite.new()
+	encrypted.open_encrypted(ENCRYPTED_PATH, encryption_key())
+	encrypted.backup_from(db).run()
+	encrypted.close()
+	csv_export()
+
+
+func player_rows(count):
+	var result = []
+	for i in count:
+		result.push_back(["player_%d" % i, rng.randi_range(0, 1000000), rng.randf()])
+	return result
+
+
+func open_file():
+	var count = 100
+	for i in count:
+		var other = SQLite.new()
+		other.open(DB_PATH)
+		other.fetch_array("SELECT count(*) FROM sqlite_master;")
+		other.close()
+	return count
+
+
+func open_buffered():
+	var file = File.new()
+	file.open(DB_PATH, File.READ)
+	var buffer = file.get_buffer(file.get_length())
+	file.close()
+	var count = 10
+	for i in count:
+		var other = SQLite.new()
+		other.open_buffered("benchmark_suite", buffer, buffer.size())
+		other.fetch_array("SELECT count(*) FROM sqlite_master;")
+		other.close()
+	return count
+
+
+# Opened, warmed up and its lookup prepared on a thread, ready for the game.
+func open_async_warm_up():
+	var other = SQLite.new()
+	var lookup = other.create_query("SELECT * FROM players WHERE id = ?;")
+	other.open_async(DB_PATH, {"warm_up": ["players", "blobs"], "prepare_queries": true})
+	other.wait_open()
+	lookup.execute([1])
+	other.close()
+	return 1
+
+
+func lookup_fetch_assoc_with_args():
+	for i in LOOKUPS:
+		db.fetch_assoc_with_args("SELECT name, score FROM players WHERE id = ?;", [rng.randi_range(1, rows)])
+	return LOOKUPS
+
+
+func lookup_query_execute():
+	var query = db.create_query("SELECT name, score FROM players WHERE id = ?;")
+	for i in LOOKUPS:
+		query.execute([rng.randi_range(1, rows)])
+	return LOOKUPS
+
+
+# Lookups of a few rows read again and again, the result cache case.
+func lookup_hot(cached):
+	var query = db.create_query("SELECT name, score FROM players WHERE id = ?;")
+	query.cache_results = cached
+	for i in LOOKUPS:
+		query.execute([rng.randi_range(1, 100)])
+	return LOOKUPS
+
+
+func lookup_hot_uncached():
+	return lookup_hot(false)
+
+
+func lookup_hot_cached():
+	return lookup_hot(true)
+
+
+func insert_batch_execute():
+	var data = player_rows(rows / 10)
+	var insert = db.create_query("INSERT INTO players (name, score, ratio) VALUES (?, ?, ?);")
+	db.query("BEGIN;")
+	insert.batch_execute(data)
+	# Keeps the table at the same size between the runs.
+	db.query("ROLLBACK;")
+	return data.size()
+
+
+# Entity states, half of them updating existing players.
+func player_states():
+	var states = []
+	for i in rows / 10:
+		states.push_back({"id": rng.randi_range(1, rows * 3 / 2), "name": "player_%d" % i, "score": rng.randi_range(0, 1000000), "ratio": rng.randf()})
+	return states
+
+
+func upsert_dictionaries():
+	var states = player_states()
+	db.query("BEGIN;")
+	db.upsert("players", states, ["id"])
+	db.query("ROLLBACK;")
+	return states.size()
+
+
+# The SQL built in GDScript for each entity, as without upsert().
+func upsert_query_with_args():
+	var states = player_states()
+	db.query("BEGIN;")
+	for state in states:
+		var columns = PackedStringArray(state.keys())
+		var placeholders = PackedStringArray()
+		var updates = PackedStringArray()
+		for column in columns:
+			placeholders.push_back("?")
+			if column != "id":
+				updates.push_back("%s = excluded.%s" % [column, column])
+		var sql = "INSERT INTO players (%s) VALUES (%s) ON CONFLICT (id) DO UPDATE SET %s;" % [", ".join(columns), ", ".join(placeholders), ", ".join(updates)]
+		db.query_with_args(sql, state.values())
+	db.query("ROLLBACK;")
+	return states.size()
+
+
+func script_execute_script():
+	for i in SCRIPT_RUNS:
+		db.execute_script(MAINTENANCE_SCRIPT)
+	return SCRIPT_RUNS
+
+
+func script_compiled_run():
+	var script = db.compile_script(MAINTENANCE_SCRIPT)
+	for i in SCRIPT_RUNS:
+		script.run()
+	return SCRIPT_RUNS
+
+
+# The statements sent one at a time, as without scripts.
+func script_query_per_statement():
+	var statements = []
+	for statement in MAINTENANCE_SCRIPT.split(";", false):
+		if not statement.strip_edges().is_empty():
+			statements.push_back(statement)
+	for i in SCRIPT_RUNS:
+		db.query("SAVEPOINT script;")
+		for statement in statements:
+			db.query(statement)
+		db.query("RELEASE script;")
+	return SCRIPT_RUNS
+
+
+func scan_query_execute():
+	return db.create_query("SELECT * FROM players;").execute().size()
+
+
+func scan_fetch_array():
+	return db.fetch_array("SELECT * FROM players;").size()
+
+
+func scan_fetch_assoc():
+	return db.fetch_assoc("SELECT * FROM players;").size()
+
+
+func scan_into_objects():
+	return db.create_query("SELECT * FROM players;").execute_into_objects(Player).size()
+
+
+# What `scan_into_objects` replaces.
+func scan_fetch_assoc_to_objects():
+	var players = []
+	for row in db.fetch_assoc("SELECT * FROM players;"):
+		var player = Player.new()
+		for key in row:
+			player.set(key, row[key])
+		players.push_back(player)
+	return players.size()
+
+
+func json_execute():
+	db.create_query("SELECT * FROM players;").execute_json_bytes()
+	return rows
+
+
+func json_execute_columnar():
+	db.create_query("SELECT * FROM players;").execute_json_bytes([], true)
+	return rows
+
+
+# What `json_execute` replaces.
+func json_fetch_assoc_stringify():
+	JSON.new().stringify(db.fetch_assoc("SELECT * FROM players;"))
+	return rows
+
+
+func csv_export():
+	return db.export_csv("SELECT * FROM players;", [], CSV_PATH)
+
+
+func csv_import_with(options):
+	db.query("DROP TABLE IF EXISTS players_csv;")
+	var count = db.import_csv(CSV_PATH, "players_csv", options)
+	db.query("DROP TABLE players_csv;")
+	return count
+
+
+func csv_import():
+	return csv_import_with({})
+
+
+func csv_import_single_thread():
+	return csv_import_with({"threads": 1})
+
+
+func scan_integers():
+	return db.create_query("SELECT * FROM integers;").execute().size()
+
+
+func scan_reals():
+	return db.create_query("SELECT * FROM reals;").execute().size()
+
+
+func ids_execute_column():
+	return db.create_query("SELECT id FROM players;").execute_column().size()
+
+
+# What `ids_execute_column` replaces.
+func ids_fetch_array():
+	var ids = []
+	for row in db.fetch_array("SELECT id FROM players;"):
+		ids.push_back(row["id"])
+	return ids.size()
+
+
+func scalar_execute_scalar():
+	var query = db.create_query("SELECT score FROM players WHERE id = ?;")
+	var total = 0
+	for i in LOOKUPS:
+		total += query.execute_scalar([rng.randi_range(1, rows)])
+	return LOOKUPS
+
+
+# What `scalar_execute_scalar` replaces.
+func scalar_fetch_array():
+	var total = 0
+	for i in LOOKUPS:
+		total += db.fetch_array_with_args("SELECT score FROM players WHERE id = ?;", [rng.randi_range(1, rows)])[0]["score"]
+	return LOOKUPS
+
+
+func blob_write():
+	var blob = PackedByteArray()
+	blob.resize(BLOB_SIZE)
+	for i in BLOB_SIZE:
+		blob[i] = rng.randi() % 256
+	var data = []
+	for i in BLOB_COUNT:
+		data.push_back([i + 1, blob])
+	db.query("BEGIN;")
+	db.create_query("INSERT OR REPLACE INTO blobs (id, data) VALUES (?, ?);").batch_execute(data)
+	db.query("COMMIT;")
+	return BLOB_COUNT
+
+
+func blob_read():
+	var bytes = 0
+	for row in db.create_query("SELECT data FROM blobs;").execute():
+		bytes += row[0].size()
+	return bytes / BLOB_SIZE
+
+
+func text_decode():
+	return db.create_query("SELECT body FROM texts;").execute().size()
+
+
+func encryption_key():
+	var key = PackedByteArray()
+	key.resize(32)
+	for i in key.size():
+		key[i] = i
+	return key
+
+
+# Fresh connections, so every page is read from the file (and decrypted).
+func cold_scan(path, encrypted):
+	var other = SQLite.new()
+	if encrypted:
+		other.open_encrypted(path, encryption_key())
+	else:
+		other.open(path)
+	var count = other.create_query("SELECT * FROM players;").execute().size()
+	other.close()
+	return count
+
+
+func cold_scan_plain():
+	return cold_scan(DB_PATH, false)
+
+
+func cold_scan_encrypted():
+	return cold_scan(ENCRYPTED_PATH, true)
+
+
+# Aggregates touch every page with little work per row, so the cost of
+# getting the pages dominates: read() and a copy into the page cache, or a
+# memory mapped access.
+func page_scan(options):
+	var other = SQLite.new()
+	other.open_with_options(DB_PATH, options)
+	var scan = other.create_query("SELECT sum(length(name)), sum(score), sum(ratio) FROM players;")
+	for i in MAPPED_SCANS:
+		scan.execute()
+	other.close()
+	return MAPPED_SCANS
+
+
+func page_scan_read():
+	return page_scan({"mmap_size": 0})
+
+
+func page_scan_mmap():
+	return page_scan({"mmap_size": 1 << 30})
+
+
+func page_scan_mmap_prefault():
+	return page_scan({"mmap_size": 1 << 30, "prefault": true})
+
+
+func insert_encrypted():
+	var other = SQLite.new()
+	other.open_encrypted(ENCRYPTED_PATH, encryption_key())
+	var data = player_rows(rows / 10)
+	var insert = other.create_query("INSERT INTO players (name, score, ratio) VALUES (?, ?, ?);")
+	other.query("BEGIN;")
+	insert.batch_execute(data)
+	other.query("ROLLBACK;")
+	other.close()
+	return data.size()
+
+
+# Schema of a save database, from an empty file, with its seed data inserted
+# one statement at a time as written by hand.
+func migrations():
+	var seed_items = ""
+	for i in SEED_ITEMS:
+		seed_items += "INSERT INTO items (name, price) VALUES ('item_%d', %d);\n" % [i, i * 10]
+	return [
+		"CREATE TABLE items (id INTEGER PRIMARY KEY, name TEXT NOT NULL, price INTEGER NOT NULL);",
+		seed_items,
+		"CREATE TABLE inventory (player INTEGER NOT NULL, item INTEGER NOT NULL REFERENCES items (id), count INTEGER NOT NULL);",
+		"ALTER TABLE items ADD COLUMN weight REAL NOT NULL DEFAULT 1.0;\nUPDATE items SET weight = price / 100.0;",
+		"CREATE INDEX inventory_player ON inventory (player);",
+	]
+
+
+func open_migration_database():
+	var dir = Directory.new()
+	if dir.file_exists(MIGRATION_PATH):
+		dir.remove(MIGRATION_PATH)
+	var other = SQLite.new()
+	other.open(MIGRATION_PATH)
+	return other
+
+
+func migrate():
+	var other = open_migration_database()
+	var steps = migrations()
+	other.migrate(steps)
+	other.close()
+	return steps.size()
+
+
+# The loop each project wrote, every statement in its own transaction.
+func migrate_query_per_statement():
+	var other = open_migration_database()
+	var steps = migrations()
+	var version = other.fetch_array("PRAGMA user_version;")[0]["user_version"]
+	for i in range(version, steps.size()):
+		for statement in steps[i].split(";", false):
+			if not statement.strip_edges().is_empty():
+				other.query(statement)
+		other.query("PRAGMA user_version = %d;" % (i + 1))
+	other.close()
+	return steps.size()
+
+
+func write_json(path, data):
+	var file = File.new()
+	if file.open(path, File.WRITE) != OK:
+		printerr("Cannot write ", path)
+		return
+	file.store_string(JSON.new().stringify(data, "\t"))
+	file.close()
+
+
+func read_json(path):
+	var file = File.new()
+	if file.open(path, File.READ) != OK:
+		return null
+	var json = JSON.new()
+	var error = json.parse(file.get_as_text())
+	file.close()
+	return json.get_data() if error == OK else null
@@ -0,0 +1,84 @@
+# Nearest neighbour search: brute force `knn()` against the IVF index.
+# godot --headless --path demo -s res://SQLite/knn_benchmark.gd -- --count=1000000
+extends SceneTree
+
+const DIMS = 128
+const K = 10
+const QUERIES = 20
+
+var count = 100000
+
+
+func _init():
+	for arg in OS.get_cmdline_args():
+		if arg.begins_with("--count="):
+			count = arg.trim_prefix("--count=").to_int()
+
+	var db = SQLite.new()
+	db.open_in_memory()
+	db.query("CREATE TABLE embeddings (id INTEGER PRIMARY KEY, vector BLOB NOT NULL);")
+
+	var rng = RandomNumberGenerator.new()
+	rng.seed = 1234
+
+	var start = Time.get_ticks_usec()
+	var insert = db.create_query("INSERT INTO embeddings (vector) VALUES (?);")
+	db.query("BEGIN;")
+	var rows = []
+	for i in count:
+		rows.push_back([random_vector(rng).to_byte_array()])
+		if rows.size() == 10000:
+			insert.batch_execute(rows)
+			rows.clear()
+	insert.batch_execute(rows)
+	db.query("COMMIT;")
+	print("Inserted %d x %d-d vectors in %.2f s" % [count, DIMS, seconds_since(start)])
+
+	var queries = []
+	for i in QUERIES:
+		queries.push_back(random_vector(rng))
+
+	start = Time.get_ticks_usec()
+	var exact = []
+	for q in queries:
+		exact.push_back(ids_of(db.knn("embeddings", "vector", q, K)))
+	var brute_force_ms = seconds_since(start) * 1000.0 / QUERIES
+	print("Brute force: %.2f ms/query" % brute_force_ms)
+
+	var lists = int(sqrt(count))
+	start = Time.get_ticks_usec()
+	db.create_vector_index("embeddings", "vector", lists)
+	print("IVF index with %d lists built in %.2f s" % [lists, seconds_since(start)])
+
+	for probes in [4, 8, 16, 32]:
+		start = Time.get_ticks_usec()
+		var found = 0
+		for i in QUERIES:
+			var ids = ids_of(db.knn("embeddings", "vector", queries[i], K, SQLite.VECTOR_METRIC_L2, probes))
+			for id in ids:
+				if exact[i].has(id):
+					found += 1
+		var ms = seconds_since(start) * 1000.0 / QUERIES
+		print("IVF, %d probes: %.2f ms/query (x%.1f), recall@%d %.3f" % [probes, ms, brute_force_ms / ms, K, float(found) / (K * QUERIES)])
+
+	db.close()
+	quit()
+
+
+func random_vector(rng):
+	var v = PackedFloat32Array()
+	v.resize(DIMS)
+	for d in DIMS:
+		v[d] = rng.randf_range(-1.0, 1.0)
+	return v
+
+
+func ids_of(result):
+	var ids = []
+	for row in result:
+		ids.push_back(row["rowid"])
+	return ids
+
+
+func seconds_since(start):
+	return (Time.get_ticks_usec() - start) / 1000000.0
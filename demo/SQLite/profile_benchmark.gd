@@ -0,0 +1,63 @@
+# Compares SQLite builds: run it with a `sqlite_profile=default` and a
+# `sqlite_profile=performance` export template, on the same machine.
+# godot --headless --path demo -s res://SQLite/profile_benchmark.gd -- --rows=200000
+extends SceneTree
+
+var rows = 100000
+
+
+func _init():
+	for arg in OS.get_cmdline_args():
+		if arg.begins_with("--rows="):
+			rows = arg.trim_prefix("--rows=").to_int()
+
+	var db = SQLite.new()
+	db.open_in_memory()
+	db.query("CREATE TABLE players (id INTEGER PRIMARY KEY, name TEXT NOT NULL, score INTEGER NOT NULL);")
+	db.query("CREATE INDEX players_score ON players (score);")
+
+	var rng = RandomNumberGenerator.new()
+	rng.seed = 1234
+
+	var insert = db.create_query("INSERT INTO players (name, score) VALUES (?, ?);")
+	var start = Time.get_ticks_usec()
+	db.query("BEGIN;")
+	for i in rows:
+		insert.execute(["player_%d" % i, rng.randi_range(0, 1000000)])
+	db.query("COMMIT;")
+	report("insert", start, rows)
+
+	var by_id = db.create_query("SELECT name, score FROM players WHERE id = ?;")
+	start = Time.get_ticks_usec()
+	for i in rows:
+		by_id.execute([rng.randi_range(1, rows)])
+	report("select by id", start, rows)
+
+	var by_score = db.create_query("SELECT count(*) FROM players WHERE score BETWEEN ? AND ?;")
+	start = Time.get_ticks_usec()
+	for i in rows / 10:
+		var low = rng.randi_range(0, 990000)
+		by_score.execute([low, low + 10000])
+	report("range count", start, rows / 10)
+
+	var like = db.create_query("SELECT count(*) FROM players WHERE name LIKE ?;")
+	start = Time.get_ticks_usec()
+	for i in 100:
+		like.execute(["player_%d%%" % i])
+	report("like scan", start, 100)
+
+	var update = db.create_query("UPDATE players SET score = score + 1 WHERE id = ?;")
+	start = Time.get_ticks_usec()
+	db.query("BEGIN;")
+	for i in rows:
+		update.execute([rng.randi_range(1, rows)])
+	db.query("COMMIT;")
+	report("update", start, rows)
+
+	db.close()
+	quit()
+
+
+func report(name, start, operations):
+	var usec = Time.get_ticks_usec() - start
+	print("%-14s %8.3f s %10.0f ops/s" % [name, usec / 1000000.0, operations * 1000000.0 / usec])
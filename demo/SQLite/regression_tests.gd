@@ -0,0 +1,469 @@
+# Regression tests of the module, run headless; exits with code 1 on failure.
+# godot --headless --path demo -s res://SQLite/regression_tests.gd
+extends SceneTree
+
+var failures = 0
+
+
+class Item:
+	var id = 0
+	var name = ""
+	var score = 0
+
+
+func _init():
+	for name in [
+		"test_drop_table_with_cached_query",
+		"test_volatile_query_not_cached",
+		"test_cache_invalidated_by_rollback_to",
+		"test_cached_rows_are_copies",
+		"test_packed_arrays_bound_as_blobs",
+		"test_carray_reads_wrapped_arrays",
+		"test_knn_finds_rows_inserted_after_index",
+		"test_knn_large_k",
+		"test_knn_large_probes",
+		"test_rolled_back_savepoint_not_notified",
+		"test_failed_statement_not_notified",
+		"test_delete_all_rows_notified",
+		"test_methods_fail_during_open_async",
+		"test_close_during_open_async_emits_opened",
+		"test_backup_thread_refused_without_mutex",
+		"test_csv_malformed_quotes",
+		"test_csv_stray_quote_across_chunks",
+		"test_large_integer_arguments",
+		"test_upsert_counts_written_rows",
+		"test_query_after_adding_a_column",
+		"test_objects_after_dropping_a_column",
+		"test_migration_runs_cascades",
+		"test_encrypted_database_wrong_key",
+		"test_compressed_database_read_back",
+		"test_failed_migration_rolled_back",
+		"test_csv_round_trip",
+	]:
+		var failed = failures
+		call(name)
+		print("%-50s %s" % [name, "ok" if failures == failed else "FAILED"])
+	quit(1 if failures > 0 else 0)
+
+
+func check(condition, message):
+	if not condition:
+		printerr("  ", message)
+		failures += 1
+
+
+func open_memory():
+	var db = SQLite.new()
+	db.open_in_memory()
+	return db
+
+
+# The authorizer installed by the result cache must not skip the deletes from
+# sqlite_master done by DROP.
+func test_drop_table_with_cached_query():
+	var db = open_memory()
+	db.query("CREATE TABLE items (id INTEGER PRIMARY KEY, name TEXT);")
+	db.query("CREATE INDEX items_name ON items (name);")
+	var cached = db.create_query("SELECT * FROM items;")
+	cached.cache_results = true
+	cached.execute()
+	db.query("DROP INDEX items_name;")
+	db.query("DROP TABLE items;")
+	var left = db.fetch_array("SELECT name FROM sqlite_master;")
+	check(left.is_empty(), "The table and its index are still there: %s" % [left])
+	db.close()
+
+
+func test_volatile_query_not_cached():
+	var db = open_memory()
+	db.create_function("counter", func(): return Time.get_ticks_usec())
+	var query = db.create_query("SELECT counter(), changes();")
+	query.cache_results = true
+	var first = query.execute()
+	OS.delay_usec(10)
+	var second = query.execute()
+	check(first[0][0] != second[0][0], "The result of a non deterministic function was cached.")
+	db.close()
+
+
+# A prepared ROLLBACK TO invalidates the cache each time it runs.
+func test_cache_invalidated_by_rollback_to():
+	var db = open_memory()
+	db.query("CREATE TABLE items (id INTEGER PRIMARY KEY);")
+	var count = db.create_query("SELECT count(*) FROM items;")
+	count.cache_results = true
+	var savepoint = db.create_query("SAVEPOINT edit;")
+	var insert = db.create_query("INSERT INTO items DEFAULT VALUES;")
+	var rollback = db.create_query("ROLLBACK TO edit;")
+	var release = db.create_query("RELEASE edit;")
+	for i in 2:
+		savepoint.execute()
+		insert.execute()
+		check(count.execute()[0][0] == 1, "The insert isn't seen.")
+		rollback.execute()
+		release.execute()
+		check(count.execute()[0][0] == 0, "Run %d: the rolled back insert is still cached." % i)
+	db.close()
+
+
+func test_cached_rows_are_copies():
+	var db = open_memory()
+	db.query("CREATE TABLE items (id INTEGER PRIMARY KEY);")
+	db.query("INSERT INTO items VALUES (1), (2);")
+	var query = db.create_query("SELECT id FROM items;")
+	query.cache_results = true
+	var rows = query.execute()
+	rows.clear()
+	rows = query.execute()
+	check(rows.size() == 2, "Editing the result changed the cache.")
+	rows[0][0] = 10
+	check(query.execute()[0][0] == 1, "Editing a row changed the cache.")
+	db.close()
+
+
+func test_packed_arrays_bound_as_blobs():
+	var db = open_memory()
+	db.query("CREATE TABLE vectors (id INTEGER PRIMARY KEY, vector BLOB);")
+	var vector = PackedFloat32Array([1.0, 2.0, 3.0])
+	db.query_with_args("INSERT INTO vectors (vector) VALUES (?);", [vector])
+	var rows = db.fetch_array("SELECT typeof(vector), vector FROM vectors;")
+	check(rows[0][0] == "blob", "A PackedFloat32Array was stored as %s." % rows[0][0])
+	check(rows[0][1] == vector.to_byte_array(), "The stored bytes differ from to_byte_array().")
+	var query = PackedFloat32Array([1.0, 2.0, 5.0])
+	rows = db.fetch_array_with_args("SELECT vec_distance_l2(vector, ?) FROM vectors;", [query])
+	check(rows[0][0] != null and is_equal_approx(rows[0][0], 2.0), "vec_distance_l2 returned %s." % [rows[0][0]])
+	db.close()
+
+
+func test_carray_reads_wrapped_arrays():
+	var db = open_memory()
+	db.query("CREATE TABLE items (id INTEGER PRIMARY KEY);")
+	db.query("INSERT INTO items VALUES (1), (2), (3), (4);")
+	var rows = db.fetch_array_with_args("SELECT id FROM items WHERE id IN carray(?) ORDER BY id;",
+			[SQLite.carray(PackedInt64Array([2, 4, 8]))])
+	check(rows.size() == 2 and rows[0][0] == 2 and rows[1][0] == 4, "carray() read %s." % [rows])
+	rows = db.fetch_array_with_args("SELECT count(*) FROM carray(?);", [SQLite.carray(PackedStringArray(["a", "b"]))])
+	check(rows[0][0] == 2, "carray() read %s strings." % rows[0][0])
+	db.close()
+
+
+func fill_vectors(db, count):
+	db.query("CREATE TABLE vectors (id INTEGER PRIMARY KEY, vector BLOB);")
+	db.query("BEGIN;")
+	for i in count:
+		db.query_with_args("INSERT INTO vectors (vector) VALUES (?);", [PackedFloat32Array([i, -i])])
+	db.query("COMMIT;")
+
+
+# Rows inserted after create_vector_index() are in no IVF list.
+func test_knn_finds_rows_inserted_after_index():
+	var db = open_memory()
+	fill_vectors(db, 256)
+	check(db.create_vector_index("vectors", "vector", 16), "The index wasn't built.")
+	db.query_with_args("INSERT INTO vectors (vector) VALUES (?);", [PackedFloat32Array([1000.0, 1000.0])])
+	var found = db.knn("vectors", "vector", PackedFloat32Array([1000.0, 1000.0]), 1)
+	check(found.size() == 1 and found[0]["rowid"] == 257, "The new row wasn't found: %s" % [found])
+	db.close()
+
+
+func test_knn_large_k():
+	var db = open_memory()
+	fill_vectors(db, 10)
+	var found = db.knn("vectors", "vector", PackedFloat32Array([0.0, 0.0]), 1 << 30)
+	check(found.size() == 10, "Found %d rows out of 10." % found.size())
+	db.close()
+
+
+func test_knn_large_probes():
+	var db = open_memory()
+	fill_vectors(db, 256)
+	check(db.create_vector_index("vectors", "vector", 16), "The index wasn't built.")
+	var found = db.knn("vectors", "vector", PackedFloat32Array([0.0, 0.0]), 5, SQLite.VECTOR_METRIC_L2, 1 << 30)
+	check(found.size() == 5, "Found %d rows out of 5." % found.size())
+	db.close()
+
+
+# Connects row_changed, the returned array gets the [table, operation, rowid]
+# of the rows emitted by flush().
+func record_row_changes(db):
+	var changes = []
+	db.change_notifications = SQLite.CHANGE_NOTIFICATIONS_ROWS
+	db.row_changed.connect(func(table, operation, rowid): changes.push_back([table, operation, rowid]))
+	return changes
+
+
+# The signals are emitted on the next frame, the tests don't wait for it.
+func flush(db):
+	db._flush_changes()
+
+
+func test_rolled_back_savepoint_not_notified():
+	var db = open_memory()
+	db.query("CREATE TABLE items (id INTEGER PRIMARY KEY);")
+	var changes = record_row_changes(db)
+	db.query("BEGIN;")
+	db.query("INSERT INTO items VALUES (1);")
+	db.query("SAVEPOINT outer_edit;")
+	db.query("INSERT INTO items VALUES (2);")
+	db.query("SAVEPOINT inner_edit;")
+	db.query("INSERT INTO items VALUES (3);")
+	db.query("ROLLBACK TO OUTER_EDIT;")
+	db.query("INSERT INTO items VALUES (4);")
+	db.query("RELEASE outer_edit;")
+	db.query("COMMIT;")
+	flush(db)
+	var rowids = changes.map(func(change): return change[2])
+	check(rowids == [1, 4], "Notified rows %s instead of [1, 4]." % [rowids])
+	db.close()
+
+
+# A statement which fails within a transaction is undone without the rollback
+# hook: the rows it inserted before failing must not be notified.
+func test_failed_statement_not_notified():
+	var db = open_memory()
+	db.query("CREATE TABLE items (id INTEGER PRIMARY KEY, name TEXT UNIQUE);")
+	var changes = record_row_changes(db)
+	db.query("BEGIN;")
+	db.query("INSERT INTO items VALUES (1, 'a');")
+	db.query("INSERT INTO items VALUES (2, 'b'), (3, 'a');")
+	db.create_query("INSERT INTO items VALUES (4, 'c'), (5, 'c');").execute()
+	db.query("COMMIT;")
+	flush(db)
+	var rowids = changes.map(func(change): return change[2])
+	check(rowids == [1], "Notified rows %s instead of [1]." % [rowids])
+	db.close()
+
+
+func test_delete_all_rows_notified():
+	var db = open_memory()
+	db.query("CREATE TABLE items (id INTEGER PRIMARY KEY);")
+	db.query("INSERT INTO items VALUES (1), (2), (3);")
+	var changes = record_row_changes(db)
+	db.query("DELETE FROM items;")
+	flush(db)
+	check(changes.size() == 3, "%d deletes notified out of 3." % changes.size())
+	for change in changes:
+		check(change[1] == SQLite.OPERATION_DELETE, "Not a delete: %s" % [change])
+	db.query("CREATE TABLE other (id INTEGER PRIMARY KEY);")
+	db.query("DROP TABLE other;")
+	var left = db.fetch_array("SELECT name FROM sqlite_master WHERE name = 'other';")
+	check(left.is_empty(), "DROP TABLE didn't drop the table.")
+	db.close()
+
+
+# Until the thread is joined the connection belongs to it, whether or not
+# it's done opening.
+func test_methods_fail_during_open_async():
+	var db = SQLite.new()
+	check(db.open_async(":memory:"), "open_async() failed.")
+	check(not db.execute_script("CREATE TABLE items (id INTEGER PRIMARY KEY);"), "execute_script() ran during the open.")
+	check(db.upsert("items", [{"id": 1}], ["id"]) == -1, "upsert() ran during the open.")
+	check(db.get_memory_stats().is_empty(), "get_memory_stats() read the connection during the open.")
+	check(db.wait_open(), "wait_open() failed.")
+	check(db.execute_script("CREATE TABLE items (id INTEGER PRIMARY KEY);"), "execute_script() failed once opened.")
+	db.close()
+
+
+func test_close_during_open_async_emits_opened():
+	var db = SQLite.new()
+	var results = []
+	db.opened.connect(func(success): results.push_back(success))
+	db.open_async(":memory:")
+	db.close()
+	# The call queued by the thread, made on the next frame.
+	db._open_async_finished()
+	check(results == [false], "opened emitted %s instead of [false]." % [results])
+	db.close()
+
+
+func test_backup_thread_refused_without_mutex():
+	var db = SQLite.new()
+	db.open_with_options(":memory:", {"no_mutex": true})
+	db.query("CREATE TABLE items (id INTEGER PRIMARY KEY);")
+	var other = open_memory()
+	var backup = db.backup_to(other)
+	check(not backup.start_thread(), "The backup of a no_mutex connection ran on a thread.")
+	check(backup.run() == SQLiteBackup.STATUS_DONE, "The blocking backup failed.")
+	check(other.fetch_array("SELECT name FROM sqlite_master;").size() == 1, "The table wasn't copied.")
+	other.close()
+	db.close()
+
+
+func import_csv_text(db, text, options = {}):
+	var path = "user://regression_test.csv"
+	var file = File.new()
+	file.open(path, File.WRITE)
+	file.store_string(text)
+	file.close()
+	return db.import_csv(path, "items", options)
+
+
+func test_csv_malformed_quotes():
+	var db = open_memory()
+	db.query("CREATE TABLE items (name TEXT, count INTEGER);")
+	check(import_csv_text(db, "name,count\n\"a\",1\n\"b\"\"c\",2\n") == 2, "A valid file wasn't imported.")
+	check(import_csv_text(db, "name,count\n\"a\"b,1\n") == -1, "Text after a closing quote was accepted.")
+	check(import_csv_text(db, "name,count\n\"a,1\n") == -1, "An unterminated quote was accepted.")
+	check(db.fetch_array("SELECT count(*) FROM items;")[0][0] == 2, "A malformed file inserted rows.")
+	db.close()
+
+
+# A quote within an unquoted field is text, also for the chunk splitter: the
+# quoted new lines which follow must not end a chunk.
+func test_csv_stray_quote_across_chunks():
+	var db = open_memory()
+	db.query("CREATE TABLE items (name TEXT, note TEXT);")
+	var text = "name,note\nTV,55\" screen\n"
+	for i in 2000:
+		text += "\"line\nbreak\",%d\n" % i
+	var rows = import_csv_text(db, text, {"chunk_size": 4096, "threads": 2})
+	check(rows == 2001, "Imported %d rows instead of 2001." % rows)
+	var last = db.fetch_array("SELECT name, note FROM items WHERE note = '1999';")
+	check(last == [["line\nbreak", "1999"]], "Read %s as the last row." % [last])
+	db.close()
+
+
+func test_large_integer_arguments():
+	var db = open_memory()
+	var big = 1 << 40
+	var rows = db.fetch_array_with_args("SELECT ?;", [big])
+	check(rows[0][0] == big, "%d was bound as %d." % [big, rows[0][0]])
+	db.close()
+
+
+func test_upsert_counts_written_rows():
+	var db = open_memory()
+	db.query("CREATE TABLE tags (name TEXT PRIMARY KEY);")
+	check(db.upsert("tags", [{"name": "a"}, {"name": "b"}], ["name"]) == 2, "The inserts weren't counted.")
+	check(db.upsert("tags", [{"name": "a"}, {"name": "c"}], ["name"]) == 1, "The row left as is was counted.")
+	db.close()
+
+
+# SQLite prepares the statement again after the schema changed.
+func test_query_after_adding_a_column():
+	var db = open_memory()
+	db.query("CREATE TABLE items (id INTEGER PRIMARY KEY);")
+	db.query("INSERT INTO items VALUES (1);")
+	var query = db.create_query("SELECT * FROM items;")
+	check(query.execute() == [[1]], "Wrong rows before the change.")
+	db.query("ALTER TABLE items ADD COLUMN name TEXT DEFAULT 'a';")
+	var rows = query.execute()
+	check(rows == [[1, "a"]], "Read %s after adding a column." % [rows])
+	db.close()
+
+
+func test_objects_after_dropping_a_column():
+	var db = open_memory()
+	db.query("CREATE TABLE items (id INTEGER PRIMARY KEY, name TEXT, score INTEGER);")
+	db.query("INSERT INTO items VALUES (1, 'a', 10);")
+	var query = db.create_query("SELECT * FROM items;")
+	var items = query.execute_into_objects(Item)
+	check(items.size() == 1 and items[0].name == "a", "Wrong objects before the change.")
+	db.query("ALTER TABLE items DROP COLUMN name;")
+	items = query.execute_into_objects(Item)
+	check(items.size() == 1 and items[0].name == "" and items[0].score == 10,
+			"Assigned the wrong properties after dropping a column.")
+	db.query("ALTER TABLE items ADD COLUMN name TEXT DEFAULT 'b';")
+	items = query.execute_into_objects(Item)
+	check(items.size() == 1 and items[0].name == "b" and items[0].score == 10,
+			"Ignored the column added after the mapping.")
+	db.close()
+
+
+# The foreign key checks are deferred during the migrations, not the actions.
+func test_migration_runs_cascades():
+	var db = open_memory()
+	db.query("PRAGMA foreign_keys = ON;")
+	db.query("CREATE TABLE teams (id INTEGER PRIMARY KEY);")
+	db.query("CREATE TABLE players (id INTEGER PRIMARY KEY, team INTEGER REFERENCES teams ON DELETE CASCADE);")
+	db.query("INSERT INTO teams VALUES (1), (2);")
+	db.query("INSERT INTO players VALUES (1, 1), (2, 2);")
+	var report = db.migrate(["DELETE FROM teams WHERE id = 1;"])
+	check(not report.is_empty(), "The migration failed.")
+	var left = db.fetch_array("SELECT id FROM players;")
+	check(left.size() == 1, "The cascade didn't run: %s" % [left])
+	db.close()
+
+
+func remove_files(paths):
+	var dir = Directory.new()
+	for path in paths:
+		if dir.file_exists(path):
+			dir.remove(path)
+
+
+func test_encrypted_database_wrong_key():
+	var path = "user://regression_encrypted.db"
+	remove_files([path])
+	var key = PackedByteArray()
+	key.resize(32)
+	for i in key.size():
+		key[i] = i
+	var db = SQLite.new()
+	check(db.open_encrypted(path, key), "The encrypted database wasn't created.")
+	db.query("CREATE TABLE items (name TEXT);")
+	db.query("INSERT INTO items VALUES ('secret');")
+	db.close()
+	check(db.open_encrypted(path, key), "The encrypted database wasn't opened again.")
+	var rows = db.fetch_array("SELECT name FROM items;")
+	check(rows.size() == 1 and rows[0][0] == "secret", "Read %s with the right key." % [rows])
+	db.close()
+	var wrong_key = key.duplicate()
+	wrong_key[0] = 255
+	check(not db.open_encrypted(path, wrong_key), "The database was opened with the wrong key.")
+	db.close()
+	remove_files([path])
+
+
+func test_compressed_database_read_back():
+	var source = "user://regression_plain.db"
+	var compressed = "user://regression_compressed.db"
+	remove_files([source, compressed])
+	var db = SQLite.new()
+	db.open(source)
+	db.query("CREATE TABLE items (id INTEGER PRIMARY KEY, name TEXT);")
+	db.query("BEGIN;")
+	for i in 1000:
+		db.query_with_args("INSERT INTO items (name) VALUES (?);", ["item %d" % i])
+	db.query("COMMIT;")
+	var expected = db.create_query("SELECT id, name FROM items;").execute()
+	db.close()
+	check(SQLite.compress_database(source, compressed), "The database wasn't compressed.")
+	check(db.open(compressed), "The compressed database wasn't opened.")
+	var rows = db.create_query("SELECT id, name FROM items;").execute()
+	check(rows == expected, "Read %d rows out of %d, or other values." % [rows.size(), expected.size()])
+	db.close()
+	remove_files([source, compressed])
+
+
+func test_failed_migration_rolled_back():
+	var db = open_memory()
+	db.query("PRAGMA user_version = 1;")
+	var report = db.migrate([
+		"CREATE TABLE items (id INTEGER PRIMARY KEY);",
+		"CREATE TABLE tags (name TEXT);",
+		"INSERT INTO missing VALUES (1);",
+	])
+	check(report.is_empty(), "The failed migration reported %s." % [report])
+	var version = db.fetch_array("PRAGMA user_version;")[0][0]
+	check(version == 1, "The version is %d instead of 1." % version)
+	var tables = db.fetch_array("SELECT name FROM sqlite_master WHERE name = 'tags';")
+	check(tables.is_empty(), "The table of the failed migration is still there.")
+	db.close()
+
+
+func test_csv_round_trip():
+	var path = "user://regression_round_trip.csv"
+	var db = open_memory()
+	db.query("CREATE TABLE items (id INTEGER, price REAL, name TEXT);")
+	db.query_with_args("INSERT INTO items VALUES (?, ?, ?);", [1, 1.5, "plain"])
+	db.query_with_args("INSERT INTO items VALUES (?, ?, ?);", [2, -0.25, "a, \"quoted\"\nname"])
+	db.query_with_args("INSERT INTO items VALUES (?, ?, ?);", [1 << 40, 1e20, "12"])
+	db.query_with_args("INSERT INTO items VALUES (?, ?, ?);", [3, null, ""])
+	check(db.export_csv("SELECT * FROM items;", [], path) == 4, "The rows weren't exported.")
+	check(db.import_csv(path, "items_copy") == 4, "The rows weren't imported.")
+	var expected = db.create_query("SELECT * FROM items;").execute()
+	var rows = db.create_query("SELECT * FROM items_copy;").execute()
+	check(rows == expected, "Imported %s instead of %s." % [rows, expected])
+	db.close()
+	remove_files([path])
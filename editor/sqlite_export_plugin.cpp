@@ -0,0 +1,200 @@
+#include "sqlite_export_plugin.h"
+
+#include "core/config/project_settings.h"
+#include "core/io/dir_access.h"
+#include "core/io/file_access.h"
+#include "core/io/json.h"
+#include "editor/editor_paths.h"
+
+#include "../sqlite_zvfs.h"
+#include "../thirdparty/sqlite/sqlite3.h"
+
+static bool exec(sqlite3 *p_db, const String &p_statement) {
+  char *error = nullptr;
+  const int result = sqlite3_exec(p_db, p_statement.utf8().get_data(),
+                                  nullptr, nullptr, &error);
+  if (result != SQLITE_OK) {
+    ERR_PRINT("`" + p_statement + "` failed: " + String::utf8(error));
+    sqlite3_free(error);
+    return false;
+  }
+  return true;
+}
+
+static int64_t pragma_int(sqlite3 *p_db, const char *p_pragma) {
+  sqlite3_stmt *stmt = nullptr;
+  int64_t value = -1;
+  const String statement = String("PRAGMA ") + p_pragma + ";";
+  if (sqlite3_prepare_v2(p_db, statement.utf8().get_data(), -1, &stmt,
+                         nullptr) == SQLITE_OK &&
+      sqlite3_step(stmt) == SQLITE_ROW) {
+    value = sqlite3_column_int64(stmt, 0);
+  }
+  sqlite3_finalize(stmt);
+  return value;
+}
+
+// Hash of the schema, to check at runtime that a database is the expected
+// one without reading it.
+static String schema_hash(sqlite3 *p_db) {
+  sqlite3_stmt *stmt = nullptr;
+  String schema;
+  if (sqlite3_prepare_v2(p_db,
+                         "SELECT type, name, tbl_name, sql FROM sqlite_schema "
+                         "ORDER BY type, name;",
+                         -1, &stmt, nullptr) == SQLITE_OK) {
+    while (sqlite3_step(stmt) == SQLITE_ROW) {
+      for (int i = 0; i < 4; i += 1) {
+        schema += String::utf8(reinterpret_cast<const char *>(
+                      sqlite3_column_text(stmt, i))) +
+                  "\n";
+      }
+    }
+  }
+  sqlite3_finalize(stmt);
+  return schema.sha256_text();
+}
+
+bool SQLiteExportPlugin::optimize(const String &p_source,
+                                  const String &p_destination,
+                                  Dictionary &r_metadata) {
+  const int page_size = GLOBAL_GET("sqlite/export/page_size");
+  const PackedStringArray drop_tables = GLOBAL_GET("sqlite/export/drop_tables");
+  ERR_FAIL_COND_V_MSG(page_size != 0 &&
+                          (page_size < 512 || page_size > 65536 ||
+                           (page_size & (page_size - 1)) != 0),
+                      false,
+                      "`sqlite/export/page_size` must be 0 or a power of two "
+                      "between 512 and 65536.");
+
+  sqlite3 *source = nullptr;
+  int result = sqlite3_open_v2(p_source.utf8().get_data(), &source,
+                               SQLITE_OPEN_READONLY, nullptr);
+  if (result != SQLITE_OK) {
+    ERR_PRINT("Cannot open " + p_source + ": " + sqlite3_errmsg(source));
+    sqlite3_close_v2(source);
+    return false;
+  }
+  // Only recorded by the read only connection, `VACUUM INTO` applies it to
+  // the copy.
+  bool copied =
+      page_size == 0 || exec(source, "PRAGMA page_size = " + itos(page_size));
+  copied = copied && exec(source, "VACUUM INTO '" +
+                                      p_destination.replace("'", "''") + "';");
+  sqlite3_close_v2(source);
+  if (!copied) {
+    return false;
+  }
+
+  sqlite3 *db = nullptr;
+  result = sqlite3_open_v2(p_destination.utf8().get_data(), &db,
+                           SQLITE_OPEN_READWRITE, nullptr);
+  if (result != SQLITE_OK) {
+    ERR_PRINT("Cannot open " + p_destination + ": " + sqlite3_errmsg(db));
+    sqlite3_close_v2(db);
+    return false;
+  }
+
+  // Packed databases are read from memory, where WAL isn't available.
+  bool optimized = exec(db, "PRAGMA journal_mode = DELETE;");
+  for (int i = 0; optimized && i < drop_tables.size(); i += 1) {
+    optimized = exec(db, "DROP TABLE IF EXISTS \"" +
+                             drop_tables[i].replace("\"", "\"\"") + "\";");
+  }
+  if (optimized && drop_tables.size() > 0) {
+    // Releases the pages of the dropped tables.
+    optimized = exec(db, "VACUUM;");
+  }
+  optimized = optimized && exec(db, "ANALYZE;");
+  optimized = optimized && exec(db, "PRAGMA optimize;");
+
+  if (optimized) {
+    r_metadata["page_size"] = pragma_int(db, "page_size");
+    r_metadata["page_count"] = pragma_int(db, "page_count");
+    r_metadata["user_version"] = pragma_int(db, "user_version");
+    r_metadata["schema_version"] = pragma_int(db, "schema_version");
+    r_metadata["schema_hash"] = schema_hash(db);
+  }
+  sqlite3_close_v2(db);
+  return optimized;
+}
+
+void SQLiteExportPlugin::_export_file(const String &p_path,
+                                      const String &p_type,
+                                      const HashSet<String> &p_features) {
+  if (!GLOBAL_GET("sqlite/export/optimize_databases")) {
+    return;
+  }
+  const PackedStringArray extensions =
+      String(GLOBAL_GET("sqlite/export/extensions")).split(",", false);
+  if (extensions.find(p_path.get_extension().to_lower()) == -1) {
+    return;
+  }
+
+  const String source =
+      ProjectSettings::get_singleton()->globalize_path(p_path);
+  const String destination = EditorPaths::get_singleton()->get_cache_dir()
+                                 .plus_file("sqlite_export_" +
+                                            p_path.md5_text() + ".db");
+  if (FileAccess::exists(destination)) {
+    // `VACUUM INTO` doesn't overwrite.
+    DirAccess::remove_file_or_error(destination);
+  }
+
+  Dictionary metadata;
+  if (!optimize(source, destination, metadata)) {
+    WARN_PRINT("Exporting " + p_path + " without optimizing it.");
+    DirAccess::remove_file_or_error(destination);
+    return;
+  }
+
+  Vector<uint8_t> database = FileAccess::get_file_as_array(destination);
+  DirAccess::remove_file_or_error(destination);
+  ERR_FAIL_COND_MSG(database.is_empty(),
+                    "Cannot read the optimized copy of " + p_path);
+  metadata["size"] = database.size();
+
+  const String compression = GLOBAL_GET("sqlite/export/compression");
+  if (compression != "disabled") {
+    Compression::Mode mode = Compression::MODE_ZSTD;
+    if (compression == "deflate") {
+      mode = Compression::MODE_DEFLATE;
+    } else if (compression == "fastlz") {
+      mode = Compression::MODE_FASTLZ;
+    }
+    const Vector<uint8_t> compressed = sqlite_zvfs_compress(
+        database, mode, GLOBAL_GET("sqlite/export/compression_group_size"));
+    if (compressed.is_empty()) {
+      WARN_PRINT("Exporting " + p_path + " without compressing it.");
+    } else {
+      metadata["compression"] = compression;
+      metadata["compressed_size"] = compressed.size();
+      database = compressed;
+    }
+  }
+  add_file(p_path, database, false);
+
+  Ref<JSON> json;
+  json.instantiate();
+  add_file(p_path + ".sqlitemeta",
+           json->stringify(metadata, "\t").to_utf8_buffer(), false);
+  // Replaces the original file.
+  skip();
+}
+
+SQLiteExportPlugin::SQLiteExportPlugin() {
+  GLOBAL_DEF("sqlite/export/optimize_databases", true);
+  GLOBAL_DEF("sqlite/export/extensions", "db,sqlite,sqlite3");
+  // 0 keeps the page size of each database.
+  GLOBAL_DEF("sqlite/export/page_size", 0);
+  // Tables only used during development, for example editor caches.
+  GLOBAL_DEF("sqlite/export/drop_tables", PackedStringArray());
+  // Compressed databases are opened read only, decompressing the groups of
+  // pages on demand.
+  GLOBAL_DEF("sqlite/export/compression", "disabled");
+  ProjectSettings::get_singleton()->set_custom_property_info(
+      "sqlite/export/compression",
+      PropertyInfo(Variant::STRING, "sqlite/export/compression",
+                   PROPERTY_HINT_ENUM, "disabled,zstd,deflate,fastlz"));
+  GLOBAL_DEF("sqlite/export/compression_group_size", 65536);
+}
@@ -0,0 +1,25 @@
+#ifndef GDSQLITE_EXPORT_PLUGIN_H
+#define GDSQLITE_EXPORT_PLUGIN_H
+
+#include "editor/editor_export.h"
+
+/// Exports the SQLite databases of the project optimized for reading: each
+/// one is copied with `VACUUM INTO`, so it has no free pages, then analyzed
+/// so the query planner has statistics. A `.sqlitemeta` JSON file with its
+/// page count and schema hash is exported next to it.
+/// Configured by the `sqlite/export/*` project settings.
+class SQLiteExportPlugin : public EditorExportPlugin {
+  GDCLASS(SQLiteExportPlugin, EditorExportPlugin);
+
+  bool optimize(const String &p_source, const String &p_destination,
+                Dictionary &r_metadata);
+
+protected:
+  virtual void _export_file(const String &p_path, const String &p_type,
+                            const HashSet<String> &p_features) override;
+
+public:
+  SQLiteExportPlugin();
+};
+
+#endif
@@ -2,17 +2,47 @@
 
 #include "core/object/class_db.h"
 #include "sqlite.h"
+#include "sqlite_crypt.h"
+#include "sqlite_memory.h"
+#include "sqlite_zvfs.h"
+
+#ifdef TOOLS_ENABLED
+#include "editor/editor_export.h"
+#include "editor/editor_node.h"
+#include "editor/sqlite_export_plugin.h"
+
+static void _editor_init() {
+  Ref<SQLiteExportPlugin> export_plugin;
+  export_plugin.instantiate();
+  EditorExport::get_singleton()->add_export_plugin(export_plugin);
+}
+#endif
 
 void initialize_sqlite_module(ModuleInitializationLevel p_level) {
+#ifdef TOOLS_ENABLED
+  if (p_level == MODULE_INITIALIZATION_LEVEL_EDITOR) {
+    ClassDB::register_class<SQLiteExportPlugin>();
+    EditorNode::add_init_callback(_editor_init);
+    return;
+  }
+#endif
   if (p_level != MODULE_INITIALIZATION_LEVEL_SERVERS) {
     return;
   }
+  sqlite_memory_initialize();
+  sqlite_zvfs_initialize();
+  sqlite_crypt_initialize();
   ClassDB::register_class<SQLite>();
   ClassDB::register_class<SQLiteQuery>();
+  ClassDB::register_class<SQLiteSession>();
+  ClassDB::register_class<SQLiteBackup>();
+  ClassDB::register_class<SQLiteCompiledScript>();
+  ClassDB::register_class<SQLiteCArray>();
 }
 
 void uninitialize_sqlite_module(ModuleInitializationLevel p_level) {
   if (p_level != MODULE_INITIALIZATION_LEVEL_SERVERS) {
     return;
   }
+  sqlite_memory_finalize();
 }
@@ -1,60 +1,311 @@
 #include "sqlite.h"
+#include "sqlite_carray.h"
+#include "sqlite_crypt.h"
+#include "sqlite_csv.h"
+#include "sqlite_functions.h"
+#include "sqlite_memory.h"
+#include "sqlite_pcache.h"
+
 #include "core/core_bind.h"
+#include "core/crypto/crypto_core.h"
+#include "core/io/file_access.h"
+#include "core/io/json.h"
+#include "core/io/resource_loader.h"
 #include "core/os/os.h"
 #include "editor/project_settings_editor.h"
 
-Array fast_parse_row(sqlite3_stmt *stmt) {
-  Array result;
+static Variant column_value(sqlite3_stmt *stmt, int i) {
+  const int col_type = sqlite3_column_type(stmt, i);
+  Variant value;
+
+  // Get column value
+  switch (col_type) {
+  case SQLITE_INTEGER:
+    value = Variant(int64_t(sqlite3_column_int64(stmt, i)));
+    break;
+
+  case SQLITE_FLOAT:
+    value = Variant(sqlite3_column_double(stmt, i));
+    break;
+
+  case SQLITE_TEXT: {
+    int size = sqlite3_column_bytes(stmt, i);
+    String str = String::utf8((const char *)sqlite3_column_text(stmt, i), size);
+    value = Variant(str);
+    break;
+  }
+  case SQLITE_BLOB: {
+    PackedByteArray arr;
+    int size = sqlite3_column_bytes(stmt, i);
+    arr.resize(size);
+    memcpy(arr.ptrw(), sqlite3_column_blob(stmt, i), size);
+    value = Variant(arr);
+    break;
+  }
+  case SQLITE_NULL: {
+    // Nothing to do.
+  } break;
+  default:
+    ERR_PRINT("This kind of data is not yet supported: " + itos(col_type));
+    break;
+  }
 
-  // Get column count
-  const int col_count = sqlite3_column_count(stmt);
+  return value;
+}
 
-  // Fetch all column
+// Reads a column known to be of type `TYPE`.
+template <int TYPE>
+static _FORCE_INLINE_ Variant read_column(sqlite3_stmt *stmt, int i);
+
+template <>
+_FORCE_INLINE_ Variant read_column<SQLITE_INTEGER>(sqlite3_stmt *stmt, int i) {
+  return int64_t(sqlite3_column_int64(stmt, i));
+}
+
+template <>
+_FORCE_INLINE_ Variant read_column<SQLITE_FLOAT>(sqlite3_stmt *stmt, int i) {
+  return sqlite3_column_double(stmt, i);
+}
+
+template <>
+_FORCE_INLINE_ Variant read_column<SQLITE_TEXT>(sqlite3_stmt *stmt, int i) {
+  const char *text = (const char *)sqlite3_column_text(stmt, i);
+  return String::utf8(text, sqlite3_column_bytes(stmt, i));
+}
+
+template <>
+_FORCE_INLINE_ Variant read_column<SQLITE_BLOB>(sqlite3_stmt *stmt, int i) {
+  PackedByteArray arr;
+  const int size = sqlite3_column_bytes(stmt, i);
+  arr.resize(size);
+  memcpy(arr.ptrw(), sqlite3_column_blob(stmt, i), size);
+  return arr;
+}
+
+// Reads a column expected to be of type `TYPE`. Declared types are only
+// affinities: NULL and values of other types still go through
+// `column_value()`.
+template <int TYPE>
+static Variant read_expected_column(sqlite3_stmt *stmt, int i) {
+  if (likely(sqlite3_column_type(stmt, i) == TYPE)) {
+    return read_column<TYPE>(stmt, i);
+  }
+  return column_value(stmt, i);
+}
+
+// Rows where every column has the same type.
+template <int TYPE>
+static Array decode_uniform_row(sqlite3_stmt *stmt, int col_count) {
+  Array result;
+  result.resize(col_count);
   for (int i = 0; i < col_count; i++) {
-    // Value
-    const int col_type = sqlite3_column_type(stmt, i);
-    Variant value;
+    result[i] = read_expected_column<TYPE>(stmt, i);
+  }
+  return result;
+}
 
-    // Get column value
-    switch (col_type) {
-    case SQLITE_INTEGER:
-      value = Variant(sqlite3_column_int(stmt, i));
-      break;
+// Type of the values a column should hold, from its declared type, following
+// the affinity rules of SQLite. 0 when it can't tell.
+static int declared_column_type(sqlite3_stmt *stmt, int i) {
+  const char *decltype_name = sqlite3_column_decltype(stmt, i);
+  if (decltype_name == nullptr) {
+    // An expression.
+    return 0;
+  }
+  const String declared = String(decltype_name).to_upper();
+  if (declared.find("INT") != -1) {
+    return SQLITE_INTEGER;
+  }
+  if (declared.find("CHAR") != -1 || declared.find("CLOB") != -1 ||
+      declared.find("TEXT") != -1) {
+    return SQLITE_TEXT;
+  }
+  if (declared.find("BLOB") != -1 || declared.is_empty()) {
+    return 0;
+  }
+  if (declared.find("REAL") != -1 || declared.find("FLOA") != -1 ||
+      declared.find("DOUB") != -1) {
+    return SQLITE_FLOAT;
+  }
+  // NUMERIC, holding integers and reals.
+  return 0;
+}
 
-    case SQLITE_FLOAT:
-      value = Variant(sqlite3_column_double(stmt, i));
-      break;
+// Writes the values of a statement as JSON text, without going through
+// Variants.
+struct JSONWriter {
+  LocalVector<uint8_t> buffer;
 
-    case SQLITE_TEXT: {
-      int size = sqlite3_column_bytes(stmt, i);
-      String str =
-          String::utf8((const char *)sqlite3_column_text(stmt, i), size);
-      value = Variant(str);
-      break;
+  void write(const char *p_data, uint32_t p_size) {
+    const uint32_t offset = buffer.size();
+    buffer.resize(offset + p_size);
+    memcpy(buffer.ptr() + offset, p_data, p_size);
+  }
+
+  void write(char p_char) { buffer.push_back(p_char); }
+
+  void write(const JSONWriter &p_other) {
+    write((const char *)p_other.buffer.ptr(), p_other.buffer.size());
+  }
+
+  void write_string(const char *p_text, int p_size) {
+    static const char *hex = "0123456789abcdef";
+    write('"');
+    int start = 0;
+    for (int i = 0; i < p_size; i++) {
+      const uint8_t c = p_text[i];
+      if (c >= 0x20 && c != '"' && c != '\\') {
+        // UTF-8 is copied as is.
+        continue;
+      }
+      write(p_text + start, i - start);
+      start = i + 1;
+      write('\\');
+      switch (c) {
+      case '"':
+      case '\\':
+        write(c);
+        break;
+      case '\n':
+        write('n');
+        break;
+      case '\r':
+        write('r');
+        break;
+      case '\t':
+        write('t');
+        break;
+      case '\b':
+        write('b');
+        break;
+      case '\f':
+        write('f');
+        break;
+      default: {
+        const char escape[5] = {'u', '0', '0', hex[c >> 4], hex[c & 0xf]};
+        write(escape, 5);
+      } break;
+      }
     }
-    case SQLITE_BLOB: {
-      PackedByteArray arr;
-      int size = sqlite3_column_bytes(stmt, i);
-      arr.resize(size);
-      memcpy(arr.ptrw(), sqlite3_column_blob(stmt, i), size);
-      value = Variant(arr);
+    write(p_text + start, p_size - start);
+    write('"');
+  }
+
+  void write_column(sqlite3_stmt *p_stmt, int p_column) {
+    char number[32];
+    switch (sqlite3_column_type(p_stmt, p_column)) {
+    case SQLITE_INTEGER: {
+      // Written as is, JSON numbers don't have a precision.
+      const long long value = sqlite3_column_int64(p_stmt, p_column);
+      const int size = snprintf(number, sizeof(number), "%lld", value);
+      write(number, size);
+    } break;
+    case SQLITE_FLOAT: {
+      const double value = sqlite3_column_double(p_stmt, p_column);
+      if (Math::is_nan(value) || Math::is_inf(value)) {
+        write("null", 4);
+        break;
+      }
+      const int size = snprintf(number, sizeof(number), "%.17g", value);
+      write(number, size);
+    } break;
+    case SQLITE_TEXT:
+      write_string((const char *)sqlite3_column_text(p_stmt, p_column),
+                   sqlite3_column_bytes(p_stmt, p_column));
       break;
-    }
-    case SQLITE_NULL: {
-      // Nothing to do.
+    case SQLITE_BLOB: {
+      // Base64, JSON has no binary type.
+      const uint8_t *blob =
+          (const uint8_t *)sqlite3_column_blob(p_stmt, p_column);
+      const int size = sqlite3_column_bytes(p_stmt, p_column);
+      const uint32_t offset = buffer.size();
+      buffer.resize(offset + (size + 2) / 3 * 4 + 3);
+      size_t length = 0;
+      CryptoCore::b64_encode(buffer.ptr() + offset + 1,
+                             buffer.size() - offset - 1, &length, blob, size);
+      buffer[offset] = '"';
+      buffer[offset + 1 + length] = '"';
+      buffer.resize(offset + length + 2);
     } break;
     default:
-      ERR_PRINT("This kind of data is not yet supported: " + itos(col_type));
+      write("null", 4);
       break;
     }
+  }
+};
+
+// Writes the result of `p_stmt` as an Array of objects, or with
+// `p_columnar` as an object of Arrays, one per column.
+static bool write_json_result(sqlite3_stmt *p_stmt, bool p_columnar,
+                              JSONWriter &r_writer) {
+  const int col_count = sqlite3_column_count(p_stmt);
 
-    result.push_back(value);
+  // The keys are escaped once.
+  LocalVector<JSONWriter> keys;
+  keys.resize(col_count);
+  for (int i = 0; i < col_count; i++) {
+    const char *name = sqlite3_column_name(p_stmt, i);
+    keys[i].write_string(name, strlen(name));
+    keys[i].write(':');
   }
 
-  return result;
+  LocalVector<JSONWriter> columns;
+  if (p_columnar) {
+    columns.resize(col_count);
+  } else {
+    r_writer.write('[');
+  }
+
+  bool first = true;
+  int res = SQLITE_ROW;
+  while ((res = sqlite3_step(p_stmt)) == SQLITE_ROW) {
+    if (p_columnar) {
+      for (int i = 0; i < col_count; i++) {
+        columns[i].write(first ? '[' : ',');
+        columns[i].write_column(p_stmt, i);
+      }
+    } else {
+      if (!first) {
+        r_writer.write(',');
+      }
+      r_writer.write('{');
+      for (int i = 0; i < col_count; i++) {
+        if (i > 0) {
+          r_writer.write(',');
+        }
+        r_writer.write(keys[i]);
+        r_writer.write_column(p_stmt, i);
+      }
+      r_writer.write('}');
+    }
+    first = false;
+  }
+
+  if (p_columnar) {
+    r_writer.write('{');
+    for (int i = 0; i < col_count; i++) {
+      if (i > 0) {
+        r_writer.write(',');
+      }
+      r_writer.write(keys[i]);
+      if (first) {
+        r_writer.write("[]", 2);
+      } else {
+        r_writer.write(columns[i]);
+        r_writer.write(']');
+      }
+    }
+    r_writer.write('}');
+  } else {
+    r_writer.write(']');
+  }
+
+  return res == SQLITE_DONE;
 }
 
-SQLiteQuery::SQLiteQuery() {}
+SafeNumeric<uint64_t> SQLiteQuery::last_id;
+
+SQLiteQuery::SQLiteQuery() { id = last_id.increment(); }
 
 SQLiteQuery::~SQLiteQuery() { finalize(); }
 
@@ -79,6 +330,15 @@ Variant SQLiteQuery::execute(const Array p_args) {
   // At this point stmt can't be null.
   CRASH_COND(stmt == nullptr);
 
+  const bool use_cache = cache_results && cacheable;
+  if (use_cache) {
+    db->refresh_result_cache();
+    Array cached;
+    if (db->result_cache.lookup(id, p_args, cached)) {
+      return cached;
+    }
+  }
+
   // Error occurred during argument binding
   if (!SQLite::bind_args(stmt, p_args)) {
     ERR_FAIL_V_MSG(Variant(),
@@ -87,16 +347,19 @@ Variant SQLiteQuery::execute(const Array p_args) {
 
   // Execute the query.
   Array result;
+  bool done = false;
   while (true) {
     const int res = sqlite3_step(stmt);
     if (res == SQLITE_ROW) {
       // Collect the result.
-      result.append(fast_parse_row(stmt));
+      result.append(decode_row());
     } else if (res == SQLITE_DONE) {
       // Nothing more to do.
+      done = true;
       break;
     } else {
       // Error
+      db->discard_statement_changes();
       ERR_BREAK_MSG(true, "There was an error during an SQL execution: " +
                               get_last_error_message());
     }
@@ -108,6 +371,10 @@ Variant SQLiteQuery::execute(const Array p_args) {
                                get_last_error_message());
   }
 
+  if (use_cache && done) {
+    db->result_cache.store(id, p_args, result, cached_tables);
+  }
+
   return result;
 }
 
@@ -126,284 +393,2731 @@ Variant SQLiteQuery::batch_execute(Array p_rows) {
   return res;
 }
 
-Array SQLiteQuery::get_columns() {
+Variant SQLiteQuery::execute_into_objects(Variant p_class, Array p_args) {
   if (is_ready() == false) {
-    ERR_FAIL_COND_V(prepare() == false, Array());
+    ERR_FAIL_COND_V(prepare() == false, Variant());
   }
 
   // At this point stmt can't be null.
   CRASH_COND(stmt == nullptr);
 
-  Array res;
-  const int col_count = sqlite3_column_count(stmt);
-  res.resize(col_count);
+  if (object_class != p_class || object_native_class == StringName()) {
+    ERR_FAIL_COND_V(map_object_columns(p_class) == false, Variant());
+  }
 
-  // Fetch all column
+  // Error occurred during argument binding
+  if (!SQLite::bind_args(stmt, p_args)) {
+    ERR_FAIL_V_MSG(Variant(),
+                   "Error during arguments set: " + get_last_error_message());
+  }
+
+  // Execute the query.
+  Array result;
+  while (true) {
+    const int res = sqlite3_step(stmt);
+    if (res == SQLITE_ROW) {
+      if (unlikely(sqlite3_column_count(stmt) != int(object_columns.size()))) {
+        // SQLite prepared the statement again after a schema change, and
+        // `SELECT *` now has other columns.
+        ERR_BREAK(map_object_columns(p_class) == false);
+      }
+      Object *object = instantiate_object();
+      ERR_BREAK_MSG(object == nullptr,
+                    "Cannot create an instance of " + String(p_class));
+      for (uint32_t i = 0; i < object_columns.size(); i++) {
+        const ObjectColumn &column = object_columns[i];
+        if (!column.assigned) {
+          continue;
+        }
+        const Variant value = column_value(stmt, i);
+        if (column.setter) {
+          const Variant *args[1] = {&value};
+          Callable::CallError error;
+          column.setter->call(object, args, 1, error);
+          if (error.error != Callable::CallError::CALL_OK) {
+            ERR_PRINT("Cannot assign the column " + column.property + ": " +
+                      Variant::get_call_error_text(
+                          object, column.setter->get_name(), args, 1, error));
+          }
+        } else {
+          object->set(column.property, value);
+        }
+      }
+      result.append(object);
+    } else if (res == SQLITE_DONE) {
+      // Nothing more to do.
+      break;
+    } else {
+      // Error
+      db->discard_statement_changes();
+      ERR_BREAK_MSG(true, "There was an error during an SQL execution: " +
+                              get_last_error_message());
+    }
+  }
+
+  if (SQLITE_OK != sqlite3_reset(stmt)) {
+    finalize();
+    ERR_FAIL_V_MSG(result, "Was not possible to reset the query: " +
+                               get_last_error_message());
+  }
+
+  return result;
+}
+
+// Reads a column with the conversions of SQLite, NULL giving the default
+// value.
+template <typename T>
+static T read_column_as(sqlite3_stmt *stmt, int i);
+
+template <>
+int64_t read_column_as<int64_t>(sqlite3_stmt *stmt, int i) {
+  return sqlite3_column_int64(stmt, i);
+}
+
+template <>
+int32_t read_column_as<int32_t>(sqlite3_stmt *stmt, int i) {
+  return sqlite3_column_int64(stmt, i);
+}
+
+template <>
+double read_column_as<double>(sqlite3_stmt *stmt, int i) {
+  return sqlite3_column_double(stmt, i);
+}
+
+template <>
+float read_column_as<float>(sqlite3_stmt *stmt, int i) {
+  return sqlite3_column_double(stmt, i);
+}
+
+template <>
+String read_column_as<String>(sqlite3_stmt *stmt, int i) {
+  const char *text = (const char *)sqlite3_column_text(stmt, i);
+  return String::utf8(text, sqlite3_column_bytes(stmt, i));
+}
+
+template <>
+Variant read_column_as<Variant>(sqlite3_stmt *stmt, int i) {
+  return column_value(stmt, i);
+}
+
+// Steps `stmt` to its end, reading column `p_column` of each row into a
+// `TPacked` array. The first `p_skipped` values were NULL. Returns false
+// when a step fails.
+template <typename TPacked, typename T>
+static bool read_column_values(sqlite3_stmt *stmt, int p_column,
+                               int p_skipped, TPacked &r_values) {
+  // Written in place, the capacity doubling as the rows come.
+  int64_t count = p_skipped;
+  r_values.resize(MAX(count * 2, int64_t(64)));
+  T *values = r_values.ptrw();
+  for (int64_t i = 0; i < count; i++) {
+    values[i] = T();
+  }
+  int res = SQLITE_ROW;
+  while (res == SQLITE_ROW) {
+    if (count == r_values.size()) {
+      r_values.resize(count * 2);
+      values = r_values.ptrw();
+    }
+    values[count++] = read_column_as<T>(stmt, p_column);
+    res = sqlite3_step(stmt);
+  }
+  r_values.resize(count);
+  return res == SQLITE_DONE;
+}
+
+// Arrays have no raw pointer, their elements are appended.
+template <>
+bool read_column_values<Array, Variant>(sqlite3_stmt *stmt, int p_column,
+                                        int p_skipped, Array &r_values) {
+  r_values.resize(p_skipped);
+  int res = SQLITE_ROW;
+  while (res == SQLITE_ROW) {
+    r_values.push_back(read_column_as<Variant>(stmt, p_column));
+    res = sqlite3_step(stmt);
+  }
+  return res == SQLITE_DONE;
+}
+
+Variant SQLiteQuery::execute_column(Array p_args, int p_column, int p_type) {
+  if (is_ready() == false) {
+    ERR_FAIL_COND_V(prepare() == false, Variant());
+  }
+
+  // At this point stmt can't be null.
+  CRASH_COND(stmt == nullptr);
+
+  ERR_FAIL_INDEX_V_MSG(p_column, sqlite3_column_count(stmt), Variant(),
+                       "Invalid column index: " + itos(p_column));
+  ERR_FAIL_COND_V_MSG(p_type != Variant::NIL &&
+                          p_type != Variant::PACKED_INT32_ARRAY &&
+                          p_type != Variant::PACKED_INT64_ARRAY &&
+                          p_type != Variant::PACKED_FLOAT32_ARRAY &&
+                          p_type != Variant::PACKED_FLOAT64_ARRAY &&
+                          p_type != Variant::PACKED_STRING_ARRAY &&
+                          p_type != Variant::ARRAY,
+                      Variant(),
+                      "The column can't be read as " +
+                          Variant::get_type_name(Variant::Type(p_type)));
+
+  // Error occurred during argument binding
+  if (!SQLite::bind_args(stmt, p_args)) {
+    ERR_FAIL_V_MSG(Variant(),
+                   "Error during arguments set: " + get_last_error_message());
+  }
+
+  // Without a requested type, the first value which isn't NULL gives it.
+  int type = p_type;
+  int skipped = 0;
+  int res = sqlite3_step(stmt);
+  if (type == Variant::NIL) {
+    for (; res == SQLITE_ROW; res = sqlite3_step(stmt)) {
+      const int column_type = sqlite3_column_type(stmt, p_column);
+      if (column_type == SQLITE_NULL) {
+        skipped += 1;
+        continue;
+      }
+      switch (column_type) {
+      case SQLITE_INTEGER:
+        type = Variant::PACKED_INT64_ARRAY;
+        break;
+      case SQLITE_FLOAT:
+        type = Variant::PACKED_FLOAT64_ARRAY;
+        break;
+      case SQLITE_TEXT:
+        type = Variant::PACKED_STRING_ARRAY;
+        break;
+      default:
+        type = Variant::ARRAY;
+        break;
+      }
+      break;
+    }
+  }
+
+  Variant result;
+  bool done = res == SQLITE_DONE;
+  if (res == SQLITE_ROW) {
+    switch (type) {
+    case Variant::PACKED_INT32_ARRAY: {
+      PackedInt32Array values;
+      done = read_column_values<PackedInt32Array, int32_t>(stmt, p_column,
+                                                           skipped, values);
+      result = values;
+    } break;
+    case Variant::PACKED_INT64_ARRAY: {
+      PackedInt64Array values;
+      done = read_column_values<PackedInt64Array, int64_t>(stmt, p_column,
+                                                           skipped, values);
+      result = values;
+    } break;
+    case Variant::PACKED_FLOAT32_ARRAY: {
+      PackedFloat32Array values;
+      done = read_column_values<PackedFloat32Array, float>(stmt, p_column,
+                                                           skipped, values);
+      result = values;
+    } break;
+    case Variant::PACKED_FLOAT64_ARRAY: {
+      PackedFloat64Array values;
+      done = read_column_values<PackedFloat64Array, double>(stmt, p_column,
+                                                            skipped, values);
+      result = values;
+    } break;
+    case Variant::PACKED_STRING_ARRAY: {
+      PackedStringArray values;
+      done = read_column_values<PackedStringArray, String>(stmt, p_column,
+                                                           skipped, values);
+      result = values;
+    } break;
+    default: {
+      Array values;
+      done = read_column_values<Array, Variant>(stmt, p_column, skipped,
+                                                values);
+      result = values;
+    } break;
+    }
+  } else if (done) {
+    // No rows, or only NULL.
+    if (type == Variant::NIL) {
+      Array values;
+      values.resize(skipped);
+      result = values;
+    } else {
+      Callable::CallError error;
+      Variant::construct(Variant::Type(type), result, nullptr, 0, error);
+    }
+  }
+
+  if (!done) {
+    const String error = get_last_error_message();
+    sqlite3_reset(stmt);
+    db->discard_statement_changes();
+    ERR_FAIL_V_MSG(Variant(),
+                   "There was an error during an SQL execution: " + error);
+  }
+
+  if (SQLITE_OK != sqlite3_reset(stmt)) {
+    finalize();
+    ERR_FAIL_V_MSG(result, "Was not possible to reset the query: " +
+                               get_last_error_message());
+  }
+
+  return result;
+}
+
+Variant SQLiteQuery::execute_scalar(Array p_args) {
+  if (is_ready() == false) {
+    ERR_FAIL_COND_V(prepare() == false, Variant());
+  }
+
+  // At this point stmt can't be null.
+  CRASH_COND(stmt == nullptr);
+
+  // Error occurred during argument binding
+  if (!SQLite::bind_args(stmt, p_args)) {
+    ERR_FAIL_V_MSG(Variant(),
+                   "Error during arguments set: " + get_last_error_message());
+  }
+
+  // Only the first row is read.
+  Variant result;
+  const int res = sqlite3_step(stmt);
+  if (res == SQLITE_ROW) {
+    if (sqlite3_column_count(stmt) > 0) {
+      result = column_value(stmt, 0);
+    }
+  } else if (res != SQLITE_DONE) {
+    const String error = get_last_error_message();
+    sqlite3_reset(stmt);
+    db->discard_statement_changes();
+    ERR_FAIL_V_MSG(Variant(),
+                   "There was an error during an SQL execution: " + error);
+  }
+
+  if (SQLITE_OK != sqlite3_reset(stmt)) {
+    finalize();
+    ERR_FAIL_V_MSG(result, "Was not possible to reset the query: " +
+                               get_last_error_message());
+  }
+
+  return result;
+}
+
+void SQLiteQuery::reset_column_types() {
+  const int col_count = sqlite3_column_count(stmt);
+  column_types.resize(col_count);
   for (int i = 0; i < col_count; i++) {
-    // Key name
-    const char *col_name = sqlite3_column_name(stmt, i);
-    res[i] = String(col_name);
+    column_types[i] = declared_column_type(stmt, i);
   }
+  row_layout = ROW_UNRESOLVED;
+}
 
-  return res;
+void SQLiteQuery::resolve_decoders() {
+  // The columns without a declared type take the type of the first row,
+  // NULL stays generic.
+  bool all_integer = true;
+  bool all_real = true;
+  for (uint32_t i = 0; i < column_types.size(); i++) {
+    if (column_types[i] == 0) {
+      const int type = sqlite3_column_type(stmt, i);
+      column_types[i] = type == SQLITE_NULL ? 0 : type;
+    }
+    all_integer = all_integer && column_types[i] == SQLITE_INTEGER;
+    all_real = all_real && column_types[i] == SQLITE_FLOAT;
+  }
+
+  column_readers.resize(column_types.size());
+  for (uint32_t i = 0; i < column_types.size(); i++) {
+    switch (column_types[i]) {
+    case SQLITE_INTEGER:
+      column_readers[i] = read_expected_column<SQLITE_INTEGER>;
+      break;
+    case SQLITE_FLOAT:
+      column_readers[i] = read_expected_column<SQLITE_FLOAT>;
+      break;
+    case SQLITE_TEXT:
+      column_readers[i] = read_expected_column<SQLITE_TEXT>;
+      break;
+    case SQLITE_BLOB:
+      column_readers[i] = read_expected_column<SQLITE_BLOB>;
+      break;
+    default:
+      column_readers[i] = column_value;
+      break;
+    }
+  }
+
+  if (column_types.size() > 0 && all_integer) {
+    row_layout = ROW_INTEGER;
+  } else if (column_types.size() > 0 && all_real) {
+    row_layout = ROW_REAL;
+  } else {
+    row_layout = ROW_MIXED;
+  }
 }
 
-bool SQLiteQuery::prepare() {
-  ERR_FAIL_COND_V(stmt != nullptr, false);
-  ERR_FAIL_COND_V(db == nullptr, false);
-  ERR_FAIL_COND_V(query == "", false);
+Array SQLiteQuery::decode_row() {
+  const int col_count = sqlite3_column_count(stmt);
+  if (unlikely(col_count != int(column_types.size()))) {
+    // SQLite prepared the statement again after a schema change, and
+    // `SELECT *` now has other columns.
+    reset_column_types();
+  }
+  if (unlikely(row_layout == ROW_UNRESOLVED)) {
+    resolve_decoders();
+  }
+  switch (row_layout) {
+  case ROW_INTEGER:
+    return decode_uniform_row<SQLITE_INTEGER>(stmt, col_count);
+  case ROW_REAL:
+    return decode_uniform_row<SQLITE_FLOAT>(stmt, col_count);
+  default: {
+    Array result;
+    result.resize(col_count);
+    for (int i = 0; i < col_count; i++) {
+      result[i] = column_readers[i](stmt, i);
+    }
+    return result;
+  }
+  }
+}
 
-  // Prepare the statement
-  int result = sqlite3_prepare_v2(db->get_handler(), query.utf8().ptr(), -1,
-                                  &stmt, nullptr);
+bool SQLiteQuery::map_object_columns(const Variant &p_class) {
+  object_class = Variant();
+  object_native_class = StringName();
+  object_script.unref();
+  object_columns.clear();
+
+  if (p_class.get_type() == Variant::OBJECT) {
+    object_script = p_class;
+    ERR_FAIL_COND_V_MSG(object_script.is_null(), false,
+                        "Expected a class name or a Script.");
+  } else {
+    const StringName class_name = p_class;
+    if (ScriptServer::is_global_class(class_name)) {
+      object_script =
+          ResourceLoader::load(ScriptServer::get_global_class_path(class_name));
+      ERR_FAIL_COND_V_MSG(object_script.is_null(), false,
+                          "Cannot load the script of " + class_name);
+    } else {
+      ERR_FAIL_COND_V_MSG(!ClassDB::can_instantiate(class_name), false,
+                          "Cannot instantiate the class " + class_name);
+      object_native_class = class_name;
+    }
+  }
 
-  // Cannot prepare query!
-  ERR_FAIL_COND_V_MSG(result != SQLITE_OK, false,
-                      "SQL Error: " + db->get_last_error_message());
+  HashSet<StringName> script_properties;
+  if (object_script.is_valid()) {
+    ERR_FAIL_COND_V_MSG(!object_script->can_instantiate(), false,
+                        "Cannot instantiate the script " +
+                            object_script->get_path());
+    object_native_class = object_script->get_instance_base_type();
+    List<PropertyInfo> properties;
+    object_script->get_script_property_list(&properties);
+    for (const PropertyInfo &property : properties) {
+      script_properties.insert(property.name);
+    }
+  }
+
+  const int col_count = sqlite3_column_count(stmt);
+  object_columns.resize(col_count);
+  for (int i = 0; i < col_count; i++) {
+    ObjectColumn &column = object_columns[i];
+    column.property = StringName(sqlite3_column_name(stmt, i));
+    column.assigned = true;
+    if (script_properties.has(column.property)) {
+      // Script members don't have a MethodBind, they are set by the
+      // instance.
+      continue;
+    }
+    if (!ClassDB::has_property(object_native_class, column.property)) {
+      WARN_PRINT("The column " + column.property +
+                 " doesn't match any property of " + String(p_class) +
+                 ", it's ignored.");
+      column.assigned = false;
+      continue;
+    }
+    // Indexed properties share a setter, they go through `Object::set()`.
+    if (ClassDB::get_property_index(object_native_class, column.property) !=
+        -1) {
+      continue;
+    }
+    const StringName setter =
+        ClassDB::get_property_setter(object_native_class, column.property);
+    if (setter != StringName()) {
+      column.setter = ClassDB::get_method(object_native_class, setter);
+    }
+  }
 
+  object_class = p_class;
   return true;
 }
 
-void SQLiteQuery::finalize() {
-  if (stmt) {
-    sqlite3_finalize(stmt);
-    stmt = nullptr;
+Object *SQLiteQuery::instantiate_object() const {
+  Object *object = ClassDB::instantiate(object_native_class);
+  if (object != nullptr && object_script.is_valid()) {
+    object->set_script(object_script);
+  }
+  return object;
+}
+
+String SQLiteQuery::execute_json(Array p_args, bool p_columnar) {
+  const PackedByteArray json = execute_json_bytes(p_args, p_columnar);
+  String result;
+  result.parse_utf8((const char *)json.ptr(), json.size());
+  return result;
+}
+
+PackedByteArray SQLiteQuery::execute_json_bytes(Array p_args,
+                                                bool p_columnar) {
+  if (is_ready() == false) {
+    ERR_FAIL_COND_V(prepare() == false, PackedByteArray());
+  }
+
+  // At this point stmt can't be null.
+  CRASH_COND(stmt == nullptr);
+
+  // Error occurred during argument binding
+  if (!SQLite::bind_args(stmt, p_args)) {
+    ERR_FAIL_V_MSG(PackedByteArray(),
+                   "Error during arguments set: " + get_last_error_message());
+  }
+
+  JSONWriter writer;
+  const bool done = write_json_result(stmt, p_columnar, writer);
+  if (!done) {
+    const String error = get_last_error_message();
+    sqlite3_reset(stmt);
+    db->discard_statement_changes();
+    ERR_FAIL_V_MSG(PackedByteArray(),
+                   "There was an error during an SQL execution: " + error);
+  }
+
+  if (SQLITE_OK != sqlite3_reset(stmt)) {
+    finalize();
+    ERR_FAIL_V_MSG(PackedByteArray(), "Was not possible to reset the query: " +
+                                          get_last_error_message());
+  }
+
+  PackedByteArray result;
+  result.resize(writer.buffer.size());
+  memcpy(result.ptrw(), writer.buffer.ptr(), writer.buffer.size());
+  return result;
+}
+
+Array SQLiteQuery::get_columns() {
+  if (is_ready() == false) {
+    ERR_FAIL_COND_V(prepare() == false, Array());
+  }
+
+  // At this point stmt can't be null.
+  CRASH_COND(stmt == nullptr);
+
+  Array res;
+  const int col_count = sqlite3_column_count(stmt);
+  res.resize(col_count);
+
+  // Fetch all column
+  for (int i = 0; i < col_count; i++) {
+    // Key name
+    const char *col_name = sqlite3_column_name(stmt, i);
+    res[i] = String(col_name);
+  }
+
+  return res;
+}
+
+bool SQLiteQuery::prepare() {
+  ERR_FAIL_COND_V(stmt != nullptr, false);
+  ERR_FAIL_COND_V(db == nullptr, false);
+  ERR_FAIL_COND_V(query == "", false);
+  ERR_FAIL_COND_V_MSG(db->is_open_pending(), false,
+                      "The database is being opened on a thread.");
+
+  // The authorizer lists the tables read by the statement.
+  cached_tables.clear();
+  if (cache_results) {
+    db->start_result_cache_tracking();
+    db->discovered_tables = &cached_tables;
+    db->discovered_uncacheable = false;
+  }
+
+  // Prepare the statement
+  int result = sqlite3_prepare_v2(db->get_handler(), query.utf8().ptr(), -1,
+                                  &stmt, nullptr);
+  db->discovered_tables = nullptr;
+
+  // Cannot prepare query!
+  ERR_FAIL_COND_V_MSG(result != SQLITE_OK, false,
+                      "SQL Error: " + db->get_last_error_message());
+
+  // The row decoders are chosen with the first row.
+  reset_column_types();
+
+  if (cache_results) {
+    cacheable = !db->discovered_uncacheable && sqlite3_stmt_readonly(stmt) &&
+                db->check_cached_tables(cached_tables);
+    if (!cacheable) {
+      WARN_PRINT("The results of this query can't be cached: " + query);
+    }
+  }
+
+  return true;
+}
+
+void SQLiteQuery::finalize() {
+  if (stmt) {
+    sqlite3_finalize(stmt);
+    stmt = nullptr;
+    db->result_cache.remove_query(id);
+  }
+  column_types.clear();
+  column_readers.clear();
+  row_layout = ROW_UNRESOLVED;
+  object_class = Variant();
+  object_columns.clear();
+}
+
+void SQLiteQuery::set_cache_results(bool p_enabled) {
+  if (cache_results == p_enabled) {
+    return;
+  }
+  cache_results = p_enabled;
+  // Prepared again, to find the tables it reads.
+  finalize();
+}
+
+bool SQLiteQuery::is_caching_results() const { return cache_results; }
+
+void SQLiteQuery::_bind_methods() {
+  ClassDB::bind_method(D_METHOD("get_last_error_message"),
+                       &SQLiteQuery::get_last_error_message);
+  ClassDB::bind_method(D_METHOD("execute", "arguments"), &SQLiteQuery::execute,
+                       DEFVAL(Array()));
+  ClassDB::bind_method(D_METHOD("batch_execute", "rows"),
+                       &SQLiteQuery::batch_execute);
+  ClassDB::bind_method(
+      D_METHOD("execute_column", "arguments", "column", "type"),
+      &SQLiteQuery::execute_column, DEFVAL(Array()), DEFVAL(0),
+      DEFVAL(Variant::NIL));
+  ClassDB::bind_method(D_METHOD("execute_scalar", "arguments"),
+                       &SQLiteQuery::execute_scalar, DEFVAL(Array()));
+  ClassDB::bind_method(D_METHOD("execute_json", "arguments", "columnar"),
+                       &SQLiteQuery::execute_json, DEFVAL(Array()),
+                       DEFVAL(false));
+  ClassDB::bind_method(D_METHOD("execute_json_bytes", "arguments", "columnar"),
+                       &SQLiteQuery::execute_json_bytes, DEFVAL(Array()),
+                       DEFVAL(false));
+  ClassDB::bind_method(D_METHOD("execute_into_objects", "class", "arguments"),
+                       &SQLiteQuery::execute_into_objects, DEFVAL(Array()));
+  ClassDB::bind_method(D_METHOD("get_columns"), &SQLiteQuery::get_columns);
+  ClassDB::bind_method(D_METHOD("set_cache_results", "enabled"),
+                       &SQLiteQuery::set_cache_results);
+  ClassDB::bind_method(D_METHOD("is_caching_results"),
+                       &SQLiteQuery::is_caching_results);
+
+  ADD_PROPERTY(PropertyInfo(Variant::BOOL, "cache_results"),
+               "set_cache_results", "is_caching_results");
+}
+
+SQLite::SQLite() {
+  db = nullptr;
+  memory_read = false;
+}
+/*
+        Open a database file.
+        If this is running outside of the editor, databases under res:// are
+   assumed to be packed.
+        @param path The database resource path.
+        @return status
+*/
+bool SQLite::open(String path) {
+  ERR_FAIL_COND_V_MSG(is_open_pending(), false,
+                      "The database is being opened on a thread.");
+  if (!path.strip_edges().length())
+    return false;
+
+  SQLitePageCacheScope page_cache_scope(this, path);
+
+  if (sqlite_zvfs_is_compressed(path)) {
+    // Read in place, only the groups of pages used are decompressed.
+    int result = sqlite3_open_v2(path.utf8().get_data(), &db,
+                                 SQLITE_OPEN_READONLY, SQLITE_ZVFS_NAME);
+    if (result != SQLITE_OK) {
+      print_error("Cannot open compressed database: " +
+                  get_last_error_message());
+      sqlite3_close_v2(db);
+      db = nullptr;
+      return false;
+    }
+    return setup_connection();
+  }
+
+  if (!Engine::get_singleton()->is_editor_hint() &&
+      path.begins_with("res://")) {
+    Ref<core_bind::File> dbfile;
+    dbfile.instantiate();
+    if (dbfile->open(path, core_bind::File::READ) != Error::OK) {
+      print_error("Cannot open packed database!");
+      return false;
+    }
+    int64_t size = dbfile->get_length();
+    PackedByteArray buffer = dbfile->get_buffer(size);
+    return open_buffered(path, buffer, size);
+  }
+
+  String real_path =
+      ProjectSettings::get_singleton()->globalize_path(path.strip_edges());
+
+  int result = sqlite3_open(real_path.utf8().get_data(), &db);
+
+  if (result != SQLITE_OK) {
+    print_error("Cannot open database!");
+    return false;
+  }
+
+  return setup_connection();
+}
+
+// Pragmas accepted by `open_with_options()`, in the order they are applied:
+// the page size can only change before the journal switches to WAL.
+static const char *OPEN_PRAGMAS[] = {
+    "page_size", "journal_mode", "synchronous",
+    "cache_size", "mmap_size", "temp_store",
+};
+
+static Dictionary open_preset(const String &p_name) {
+  Dictionary preset;
+  if (p_name == "read_mostly") {
+    // Readers never block on the writer, and hot pages are served from the
+    // memory map instead of being copied in the page cache.
+    preset["journal_mode"] = "wal";
+    preset["synchronous"] = "normal";
+    preset["cache_size"] = -16384;
+    preset["mmap_size"] = 256 * 1024 * 1024;
+    preset["temp_store"] = "memory";
+  } else if (p_name == "write_heavy") {
+    // Commits only append to the WAL, which is synced at checkpoints.
+    preset["journal_mode"] = "wal";
+    preset["synchronous"] = "normal";
+    preset["cache_size"] = -32768;
+    preset["temp_store"] = "memory";
+    preset["busy_timeout"] = 5000;
+  } else if (p_name == "bulk_load") {
+    // Not crash safe: meant to fill a database that can be rebuilt.
+    preset["journal_mode"] = "memory";
+    preset["synchronous"] = "off";
+    preset["cache_size"] = -65536;
+    preset["temp_store"] = "memory";
+  }
+  return preset;
+}
+
+static bool validate_keyword(const String &p_name, const Variant &p_value,
+                             const char *const *p_keywords, int p_count,
+                             String &r_value) {
+  if (p_value.get_type() == Variant::INT) {
+    const int64_t index = p_value;
+    ERR_FAIL_COND_V_MSG(index < 0 || index >= p_count, false,
+                        "Invalid `" + p_name + "` option: " + itos(index));
+    r_value = p_keywords[index];
+    return true;
+  }
+  ERR_FAIL_COND_V_MSG(p_value.get_type() != Variant::STRING, false,
+                      "The `" + p_name + "` option must be a String.");
+  const String keyword = String(p_value).to_lower();
+  for (int i = 0; i < p_count; i += 1) {
+    if (keyword == p_keywords[i]) {
+      r_value = keyword;
+      return true;
+    }
+  }
+  ERR_FAIL_V_MSG(false, "Invalid `" + p_name + "` option: " + keyword);
+}
+
+static bool validate_pragma(const String &p_name, const Variant &p_value,
+                            String &r_value) {
+  static const char *JOURNAL_MODES[] = {"delete", "truncate", "persist",
+                                        "memory", "wal",      "off"};
+  static const char *SYNCHRONOUS[] = {"off", "normal", "full", "extra"};
+  static const char *TEMP_STORES[] = {"default", "file", "memory"};
+
+  if (p_name == "journal_mode") {
+    // Journal modes have no numeric value.
+    ERR_FAIL_COND_V_MSG(p_value.get_type() != Variant::STRING, false,
+                        "The `journal_mode` option must be a String.");
+    return validate_keyword(p_name, p_value, JOURNAL_MODES, 6, r_value);
+  }
+  if (p_name == "synchronous") {
+    return validate_keyword(p_name, p_value, SYNCHRONOUS, 4, r_value);
+  }
+  if (p_name == "temp_store") {
+    return validate_keyword(p_name, p_value, TEMP_STORES, 3, r_value);
+  }
+
+  ERR_FAIL_COND_V_MSG(p_value.get_type() != Variant::INT, false,
+                      "The `" + p_name + "` option must be an int.");
+  const int64_t value = p_value;
+  if (p_name == "page_size") {
+    ERR_FAIL_COND_V_MSG(value < 512 || value > 65536 ||
+                            (value & (value - 1)) != 0,
+                        false,
+                        "The `page_size` option must be a power of two "
+                        "between 512 and 65536.");
+  } else if (p_name == "mmap_size") {
+    ERR_FAIL_COND_V_MSG(value < 0, false,
+                        "The `mmap_size` option can't be negative.");
+  }
+  // `cache_size` is a number of pages, or of KiB when negative.
+  r_value = itos(value);
+  return true;
+}
+
+bool SQLite::parse_open_options(const Dictionary &p_options,
+                                OpenOptions &r_options) {
+  Dictionary options;
+  if (p_options.has("preset")) {
+    const String preset = p_options["preset"];
+    options = open_preset(preset);
+    ERR_FAIL_COND_V_MSG(options.is_empty(), false,
+                        "Unknown open preset: " + preset);
+  }
+  // Explicit options take precedence over the preset.
+  const Array option_keys = p_options.keys();
+  for (int i = 0; i < option_keys.size(); i += 1) {
+    if (String(option_keys[i]) != "preset") {
+      options[option_keys[i]] = p_options[option_keys[i]];
+    }
+  }
+
+  Dictionary pragmas;
+  const Array keys = options.keys();
+  for (int i = 0; i < keys.size(); i += 1) {
+    const String key = keys[i];
+    const Variant &value = options[keys[i]];
+
+    if (key == "read_only" || key == "no_mutex" || key == "uri" ||
+        key == "immutable") {
+      ERR_FAIL_COND_V_MSG(value.get_type() != Variant::BOOL, false,
+                          "The `" + key + "` option must be a bool.");
+      if (!bool(value)) {
+        continue;
+      }
+      if (key == "read_only" || key == "immutable") {
+        r_options.flags &= ~(SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE);
+        r_options.flags |= SQLITE_OPEN_READONLY;
+      }
+      if (key == "no_mutex") {
+        r_options.flags |= SQLITE_OPEN_NOMUTEX;
+      }
+      if (key == "uri" || key == "immutable") {
+        r_options.flags |= SQLITE_OPEN_URI;
+      }
+      r_options.uri = r_options.uri || key == "uri";
+      r_options.immutable = r_options.immutable || key == "immutable";
+    } else if (key == "prefault") {
+      ERR_FAIL_COND_V_MSG(value.get_type() != Variant::BOOL, false,
+                          "The `prefault` option must be a bool.");
+      r_options.prefault = value;
+    } else if (key == "busy_timeout") {
+      ERR_FAIL_COND_V_MSG(value.get_type() != Variant::INT || int(value) < 0,
+                          false,
+                          "The `busy_timeout` option must be a positive int.");
+      r_options.busy_timeout = value;
+    } else {
+      bool known = false;
+      for (const char *name : OPEN_PRAGMAS) {
+        known = known || key == name;
+      }
+      ERR_FAIL_COND_V_MSG(!known, false, "Unknown open option: " + key);
+      String pragma_value;
+      if (!validate_pragma(key, value, pragma_value)) {
+        return false;
+      }
+      pragmas[key] = pragma_value;
+    }
+  }
+
+  const bool read_only = (r_options.flags & SQLITE_OPEN_READONLY) != 0;
+  for (const char *name : OPEN_PRAGMAS) {
+    if (!pragmas.has(name)) {
+      continue;
+    }
+    // Both rewrite the file, which a read only connection can't do.
+    if (read_only && (String(name) == "page_size" ||
+                      String(name) == "journal_mode")) {
+      continue;
+    }
+    r_options.pragmas.push_back(Pair<String, String>(name, pragmas[name]));
+  }
+  return true;
+}
+
+bool SQLite::apply_open_options(const OpenOptions &p_options) {
+  sqlite3 *dbs = get_handler();
+  ERR_FAIL_COND_V(dbs == nullptr, false);
+
+  if (p_options.busy_timeout >= 0) {
+    sqlite3_busy_timeout(dbs, p_options.busy_timeout);
+  }
+
+  for (const Pair<String, String> &pragma : p_options.pragmas) {
+    const String statement =
+        "PRAGMA " + pragma.first + " = " + pragma.second + ";";
+    sqlite3_stmt *stmt = prepare(statement.utf8().get_data());
+    if (stmt == nullptr) {
+      return false;
+    }
+    const int result = sqlite3_step(stmt);
+    String applied;
+    if (result == SQLITE_ROW) {
+      applied = String::utf8(
+          reinterpret_cast<const char *>(sqlite3_column_text(stmt, 0)));
+    }
+    sqlite3_finalize(stmt);
+    ERR_FAIL_COND_V_MSG(result != SQLITE_ROW && result != SQLITE_DONE, false,
+                        "Cannot apply `" + statement +
+                            "`: " + get_last_error_message());
+
+    // SQLite keeps the previous journal mode when the new one isn't
+    // supported, for example WAL on an in memory database.
+    if (pragma.first == "journal_mode" && applied.to_lower() != pragma.second) {
+      WARN_PRINT("The journal mode `" + pragma.second +
+                 "` isn't supported by this database, it uses `" + applied +
+                 "`.");
+    }
+    // Capped by SQLITE_MAX_MMAP_SIZE, and 0 when the VFS can't map.
+    if (pragma.first == "mmap_size" && result == SQLITE_ROW &&
+        applied.to_int() != pragma.second.to_int()) {
+      WARN_PRINT("`mmap_size` is limited to " + applied +
+                 " bytes for this database.");
+    }
+  }
+  return true;
+}
+
+/*
+        Open a database file with the given `sqlite3_open_v2()` flags and
+   pragmas. See `SQLite::open_with_options()` for the supported options.
+        @param path The database resource path.
+        @param options The options Dictionary.
+        @return status
+*/
+bool SQLite::open_with_options(String p_path, Dictionary p_options) {
+  ERR_FAIL_COND_V_MSG(is_open_pending(), false,
+                      "The database is being opened on a thread.");
+  if (!p_path.strip_edges().length()) {
+    return false;
+  }
+
+  OpenOptions options;
+  if (!parse_open_options(p_options, options)) {
+    return false;
+  }
+
+  // Also covers the pragmas: changing the page size recreates the cache.
+  SQLitePageCacheScope page_cache_scope(this, p_path);
+
+  const bool from_memory = (!Engine::get_singleton()->is_editor_hint() &&
+                            p_path.begins_with("res://")) ||
+                           sqlite_zvfs_is_compressed(p_path);
+  if (from_memory) {
+    // Packed and compressed databases are read from memory: only the
+    // pragmas apply.
+    if (!open(p_path)) {
+      return false;
+    }
+  } else {
+    String real_path = p_path.strip_edges();
+    if (!options.uri) {
+      real_path = ProjectSettings::get_singleton()->globalize_path(real_path);
+    }
+    if (options.immutable) {
+      // `immutable` is only available as a URI parameter.
+      if (!options.uri) {
+        real_path = real_path.replace("%", "%25")
+                        .replace("?", "%3f")
+                        .replace("#", "%23");
+        if (!real_path.begins_with("/")) {
+          real_path = "/" + real_path;
+        }
+        real_path = "file://" + real_path;
+      }
+      real_path += real_path.find("?") == -1 ? "?immutable=1" : "&immutable=1";
+    }
+
+    const int result = sqlite3_open_v2(real_path.utf8().get_data(), &db,
+                                       options.flags, nullptr);
+    if (result != SQLITE_OK) {
+      print_error("Cannot open database: " + get_last_error_message());
+      // A handle is allocated even when the open fails.
+      sqlite3_close_v2(db);
+      db = nullptr;
+      return false;
+    }
+    if (!setup_connection()) {
+      return false;
+    }
+  }
+
+  if (!apply_open_options(options)) {
+    close();
+    return false;
+  }
+  if (options.prefault) {
+    if (from_memory) {
+      WARN_PRINT("`prefault` has no effect on packed and compressed "
+                 "databases.");
+    } else {
+      sqlite_memory_prefault(get_handler());
+    }
+  }
+  return true;
+}
+
+bool SQLite::open_async(String p_path, Dictionary p_options) {
+  ERR_FAIL_COND_V_MSG(open_thread.is_started(), false,
+                      "The database is already being opened.");
+  ERR_FAIL_COND_V_MSG(get_handler() != nullptr, false,
+                      "The database is already opened.");
+  if (!p_path.strip_edges().length()) {
+    return false;
+  }
+
+  AsyncOpen open;
+  open.path = p_path;
+  open.options = p_options.duplicate();
+  if (open.options.has("warm_up")) {
+    const Variant names = open.options["warm_up"];
+    ERR_FAIL_COND_V_MSG(names.get_type() != Variant::ARRAY &&
+                            names.get_type() != Variant::PACKED_STRING_ARRAY,
+                        false,
+                        "The `warm_up` option must be an array of names.");
+    open.warm_up = names;
+    open.options.erase("warm_up");
+  }
+  if (open.options.has("prepare_queries")) {
+    const Variant prepare_queries = open.options["prepare_queries"];
+    ERR_FAIL_COND_V_MSG(prepare_queries.get_type() != Variant::BOOL, false,
+                        "The `prepare_queries` option must be a bool.");
+    open.prepare_queries = prepare_queries;
+    open.options.erase("prepare_queries");
+  }
+  // Fails now, rather than on the thread.
+  OpenOptions options;
+  if (!parse_open_options(open.options, options)) {
+    return false;
+  }
+
+  async_open = open;
+  open_thread.start(open_thread_func, this);
+  return true;
+}
+
+void SQLite::open_thread_func(void *p_self) {
+  SQLite *self = static_cast<SQLite *>(p_self);
+  AsyncOpen &open = self->async_open;
+  open.success = self->open_with_options(open.path, open.options);
+  if (open.success) {
+    self->warm_up(open.warm_up);
+  }
+  self->call_deferred(SNAME("_open_async_finished"));
+}
+
+void SQLite::warm_up(const PackedStringArray &p_names) {
+  sqlite3 *dbs = get_handler();
+  // Parses the schema, which is otherwise done by the first query.
+  sqlite3_exec(dbs, "SELECT count(*) FROM sqlite_schema;", nullptr, nullptr,
+               nullptr);
+  if (p_names.is_empty()) {
+    return;
+  }
+
+  sqlite3_stmt *find = prepare(
+      "SELECT type, tbl_name, (SELECT name FROM pragma_index_info(name) "
+      "WHERE seqno = 0) FROM sqlite_schema WHERE name = ? AND type IN "
+      "('table', 'index');");
+  ERR_FAIL_COND(find == nullptr);
+
+  for (int i = 0; i < p_names.size(); i++) {
+    const String &name = p_names[i];
+    const CharString name_utf8 = name.utf8();
+    sqlite3_bind_text(find, 1, name_utf8.get_data(), -1, SQLITE_STATIC);
+    if (sqlite3_step(find) != SQLITE_ROW) {
+      WARN_PRINT("Cannot warm up `" + name + "`: no such table or index.");
+      sqlite3_reset(find);
+      continue;
+    }
+    const String type = reinterpret_cast<const char *>(
+        sqlite3_column_text(find, 0));
+    const String table = String::utf8(
+        reinterpret_cast<const char *>(sqlite3_column_text(find, 1)));
+    const char *column =
+        reinterpret_cast<const char *>(sqlite3_column_text(find, 2));
+
+    // Reads every page of the b-tree: count(*) walks the table itself when
+    // no index may be used, and the index is scanned in order, covering its
+    // first column.
+    String statement;
+    if (type == "table") {
+      statement = "SELECT count(*) FROM " + quote_identifier(table) +
+                  " NOT INDEXED;";
+    } else if (column != nullptr) {
+      const String first = quote_identifier(String::utf8(column));
+      statement = "SELECT " + first + " FROM " + quote_identifier(table) +
+                  " INDEXED BY " + quote_identifier(name) + " ORDER BY " +
+                  first + ";";
+    }
+    sqlite3_reset(find);
+
+    if (statement.is_empty() ||
+        sqlite3_exec(dbs, statement.utf8().get_data(), nullptr, nullptr,
+                     nullptr) != SQLITE_OK) {
+      // Expression and partial indexes can't be scanned this way.
+      WARN_PRINT("Cannot warm up `" + name + "`.");
+    }
+  }
+  sqlite3_finalize(find);
+}
+
+bool SQLite::is_open_pending() const {
+  return open_thread.is_started() &&
+         Thread::get_caller_id() != open_thread.get_id();
+}
+
+void SQLite::_open_async_finished() {
+  // Each thread queues one call: this one is for the open aborted by
+  // `close()`, any later open has its own.
+  if (open_aborted) {
+    open_aborted = false;
+    emit_signal(SNAME("opened"), false);
+    return;
+  }
+  finish_open_async();
+}
+
+void SQLite::finish_open_async() {
+  // Already joined by `wait_open()`.
+  if (!open_thread.is_started()) {
+    return;
+  }
+  open_thread.wait_to_finish();
+  if (async_open.success && async_open.prepare_queries) {
+    prepare_all();
+  }
+  emit_signal(SNAME("opened"), async_open.success);
+}
+
+bool SQLite::is_opening() const { return open_thread.is_started(); }
+
+bool SQLite::wait_open() {
+  ERR_FAIL_COND_V_MSG(open_thread.is_started() &&
+                          Thread::get_caller_id() == open_thread.get_id(),
+                      false, "Cannot wait for the open from its thread.");
+  finish_open_async();
+  return get_handler() != nullptr;
+}
+
+bool SQLite::open_in_memory() {
+  ERR_FAIL_COND_V_MSG(is_open_pending(), false,
+                      "The database is being opened on a thread.");
+  const String name = ":memory:";
+  SQLitePageCacheScope page_cache_scope(this, name);
+  int result = sqlite3_open(":memory:", &db);
+  ERR_FAIL_COND_V_MSG(result != SQLITE_OK, false,
+                      "Cannot open database in memory, error:" + itos(result));
+  return setup_connection();
+}
+
+/*
+  Open the database and initialize memory buffer.
+  @param name Name of the database.
+  @param buffers The database buffer.
+  @param size Size of the database;
+  @return status
+*/
+bool SQLite::open_buffered(String name, PackedByteArray buffers, int64_t size) {
+  return open_memory(name, buffers, size, SPMEMVFS_NAME);
+}
+
+bool SQLite::open_memory(const String &name, const PackedByteArray &buffers,
+                         int64_t size, const char *vfs) {
+  ERR_FAIL_COND_V_MSG(is_open_pending(), false,
+                      "The database is being opened on a thread.");
+  if (!name.strip_edges().length()) {
+    return false;
+  }
+
+  if (!buffers.size() || !size) {
+    return false;
+  }
+
+  spmembuffer_t *p_mem = (spmembuffer_t *)calloc(1, sizeof(spmembuffer_t));
+  p_mem->total = p_mem->used = size;
+  p_mem->data = (char *)malloc(size + 1);
+  memcpy(p_mem->data, buffers.ptr(), size);
+  p_mem->data[size] = '\0';
+
+  //
+  spmemvfs_env_init();
+  SQLitePageCacheScope page_cache_scope(this, name);
+  int err = spmemvfs_open_db_vfs(&p_db, name.utf8().get_data(), p_mem, vfs);
+
+  if (err != SQLITE_OK || p_db.mem != p_mem) {
+    print_error("Cannot open buffered database!");
+    return false;
+  }
+
+  memory_read = true;
+  return setup_connection();
+}
+
+/*
+        Open a database encrypted with AES, creating it if needed.
+        If this is running outside of the editor, databases under res:// are
+   assumed to be packed, and are read from memory.
+        @param path The database resource path.
+        @param key The 16, 24 or 32 bytes key.
+        @return status
+*/
+bool SQLite::open_encrypted(String p_path, PackedByteArray p_key) {
+  ERR_FAIL_COND_V_MSG(is_open_pending(), false,
+                      "The database is being opened on a thread.");
+  if (!p_path.strip_edges().length()) {
+    return false;
+  }
+
+  SQLitePageCacheScope page_cache_scope(this, p_path);
+  bool opened = false;
+  if (!Engine::get_singleton()->is_editor_hint() &&
+      p_path.begins_with("res://")) {
+    Ref<core_bind::File> dbfile;
+    dbfile.instantiate();
+    if (dbfile->open(p_path, core_bind::File::READ) != Error::OK) {
+      print_error("Cannot open packed database!");
+      return false;
+    }
+    int64_t size = dbfile->get_length();
+    PackedByteArray buffer = dbfile->get_buffer(size);
+
+    spmemvfs_env_init();
+    if (!sqlite_crypt_initialize_memory()) {
+      return false;
+    }
+    encrypted_name =
+        sqlite_crypt_add_key(SQLITE_CRYPT_MEMORY_NAME, p_path, p_key);
+    if (encrypted_name.is_empty()) {
+      return false;
+    }
+    opened = open_memory(p_path, buffer, size, SQLITE_CRYPT_MEMORY_NAME);
+  } else {
+    String real_path =
+        ProjectSettings::get_singleton()->globalize_path(p_path.strip_edges());
+    encrypted_name = sqlite_crypt_add_key(SQLITE_CRYPT_NAME, real_path, p_key);
+    if (encrypted_name.is_empty()) {
+      return false;
+    }
+    int result = sqlite3_open_v2(real_path.utf8().get_data(), &db,
+                                 SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE,
+                                 SQLITE_CRYPT_NAME);
+    if (result != SQLITE_OK) {
+      print_error("Cannot open database: " + get_last_error_message());
+    }
+    opened = result == SQLITE_OK && setup_connection();
+  }
+  if (!opened) {
+    close();
+    return false;
+  }
+
+  // Temporary files aren't encrypted, they must stay in memory. Reading the
+  // schema fails right away when the key is wrong.
+  char *error = nullptr;
+  const int result = sqlite3_exec(
+      get_handler(),
+      "PRAGMA temp_store = MEMORY; SELECT count(*) FROM sqlite_schema;",
+      nullptr, nullptr, &error);
+  if (result != SQLITE_OK) {
+    print_error("Cannot open encrypted database, wrong key? " +
+                String::utf8(error));
+    sqlite3_free(error);
+    close();
+    return false;
+  }
+  return true;
+}
+
+bool SQLite::setup_connection() {
+  if (configure_connection()) {
+    return true;
+  }
+  // Otherwise the database would look open, and the handle would leak on
+  // the next open.
+  close();
+  return false;
+}
+
+bool SQLite::configure_connection() {
+  sqlite3 *dbs = get_handler();
+  ERR_FAIL_COND_V(dbs == nullptr, false);
+
+  if (sqlite_pcache_is_enabled()) {
+    // Reads the database header while the page cache scope is alive: when
+    // the page size isn't the default one the cache is created again, and
+    // must still be attributed to this connection.
+    sqlite3_exec(dbs, "PRAGMA schema_version;", nullptr, nullptr, nullptr);
+  }
+
+  if (!sqlite_register_builtin_functions(dbs)) {
+    return false;
+  }
+  if (!sqlite_register_carray(dbs)) {
+    return false;
+  }
+  if (!sqlite_register_vector_functions(dbs)) {
+    return false;
+  }
+
+  sqlite3_update_hook(dbs, update_hook, this);
+  sqlite3_commit_hook(dbs, commit_hook, this);
+  sqlite3_rollback_hook(dbs, rollback_hook, this);
+  if (change_notifications != CHANGE_NOTIFICATIONS_DISABLED) {
+    install_statement_hooks();
+  }
+  for (const UserFunction &function : functions) {
+    if (!register_function(function)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+bool SQLite::register_function(const UserFunction &p_function) {
+  sqlite3 *dbs = get_handler();
+  int result;
+  if (p_function.function.is_null()) {
+    result = sqlite_create_callable_aggregate(
+        dbs, p_function.name, p_function.step, p_function.final,
+        p_function.argc, p_function.deterministic);
+  } else {
+    result = sqlite_create_callable_function(dbs, p_function.name,
+                                             p_function.function,
+                                             p_function.argc,
+                                             p_function.deterministic);
+  }
+  ERR_FAIL_COND_V_MSG(result != SQLITE_OK, false,
+                      "Cannot register the SQL function `" + p_function.name +
+                          "`: " + get_last_error_message());
+  return true;
+}
+
+bool SQLite::create_function(String p_name, Callable p_function, int p_argc,
+                             bool p_deterministic) {
+  ERR_FAIL_COND_V(p_name.is_empty(), false);
+  ERR_FAIL_COND_V_MSG(p_function.is_null(), false,
+                      "The SQL function `" + p_name + "` needs a Callable.");
+  ERR_FAIL_COND_V(p_argc < -1, false);
+
+  UserFunction function;
+  function.name = p_name;
+  function.function = p_function;
+  function.argc = p_argc;
+  function.deterministic = p_deterministic;
+
+  // Install it right away if the database is already open.
+  if (get_handler() != nullptr && !register_function(function)) {
+    return false;
+  }
+  functions.push_back(function);
+  return true;
+}
+
+bool SQLite::create_aggregate(String p_name, Callable p_step, Callable p_final,
+                              int p_argc, bool p_deterministic) {
+  ERR_FAIL_COND_V(p_name.is_empty(), false);
+  ERR_FAIL_COND_V_MSG(p_step.is_null() || p_final.is_null(), false,
+                      "The SQL aggregate `" + p_name +
+                          "` needs both a step and a final Callable.");
+  ERR_FAIL_COND_V(p_argc < -1, false);
+
+  UserFunction function;
+  function.name = p_name;
+  function.step = p_step;
+  function.final = p_final;
+  function.argc = p_argc;
+  function.deterministic = p_deterministic;
+
+  if (get_handler() != nullptr && !register_function(function)) {
+    return false;
+  }
+  functions.push_back(function);
+  return true;
+}
+
+void SQLite::close() {
+  if (is_open_pending()) {
+    // Closes the connection once opened. The call to `_open_async_finished()`
+    // queued by the thread reports it.
+    open_thread.wait_to_finish();
+    open_aborted = true;
+  }
+
+  // Finalize all queries before close the DB.
+  // Reverse order because I need to remove the not available queries.
+  for (uint32_t i = queries.size(); i > 0; i -= 1) {
+    SQLiteQuery *query =
+        Object::cast_to<SQLiteQuery>(queries[i - 1]->get_ref());
+    if (query != nullptr) {
+      query->finalize();
+    } else {
+      memdelete(queries[i - 1]);
+      queries.remove_at(i - 1);
+    }
+  }
+
+  clear_upsert_statements();
+
+  for (uint32_t i = scripts.size(); i > 0; i -= 1) {
+    SQLiteCompiledScript *script =
+        Object::cast_to<SQLiteCompiledScript>(scripts[i - 1]->get_ref());
+    if (script != nullptr) {
+      script->finalize();
+    } else {
+      memdelete(scripts[i - 1]);
+      scripts.remove_at(i - 1);
+    }
+  }
+
+  for (uint32_t i = sessions.size(); i > 0; i -= 1) {
+    SQLiteSession *session =
+        Object::cast_to<SQLiteSession>(sessions[i - 1]->get_ref());
+    if (session != nullptr) {
+      session->close();
+    }
+    memdelete(sessions[i - 1]);
+  }
+  sessions.clear();
+
+  for (uint32_t i = backups.size(); i > 0; i -= 1) {
+    SQLiteBackup *backup =
+        Object::cast_to<SQLiteBackup>(backups[i - 1]->get_ref());
+    if (backup != nullptr) {
+      backup->finish();
+    }
+    memdelete(backups[i - 1]);
+  }
+  backups.clear();
+
+  if (data_version_stmt != nullptr) {
+    sqlite3_finalize(data_version_stmt);
+    sqlite3_finalize(schema_version_stmt);
+    data_version_stmt = nullptr;
+    schema_version_stmt = nullptr;
+  }
+  result_cache.reset();
+  result_cache_tracking = false;
+  statement_hooks = false;
+  data_version = -1;
+  schema_version = -1;
+
+  if (db) {
+    // Cannot close database!
+    if (sqlite3_close_v2(db) != SQLITE_OK) {
+      print_error("Cannot close database: " + get_last_error_message());
+    } else {
+      db = nullptr;
+    }
+  }
+
+  if (memory_read) {
+    // Close virtual filesystem database
+    spmemvfs_close_db(&p_db);
+    spmemvfs_env_fini();
+    memory_read = false;
+  }
+
+  if (!encrypted_name.is_empty()) {
+    sqlite_crypt_remove_key(encrypted_name);
+    encrypted_name = String();
+  }
+}
+
+sqlite3_stmt *SQLite::prepare(const char *query) {
+  ERR_FAIL_COND_V_MSG(is_open_pending(), nullptr,
+                      "The database is being opened on a thread.");
+
+  // Get database pointer
+  sqlite3 *dbs = get_handler();
+
+  ERR_FAIL_COND_V_MSG(dbs == nullptr, nullptr,
+                      "Cannot prepare query! Database is not opened.");
+
+  // Prepare the statement
+  sqlite3_stmt *stmt = nullptr;
+  int result = sqlite3_prepare_v2(dbs, query, -1, &stmt, nullptr);
+
+  // Cannot prepare query!
+  ERR_FAIL_COND_V_MSG(result != SQLITE_OK, nullptr,
+                      "SQL Error: " + get_last_error_message());
+  return stmt;
+}
+
+bool SQLite::bind_args(sqlite3_stmt *stmt, Array args) {
+  // Check parameter count
+  int param_count = sqlite3_bind_parameter_count(stmt);
+  if (param_count != args.size()) {
+    print_error("SQLiteQuery failed; expected " + itos(param_count) +
+                " arguments, got " + itos(args.size()));
+    return false;
+  }
+
+  for (int i = 0; i < param_count; i++) {
+    if (!bind_value(stmt, i + 1, args[i])) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+template <class T>
+static int bind_packed_blob(sqlite3_stmt *p_stmt, int p_index,
+                            const Variant &p_value) {
+  const T array = p_value;
+  return sqlite3_bind_blob64(p_stmt, p_index, array.ptr(),
+                             array.size() * sizeof(array[0]),
+                             SQLITE_TRANSIENT);
+}
+
+bool SQLite::bind_value(sqlite3_stmt *stmt, int index, const Variant &value) {
+  /**
+   * SQLite data types:
+   * - NULL
+   * - INTEGER (signed, max 8 bytes)
+   * - REAL (stored as a double-precision float)
+   * - TEXT (stored in database encoding of UTF-8, UTF-16BE or UTF-16LE)
+   * - BLOB (1:1 storage)
+   */
+
+  int retcode;
+  switch (value.get_type()) {
+  case Variant::Type::NIL:
+    retcode = sqlite3_bind_null(stmt, index);
+    break;
+  case Variant::Type::BOOL:
+  case Variant::Type::INT:
+    retcode = sqlite3_bind_int64(stmt, index, (int64_t)value);
+    break;
+  case Variant::Type::FLOAT:
+    retcode = sqlite3_bind_double(stmt, index, (double)value);
+    break;
+  case Variant::Type::STRING:
+    retcode = sqlite3_bind_text(stmt, index, String(value).utf8().get_data(),
+                                -1, SQLITE_TRANSIENT);
+    break;
+  case Variant::Type::PACKED_BYTE_ARRAY:
+    retcode = sqlite3_bind_blob(stmt, index, PackedByteArray(value).ptr(),
+                                PackedByteArray(value).size(),
+                                SQLITE_TRANSIENT);
+    break;
+  // The raw values, as `to_byte_array()` gives them: the format read by the
+  // `vec_*` functions for float32 vectors.
+  case Variant::Type::PACKED_INT32_ARRAY:
+    retcode = bind_packed_blob<PackedInt32Array>(stmt, index, value);
+    break;
+  case Variant::Type::PACKED_INT64_ARRAY:
+    retcode = bind_packed_blob<PackedInt64Array>(stmt, index, value);
+    break;
+  case Variant::Type::PACKED_FLOAT32_ARRAY:
+    retcode = bind_packed_blob<PackedFloat32Array>(stmt, index, value);
+    break;
+  case Variant::Type::PACKED_FLOAT64_ARRAY:
+    retcode = bind_packed_blob<PackedFloat64Array>(stmt, index, value);
+    break;
+  case Variant::Type::OBJECT: {
+    // Consumed by the `carray()` table-valued function.
+    const SQLiteCArray *array = Object::cast_to<SQLiteCArray>(value);
+    if (array == nullptr) {
+      print_error("SQLite was passed an object which isn't a SQLiteCArray. "
+                  "Please serialize your object into a String or a "
+                  "PackedByteArray.\n");
+      return false;
+    }
+    retcode = sqlite_bind_carray(stmt, index, array);
+  } break;
+  default:
+    print_error(
+        "SQLite was passed unhandled Variant with TYPE_* enum " +
+        itos(value.get_type()) +
+        ". Please serialize your object into a String or a PoolByteArray.\n");
+    return false;
+  }
+
+  if (retcode != SQLITE_OK) {
+    print_error("SQLiteQuery failed, an error occured while binding argument" +
+                itos(index) + " (SQLite errcode " + itos(retcode) + ")");
+    return false;
+  }
+  return true;
+}
+
+Ref<SQLiteCArray> SQLite::carray(const Variant &p_values) {
+  Ref<SQLiteCArray> array;
+  array.instantiate();
+  array->set_values(p_values);
+  return array;
+}
+
+bool SQLite::query_with_args(String query, Array args) {
+  sqlite3_stmt *stmt = prepare(query.utf8().get_data());
+
+  // Failed to prepare the query
+  ERR_FAIL_COND_V_MSG(stmt == nullptr, false,
+                      "SQLiteQuery preparation error: " +
+                          get_last_error_message());
+
+  // Error occurred during argument binding
+  if (!bind_args(stmt, args)) {
+    sqlite3_finalize(stmt);
+    ERR_FAIL_V_MSG(false,
+                   "Error during arguments bind: " + get_last_error_message());
+  }
+
+  // Evaluate the sql query
+  const int result = sqlite3_step(stmt);
+  sqlite3_finalize(stmt);
+  if (result != SQLITE_ROW && result != SQLITE_DONE) {
+    discard_statement_changes();
+  }
+
+  return true;
+}
+
+String SQLite::quote_identifier(const String &p_name) {
+  return "\"" + p_name.replace("\"", "\"\"") + "\"";
+}
+
+Dictionary SQLite::get_export_metadata(String p_path) {
+  const String path = p_path.strip_edges() + ".sqlitemeta";
+  if (!FileAccess::exists(path)) {
+    return Dictionary();
+  }
+  Ref<JSON> json;
+  json.instantiate();
+  const Error err = json->parse(FileAccess::get_file_as_string(path));
+  const Variant metadata = json->get_data();
+  ERR_FAIL_COND_V_MSG(err != OK || metadata.get_type() != Variant::DICTIONARY,
+                      Dictionary(), "Invalid database metadata: " + path);
+  return metadata;
+}
+
+bool SQLite::compress_database(String p_source, String p_destination,
+                               int p_mode, int p_group_size) {
+  ERR_FAIL_COND_V_MSG(p_mode < Compression::MODE_FASTLZ ||
+                          p_mode > Compression::MODE_GZIP,
+                      false, "Invalid compression mode.");
+  const Vector<uint8_t> database = FileAccess::get_file_as_array(p_source);
+  ERR_FAIL_COND_V_MSG(database.is_empty(), false,
+                      "Cannot read the database: " + p_source);
+  const Vector<uint8_t> compressed = sqlite_zvfs_compress(
+      database, Compression::Mode(p_mode), p_group_size);
+  if (compressed.is_empty()) {
+    return false;
+  }
+
+  Ref<FileAccess> file = FileAccess::open(p_destination, FileAccess::WRITE);
+  ERR_FAIL_COND_V_MSG(file.is_null(), false,
+                      "Cannot write the compressed database: " +
+                          p_destination);
+  file->store_buffer(compressed.ptr(), compressed.size());
+  return true;
+}
+
+int64_t SQLite::export_csv(String p_query, Array p_args, String p_path,
+                           Dictionary p_options) {
+  SQLiteCSVOptions options;
+  if (!sqlite_csv_parse_options(p_options, options)) {
+    return -1;
+  }
+
+  sqlite3_stmt *stmt = prepare(p_query.utf8().get_data());
+  if (!stmt) {
+    return -1;
+  }
+  if (!bind_args(stmt, p_args)) {
+    sqlite3_finalize(stmt);
+    return -1;
+  }
+
+  Ref<FileAccess> file = FileAccess::open(p_path, FileAccess::WRITE);
+  if (file.is_null()) {
+    sqlite3_finalize(stmt);
+    ERR_FAIL_V_MSG(-1, "Cannot write the CSV file: " + p_path);
+  }
+
+  const int64_t rows = sqlite_csv_export(stmt, file, options);
+  if (rows < 0) {
+    ERR_PRINT("There was an error during the CSV export: " +
+              get_last_error_message());
+  }
+  sqlite3_finalize(stmt);
+  return rows;
+}
+
+// Column affinity from the values of the first chunk.
+static String infer_column_type(const SQLiteCSVParser::Chunk &p_chunk,
+                                int p_column, int p_column_count) {
+  int type = SQLITE_NULL;
+  for (uint32_t i = p_column; i < p_chunk.cells.size(); i += p_column_count) {
+    const int cell_type = p_chunk.cells[i].type;
+    if (cell_type == SQLITE_TEXT) {
+      return "TEXT";
+    }
+    if (cell_type == SQLITE_FLOAT ||
+        (cell_type == SQLITE_INTEGER && type == SQLITE_NULL)) {
+      type = cell_type;
+    }
+  }
+  if (type == SQLITE_INTEGER) {
+    return "INTEGER";
+  }
+  return type == SQLITE_FLOAT ? "REAL" : "TEXT";
+}
+
+int64_t SQLite::import_csv(String p_path, String p_table,
+                           Dictionary p_options) {
+  sqlite3 *dbs = get_handler();
+  ERR_FAIL_COND_V_MSG(dbs == nullptr, -1,
+                      "Cannot import the CSV file! Database is not opened.");
+  SQLiteCSVOptions options;
+  if (!sqlite_csv_parse_options(p_options, options)) {
+    return -1;
+  }
+  const Vector<uint8_t> content = FileAccess::get_file_as_array(p_path);
+  ERR_FAIL_COND_V_MSG(content.is_empty(), -1,
+                      "Cannot read the CSV file: " + p_path);
+
+  SQLiteCSVParser parser;
+  PackedStringArray columns;
+  if (!parser.start(content.ptr(), content.size(), options, columns)) {
+    return -1;
+  }
+  const int column_count = parser.get_column_count();
+
+  ERR_FAIL_COND_V_MSG(sqlite3_exec(dbs, "SAVEPOINT import_csv;", nullptr,
+                                   nullptr, nullptr) != SQLITE_OK,
+                      -1, "SQL Error: " + get_last_error_message());
+
+  bool success = true;
+  String error;
+  if (options.create_table) {
+    SQLiteCSVParser::Chunk &first = parser.wait_chunk(0);
+    String create = "CREATE TABLE IF NOT EXISTS " + quote_identifier(p_table) +
+                    " (";
+    for (int i = 0; i < column_count; i++) {
+      create += (i > 0 ? ", " : "") + quote_identifier(columns[i]) + " " +
+                infer_column_type(first, i, column_count);
+    }
+    success = sqlite3_exec(dbs, (create + ");").utf8().get_data(), nullptr,
+                           nullptr, nullptr) == SQLITE_OK;
+    error = success ? String() : get_last_error_message();
+    // Waited again by the insert loop.
+    first.ready.post();
+  }
+
+  String insert = "INSERT INTO " + quote_identifier(p_table) + " (";
+  String values;
+  for (int i = 0; i < column_count; i++) {
+    insert += (i > 0 ? ", " : "") + quote_identifier(columns[i]);
+    values += i > 0 ? ", ?" : "?";
+  }
+  const CharString statement = (insert + ") VALUES (" + values + ");").utf8();
+  sqlite3_stmt *stmt = success ? prepare(statement.get_data()) : nullptr;
+  if (success && stmt == nullptr) {
+    error = get_last_error_message();
+    success = false;
+  }
+
+  int64_t rows = 0;
+  for (int c = 0; success && c < parser.get_chunk_count(); c++) {
+    const SQLiteCSVParser::Chunk &chunk = parser.wait_chunk(c);
+    if (!chunk.error.is_empty()) {
+      error = chunk.error;
+      success = false;
+      break;
+    }
+    for (uint32_t i = 0; i < chunk.cells.size(); i += column_count) {
+      for (int column = 0; column < column_count; column++) {
+        const SQLiteCSVCell &cell = chunk.cells[i + column];
+        switch (cell.type) {
+        case SQLITE_INTEGER:
+          sqlite3_bind_int64(stmt, column + 1, cell.integer);
+          break;
+        case SQLITE_FLOAT:
+          sqlite3_bind_double(stmt, column + 1, cell.real);
+          break;
+        case SQLITE_TEXT:
+          // The text stays valid until the chunk is released.
+          sqlite3_bind_text(stmt, column + 1, parser.get_text(chunk.text, cell),
+                            cell.length, SQLITE_STATIC);
+          break;
+        default:
+          sqlite3_bind_null(stmt, column + 1);
+          break;
+        }
+      }
+      if (sqlite3_step(stmt) != SQLITE_DONE) {
+        error = get_last_error_message();
+        success = false;
+        break;
+      }
+      sqlite3_reset(stmt);
+      rows += 1;
+    }
+    if (!success) {
+      break;
+    }
+    parser.release_chunk(c);
+    emit_signal(SNAME("csv_import_progress"), p_table,
+                float(chunk.end) / float(content.size()));
+  }
+  parser.finish();
+  sqlite3_finalize(stmt);
+
+  if (!success) {
+    sqlite3_exec(dbs, "ROLLBACK TO import_csv; RELEASE import_csv;", nullptr,
+                 nullptr, nullptr);
+    ERR_FAIL_V_MSG(-1, "Cannot import the CSV file " + p_path + ": " + error);
+  }
+  ERR_FAIL_COND_V_MSG(sqlite3_exec(dbs, "RELEASE import_csv;", nullptr,
+                                   nullptr, nullptr) != SQLITE_OK,
+                      -1, "SQL Error: " + get_last_error_message());
+  return rows;
+}
+
+// Beyond this many shapes the statements are assumed to be built from
+// dynamic keys, and dropped rather than kept forever.
+static const int UPSERT_STATEMENTS_MAX = 64;
+
+sqlite3_stmt *
+SQLite::upsert_statement(const String &p_table, const Dictionary &p_row,
+                         const PackedStringArray &p_conflict_columns,
+                         LocalVector<Variant> &r_keys) {
+  ERR_FAIL_COND_V_MSG(p_row.is_empty(), nullptr, "Cannot upsert an empty row.");
+
+  r_keys.clear();
+  String columns;
+  String values;
+  String update;
+  const Array keys = p_row.keys();
+  for (int i = 0; i < keys.size(); i++) {
+    const Variant &key = keys[i];
+    ERR_FAIL_COND_V_MSG(key.get_type() != Variant::STRING &&
+                            key.get_type() != Variant::STRING_NAME,
+                        nullptr, "The keys of the rows must be column names.");
+    r_keys.push_back(key);
+    const String column = quote_identifier(key);
+    columns += (i > 0 ? ", " : "") + column;
+    values += i > 0 ? ", ?" : "?";
+    if (!p_conflict_columns.has(key)) {
+      update += (update.is_empty() ? "" : ", ") + column + " = excluded." +
+                column;
+    }
+  }
+
+  String conflict;
+  for (int i = 0; i < p_conflict_columns.size(); i++) {
+    conflict += (i > 0 ? ", " : "") + quote_identifier(p_conflict_columns[i]);
+  }
+
+  const String sql = "INSERT INTO " + quote_identifier(p_table) + " (" +
+                     columns + ") VALUES (" + values + ") ON CONFLICT (" +
+                     conflict + ") DO " +
+                     (update.is_empty() ? "NOTHING" : "UPDATE SET " + update) +
+                     ";";
+  HashMap<String, sqlite3_stmt *>::Iterator E = upsert_statements.find(sql);
+  if (E) {
+    return E->value;
+  }
+
+  if (upsert_statements.size() >= UPSERT_STATEMENTS_MAX) {
+    clear_upsert_statements();
+  }
+  sqlite3_stmt *stmt = nullptr;
+  const int result =
+      sqlite3_prepare_v3(get_handler(), sql.utf8().get_data(), -1,
+                         SQLITE_PREPARE_PERSISTENT, &stmt, nullptr);
+  ERR_FAIL_COND_V_MSG(result != SQLITE_OK, nullptr,
+                      "SQL Error: " + get_last_error_message());
+  upsert_statements.insert(sql, stmt);
+  return stmt;
+}
+
+void SQLite::clear_upsert_statements() {
+  for (const KeyValue<String, sqlite3_stmt *> &E : upsert_statements) {
+    sqlite3_finalize(E.value);
+  }
+  upsert_statements.clear();
+}
+
+// Binds the values of `p_row` in the order of `p_keys`. Fails when the row
+// doesn't have these keys.
+static bool bind_row(sqlite3_stmt *p_stmt, const LocalVector<Variant> &p_keys,
+                     const Dictionary &p_row) {
+  if (p_stmt == nullptr || p_row.size() != int(p_keys.size())) {
+    return false;
+  }
+  for (uint32_t i = 0; i < p_keys.size(); i++) {
+    const Variant *value = p_row.getptr(p_keys[i]);
+    if (value == nullptr || !SQLite::bind_value(p_stmt, i + 1, *value)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+int64_t SQLite::upsert(String p_table, Array p_rows,
+                       PackedStringArray p_conflict_columns) {
+  sqlite3 *dbs = get_handler();
+  ERR_FAIL_COND_V_MSG(dbs == nullptr, -1,
+                      "Cannot upsert! Database is not opened.");
+  ERR_FAIL_COND_V_MSG(p_conflict_columns.is_empty(), -1,
+                      "The conflict columns are required.");
+  if (p_rows.is_empty()) {
+    return 0;
+  }
+
+  ERR_FAIL_COND_V_MSG(sqlite3_exec(dbs, "SAVEPOINT upsert;", nullptr, nullptr,
+                                   nullptr) != SQLITE_OK,
+                      -1, "SQL Error: " + get_last_error_message());
+
+  // The statement of the previous row, reused as long as the rows have the
+  // same keys.
+  sqlite3_stmt *stmt = nullptr;
+  LocalVector<Variant> keys;
+  String error;
+  int64_t rows = 0;
+  for (int i = 0; i < p_rows.size(); i++) {
+    if (p_rows[i].get_type() != Variant::DICTIONARY) {
+      error = "The row " + itos(i) + " is not a Dictionary.";
+      break;
+    }
+    const Dictionary row = p_rows[i];
+    if (!bind_row(stmt, keys, row)) {
+      stmt = upsert_statement(p_table, row, p_conflict_columns, keys);
+      if (stmt == nullptr || !bind_row(stmt, keys, row)) {
+        error = "Cannot write the row " + itos(i) + ".";
+        break;
+      }
+    }
+    if (sqlite3_step(stmt) != SQLITE_DONE) {
+      error = get_last_error_message();
+      sqlite3_reset(stmt);
+      break;
+    }
+    sqlite3_reset(stmt);
+    // 0 when `DO NOTHING` skipped the row.
+    rows += sqlite3_changes(dbs);
+  }
+
+  if (!error.is_empty()) {
+    sqlite3_exec(dbs, "ROLLBACK TO upsert; RELEASE upsert;", nullptr, nullptr,
+                 nullptr);
+    ERR_FAIL_V_MSG(-1, "Cannot upsert into " + p_table + ": " + error);
+  }
+  ERR_FAIL_COND_V_MSG(sqlite3_exec(dbs, "RELEASE upsert;", nullptr, nullptr,
+                                   nullptr) != SQLITE_OK,
+                      -1, "SQL Error: " + get_last_error_message());
+  return rows;
+}
+
+Ref<SQLiteQuery> SQLite::create_query(String p_query) {
+  Ref<SQLiteQuery> query;
+  query.instantiate();
+  query->init(this, p_query);
+
+  WeakRef *wr = memnew(WeakRef);
+  wr->set_obj(query.ptr());
+  queries.push_back(wr);
+
+  return query;
+}
+
+bool SQLite::prepare_all() {
+  ERR_FAIL_COND_V_MSG(get_handler() == nullptr, false,
+                      "Cannot prepare the queries! Database is not opened.");
+  bool success = true;
+  for (uint32_t i = queries.size(); i > 0; i -= 1) {
+    SQLiteQuery *query =
+        Object::cast_to<SQLiteQuery>(queries[i - 1]->get_ref());
+    if (query == nullptr) {
+      memdelete(queries[i - 1]);
+      queries.remove_at(i - 1);
+    } else if (!query->is_ready() && query->query != "") {
+      success = query->prepare() && success;
+    }
+  }
+  return success;
+}
+
+bool SQLite::execute_script(String p_sql, bool p_transaction) {
+  // Not kept: its statements are finalized once it has run.
+  Ref<SQLiteCompiledScript> script;
+  script.instantiate();
+  script->init(this, p_sql);
+  return script->run(p_transaction);
+}
+
+Ref<SQLiteCompiledScript> SQLite::compile_script(String p_sql) {
+  Ref<SQLiteCompiledScript> script;
+  script.instantiate();
+  script->init(this, p_sql);
+
+  WeakRef *wr = memnew(WeakRef);
+  wr->set_obj(script.ptr());
+  scripts.push_back(wr);
+
+  return script;
+}
+
+Ref<SQLiteBackup> SQLite::create_backup(const Variant &p_other,
+                                        int p_pages_per_step,
+                                        bool p_to_other) {
+  sqlite3 *dbs = get_handler();
+  ERR_FAIL_COND_V_MSG(dbs == nullptr, Ref<SQLiteBackup>(),
+                      "Cannot start the backup! Database is not opened.");
+  ERR_FAIL_COND_V_MSG(p_pages_per_step == 0, Ref<SQLiteBackup>(),
+                      "Use -1 to copy all the pages at once.");
+
+  Ref<SQLite> other;
+  sqlite3 *other_handle = nullptr;
+  sqlite3 *owned_connection = nullptr;
+  if (p_other.get_type() == Variant::STRING) {
+    const String path = String(p_other).strip_edges();
+    ERR_FAIL_COND_V(path.is_empty(), Ref<SQLiteBackup>());
+    const String real_path =
+        ProjectSettings::get_singleton()->globalize_path(path);
+    const int flags = p_to_other ? SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE
+                                 : SQLITE_OPEN_READONLY;
+    const int result = sqlite3_open_v2(real_path.utf8().get_data(),
+                                       &owned_connection, flags, nullptr);
+    if (result != SQLITE_OK) {
+      // A handle is allocated even when the open fails.
+      sqlite3_close_v2(owned_connection);
+      ERR_FAIL_V_MSG(Ref<SQLiteBackup>(),
+                     "Cannot open the database: " + path);
+    }
+    other_handle = owned_connection;
+  } else {
+    other = p_other;
+    ERR_FAIL_COND_V_MSG(other.is_null(), Ref<SQLiteBackup>(),
+                        "Expected a path or an SQLite object.");
+    ERR_FAIL_COND_V_MSG(other.ptr() == this, Ref<SQLiteBackup>(),
+                        "Cannot backup a database into itself.");
+    other_handle = other->get_handler();
+    ERR_FAIL_COND_V_MSG(other_handle == nullptr, Ref<SQLiteBackup>(),
+                        "The other database is not opened.");
+  }
+
+  Ref<SQLite> self(this);
+  Ref<SQLiteBackup> backup;
+  backup.instantiate();
+  const bool ok =
+      p_to_other ? backup->init(self, other, dbs, other_handle,
+                                owned_connection, p_pages_per_step)
+                 : backup->init(other, self, other_handle, dbs,
+                                owned_connection, p_pages_per_step);
+  if (!ok) {
+    // The error is already logged, and the connection closed.
+    return Ref<SQLiteBackup>();
+  }
+
+  // Both databases finish the backup when closed.
+  WeakRef *wr = memnew(WeakRef);
+  wr->set_obj(backup.ptr());
+  backups.push_back(wr);
+  if (other.is_valid()) {
+    wr = memnew(WeakRef);
+    wr->set_obj(backup.ptr());
+    other->backups.push_back(wr);
+  }
+
+  return backup;
+}
+
+Ref<SQLiteBackup> SQLite::backup_to(Variant p_destination,
+                                    int p_pages_per_step) {
+  return create_backup(p_destination, p_pages_per_step, true);
+}
+
+Ref<SQLiteBackup> SQLite::backup_from(Variant p_source, int p_pages_per_step) {
+  return create_backup(p_source, p_pages_per_step, false);
+}
+
+void SQLite::update_hook(void *p_self, int p_operation,
+                         const char *p_database, const char *p_table,
+                         sqlite3_int64 p_rowid) {
+  SQLite *self = static_cast<SQLite *>(p_self);
+  self->result_cache.table_changed(p_database, p_table);
+  if (self->change_notifications == CHANGE_NOTIFICATIONS_DISABLED) {
+    return;
+  }
+  ChangeEvent event;
+  event.table = String::utf8(p_table);
+  event.operation = p_operation;
+  event.rowid = p_rowid;
+
+  MutexLock lock(self->changes_mutex);
+  self->pending_changes.push_back(event);
+}
+
+int SQLite::commit_hook(void *p_self) {
+  SQLite *self = static_cast<SQLite *>(p_self);
+  if (self->change_notifications == CHANGE_NOTIFICATIONS_DISABLED) {
+    return 0;
+  }
+
+  MutexLock lock(self->changes_mutex);
+  if (self->change_notifications == CHANGE_NOTIFICATIONS_COALESCED) {
+    for (const ChangeEvent &event : self->pending_changes) {
+      self->committed_tables[event.table].insert(event.rowid);
+    }
+  } else {
+    for (const ChangeEvent &event : self->pending_changes) {
+      self->committed_changes.push_back(event);
+    }
+    self->committed_changes.push_back(ChangeEvent());
+  }
+  self->pending_changes.clear();
+  self->savepoints.clear();
+  self->commit_count += 1;
+  self->queue_flush_changes();
+
+  // Zero lets the commit proceed.
+  return 0;
+}
+
+void SQLite::rollback_hook(void *p_self) {
+  SQLite *self = static_cast<SQLite *>(p_self);
+  // The results read during the transaction may hold reverted changes.
+  self->result_cache.invalidate_all();
+  if (self->change_notifications == CHANGE_NOTIFICATIONS_DISABLED) {
+    return;
+  }
+
+  MutexLock lock(self->changes_mutex);
+  self->pending_changes.clear();
+  self->savepoints.clear();
+  self->rollback_count += 1;
+  self->queue_flush_changes();
+}
+
+void SQLite::discard_statement_changes() {
+  // Outside of a transaction, the rollback hook drops them.
+  if (change_notifications == CHANGE_NOTIFICATIONS_DISABLED || db == nullptr ||
+      sqlite3_get_autocommit(db)) {
+    return;
+  }
+  MutexLock lock(changes_mutex);
+  if (statement_changes < pending_changes.size()) {
+    pending_changes.resize(statement_changes);
+  }
+}
+
+int SQLite::authorizer(void *p_self, int p_action, const char *p_arg1,
+                       const char *p_arg2, const char *p_database,
+                       const char *p_trigger) {
+  SQLite *self = static_cast<SQLite *>(p_self);
+  switch (p_action) {
+  case SQLITE_READ:
+    if (self->discovered_tables != nullptr && p_database != nullptr) {
+      const uint32_t table =
+          self->result_cache.track_table(p_database, p_arg1);
+      if (self->discovered_tables->find(table) == -1) {
+        self->discovered_tables->push_back(table);
+      }
+    }
+    break;
+  case SQLITE_FUNCTION:
+    if (self->discovered_tables != nullptr &&
+        self->is_volatile_function(p_arg2)) {
+      self->discovered_uncacheable = true;
+    }
+    break;
+  case SQLITE_DELETE:
+    // Disables the truncate optimization, which deletes all the rows of a
+    // table without reporting them to the update hook, for the result cache
+    // and the change notifications. The deletes of SQLite itself, from
+    // `sqlite_master` when dropping, would be skipped instead.
+    if (sqlite3_strnicmp(p_arg1, "sqlite_", 7) != 0) {
+      return SQLITE_IGNORE;
+    }
+    break;
+  default:
+    break;
+  }
+  return SQLITE_OK;
+}
+
+// Built-in functions whose result changes between two runs of a statement.
+// The date and time functions only do with 'now', but their arguments aren't
+// known to the authorizer.
+static const char *VOLATILE_FUNCTIONS[] = {
+    "random",        "randomblob",   "changes",      "last_insert_rowid",
+    "total_changes", "date",         "time",         "datetime",
+    "julianday",     "strftime",     "unixepoch",    "current_date",
+    "current_time",  "current_timestamp",
+};
+
+bool SQLite::is_volatile_function(const char *p_name) const {
+  for (const char *name : VOLATILE_FUNCTIONS) {
+    if (sqlite3_stricmp(p_name, name) == 0) {
+      return true;
+    }
+  }
+  // The functions of the module are deterministic, the Callables only when
+  // registered as such.
+  for (const UserFunction &function : functions) {
+    if (!function.deterministic &&
+        sqlite3_stricmp(p_name, function.name.utf8().get_data()) == 0) {
+      return true;
+    }
+  }
+  return false;
+}
+
+// Skips the whitespace and the comments.
+static const char *skip_blanks(const char *p_sql) {
+  while (true) {
+    if (*p_sql == ' ' || *p_sql == '\t' || *p_sql == '\n' ||
+        *p_sql == '\r' || *p_sql == '\f') {
+      p_sql++;
+    } else if (p_sql[0] == '-' && p_sql[1] == '-') {
+      while (*p_sql != '\0' && *p_sql != '\n') {
+        p_sql++;
+      }
+    } else if (p_sql[0] == '/' && p_sql[1] == '*') {
+      p_sql += 2;
+      while (*p_sql != '\0' && !(p_sql[0] == '*' && p_sql[1] == '/')) {
+        p_sql++;
+      }
+      p_sql += *p_sql != '\0' ? 2 : 0;
+    } else {
+      return p_sql;
+    }
+  }
+}
+
+static bool is_identifier_char(char p_char) {
+  return (p_char >= 'a' && p_char <= 'z') || (p_char >= 'A' && p_char <= 'Z') ||
+         (p_char >= '0' && p_char <= '9') || p_char == '_' || p_char == '$' ||
+         (p_char & 0x80) != 0;
+}
+
+// Consumes `p_keyword`, case insensitive, when it's the next word.
+static bool read_keyword(const char *&r_sql, const char *p_keyword) {
+  const char *sql = skip_blanks(r_sql);
+  const int length = strlen(p_keyword);
+  if (sqlite3_strnicmp(sql, p_keyword, length) != 0 ||
+      is_identifier_char(sql[length])) {
+    return false;
+  }
+  r_sql = sql + length;
+  return true;
+}
+
+// Reads an identifier, unquoted.
+static String read_identifier(const char *&r_sql) {
+  const char *sql = skip_blanks(r_sql);
+  CharString name;
+  const char quote = *sql == '[' ? ']' : *sql;
+  if (quote == '"' || quote == '`' || quote == '\'' || quote == ']') {
+    sql++;
+    while (*sql != '\0') {
+      if (*sql == quote) {
+        // Quotes are escaped by doubling them, except in brackets.
+        if (quote == ']' || sql[1] != quote) {
+          sql++;
+          break;
+        }
+        sql++;
+      }
+      name += *sql;
+      sql++;
+    }
+  } else {
+    while (is_identifier_char(*sql)) {
+      name += *sql;
+      sql++;
+    }
+  }
+  r_sql = sql;
+  return String::utf8(name.get_data());
+}
+
+SQLite::TransactionStatement
+SQLite::parse_transaction_statement(const char *p_sql, String &r_savepoint) {
+  const char *sql = p_sql;
+  if (read_keyword(sql, "SAVEPOINT")) {
+    r_savepoint = read_identifier(sql);
+    return TRANSACTION_SAVEPOINT;
+  }
+  if (read_keyword(sql, "RELEASE")) {
+    read_keyword(sql, "SAVEPOINT");
+    r_savepoint = read_identifier(sql);
+    return TRANSACTION_RELEASE;
+  }
+  if (read_keyword(sql, "ROLLBACK")) {
+    read_keyword(sql, "TRANSACTION");
+    if (read_keyword(sql, "TO")) {
+      read_keyword(sql, "SAVEPOINT");
+      r_savepoint = read_identifier(sql);
+      return TRANSACTION_ROLLBACK_TO;
+    }
+  }
+  return TRANSACTION_OTHER;
+}
+
+int SQLite::trace_hook(unsigned p_type, void *p_self, void *p_stmt,
+                       void *p_sql) {
+  if (p_type != SQLITE_TRACE_STMT) {
+    return 0;
+  }
+  SQLite *self = static_cast<SQLite *>(p_self);
+  // Called when a statement starts running. The statements of the triggers
+  // are reported as comments, they run within the statement which fired
+  // them.
+  const char *sql = static_cast<const char *>(p_sql);
+  if (strncmp(sql, "-- TRIGGER ", 11) == 0) {
+    return 0;
+  }
+  String savepoint;
+  const TransactionStatement statement =
+      parse_transaction_statement(sql, savepoint);
+  if (statement == TRANSACTION_OTHER) {
+    if (self->change_notifications != CHANGE_NOTIFICATIONS_DISABLED) {
+      MutexLock lock(self->changes_mutex);
+      self->statement_changes = self->pending_changes.size();
+    }
+    return 0;
   }
+  if (statement == TRANSACTION_ROLLBACK_TO) {
+    // Reverts changes without calling the rollback hook.
+    self->result_cache.invalidate_all();
+  }
+  if (self->change_notifications == CHANGE_NOTIFICATIONS_DISABLED) {
+    return 0;
+  }
+
+  MutexLock lock(self->changes_mutex);
+  if (statement == TRANSACTION_SAVEPOINT) {
+    self->savepoints.push_back(
+        Pair<String, uint32_t>(savepoint, self->pending_changes.size()));
+    return 0;
+  }
+  // The innermost savepoint of that name, names are case insensitive.
+  int64_t index = int64_t(self->savepoints.size()) - 1;
+  while (index >= 0 &&
+         self->savepoints[index].first.nocasecmp_to(savepoint) != 0) {
+    index -= 1;
+  }
+  if (index < 0) {
+    // Fails: no such savepoint.
+    return 0;
+  }
+  if (statement == TRANSACTION_RELEASE) {
+    // The changes are kept, and committed by the enclosing transaction.
+    self->savepoints.resize(index);
+  } else {
+    // The savepoint itself stays open.
+    self->pending_changes.resize(self->savepoints[index].second);
+    self->savepoints.resize(index + 1);
+  }
+  return 0;
 }
 
-void SQLiteQuery::_bind_methods() {
-  ClassDB::bind_method(D_METHOD("get_last_error_message"),
-                       &SQLiteQuery::get_last_error_message);
-  ClassDB::bind_method(D_METHOD("execute", "arguments"), &SQLiteQuery::execute,
-                       DEFVAL(Array()));
-  ClassDB::bind_method(D_METHOD("batch_execute", "rows"),
-                       &SQLiteQuery::batch_execute);
-  ClassDB::bind_method(D_METHOD("get_columns"), &SQLiteQuery::get_columns);
+void SQLite::install_statement_hooks() {
+  if (statement_hooks) {
+    return;
+  }
+  sqlite3 *dbs = get_handler();
+  ERR_FAIL_COND(dbs == nullptr);
+  // Also expires the prepared statements, which are prepared again through
+  // the authorizer.
+  sqlite3_set_authorizer(dbs, authorizer, this);
+  // The savepoint statements are only seen when they run, prepared
+  // statements can be run many times.
+  sqlite3_trace_v2(dbs, SQLITE_TRACE_STMT, trace_hook, this);
+  statement_hooks = true;
 }
 
-SQLite::SQLite() {
-  db = nullptr;
-  memory_read = false;
+void SQLite::start_result_cache_tracking() {
+  if (result_cache_tracking) {
+    return;
+  }
+  install_statement_hooks();
+  result_cache_tracking = true;
 }
-/*
-        Open a database file.
-        If this is running outside of the editor, databases under res:// are
-   assumed to be packed.
-        @param path The database resource path.
-        @return status
-*/
-bool SQLite::open(String path) {
-  if (!path.strip_edges().length())
-    return false;
 
-  if (!Engine::get_singleton()->is_editor_hint() &&
-      path.begins_with("res://")) {
-    Ref<core_bind::File> dbfile;
-    dbfile.instantiate();
-    if (dbfile->open(path, core_bind::File::READ) != Error::OK) {
-      print_error("Cannot open packed database!");
+bool SQLite::check_cached_tables(const LocalVector<uint32_t> &p_tables) {
+  for (uint32_t table : p_tables) {
+    SQLiteResultCache::TableKind kind = result_cache.get_table_kind(table);
+    if (kind == SQLiteResultCache::TABLE_UNCHECKED) {
+      // The update hook ignores virtual and WITHOUT ROWID tables. Table
+      // valued functions aren't listed, and only depend on their arguments.
+      kind = SQLiteResultCache::TABLE_TRACKED;
+      sqlite3_stmt *stmt = prepare("SELECT type = 'virtual' OR wr FROM "
+                                   "pragma_table_list WHERE schema = ? AND "
+                                   "name = ?;");
+      ERR_FAIL_COND_V(stmt == nullptr, false);
+      sqlite3_bind_text(stmt, 1, result_cache.get_table_schema(table), -1,
+                        SQLITE_STATIC);
+      sqlite3_bind_text(stmt, 2, result_cache.get_table_name(table), -1,
+                        SQLITE_STATIC);
+      if (sqlite3_step(stmt) == SQLITE_ROW && sqlite3_column_int(stmt, 0)) {
+        kind = SQLiteResultCache::TABLE_UNTRACKED;
+      }
+      sqlite3_finalize(stmt);
+      result_cache.set_table_kind(table, kind);
+    }
+    if (kind == SQLiteResultCache::TABLE_UNTRACKED) {
       return false;
     }
-    int64_t size = dbfile->get_length();
-    PackedByteArray buffer = dbfile->get_buffer(size);
-    return open_buffered(path, buffer, size);
   }
+  return true;
+}
 
-  String real_path =
-      ProjectSettings::get_singleton()->globalize_path(path.strip_edges());
-
-  int result = sqlite3_open(real_path.utf8().get_data(), &db);
+// Returns the value of a pragma statement, -1 on failure.
+static int64_t step_pragma(sqlite3_stmt *p_stmt) {
+  int64_t value = -1;
+  if (sqlite3_step(p_stmt) == SQLITE_ROW) {
+    value = sqlite3_column_int64(p_stmt, 0);
+  }
+  sqlite3_reset(p_stmt);
+  return value;
+}
 
-  if (result != SQLITE_OK) {
-    print_error("Cannot open database!");
-    return false;
+void SQLite::refresh_result_cache() {
+  if (data_version_stmt == nullptr) {
+    data_version_stmt = prepare("PRAGMA data_version;");
+    schema_version_stmt = prepare("PRAGMA schema_version;");
+    ERR_FAIL_COND(data_version_stmt == nullptr ||
+                  schema_version_stmt == nullptr);
   }
+  // `data_version` changes with the commits of the other connections, which
+  // the update hook doesn't see.
+  const int64_t data = step_pragma(data_version_stmt);
+  const int64_t schema = step_pragma(schema_version_stmt);
+  if (data != data_version || schema != schema_version || data == -1) {
+    result_cache.invalidate_all();
+    data_version = data;
+    schema_version = schema;
+  }
+}
 
-  return true;
+void SQLite::set_result_cache_budget(int64_t p_bytes) {
+  result_cache.set_budget(p_bytes);
 }
 
-bool SQLite::open_in_memory() {
-  int result = sqlite3_open(":memory:", &db);
-  ERR_FAIL_COND_V_MSG(result != SQLITE_OK, false,
-                      "Cannot open database in memory, error:" + itos(result));
-  return true;
+int64_t SQLite::get_result_cache_budget() const {
+  return result_cache.get_budget();
 }
 
-/*
-  Open the database and initialize memory buffer.
-  @param name Name of the database.
-  @param buffers The database buffer.
-  @param size Size of the database;
-  @return status
-*/
-bool SQLite::open_buffered(String name, PackedByteArray buffers, int64_t size) {
-  if (!name.strip_edges().length()) {
-    return false;
-  }
+Dictionary SQLite::get_result_cache_stats() const {
+  return result_cache.get_stats();
+}
 
-  if (!buffers.size() || !size) {
-    return false;
-  }
+void SQLite::clear_result_cache() { result_cache.clear(); }
 
-  spmembuffer_t *p_mem = (spmembuffer_t *)calloc(1, sizeof(spmembuffer_t));
-  p_mem->total = p_mem->used = size;
-  p_mem->data = (char *)malloc(size + 1);
-  memcpy(p_mem->data, buffers.ptr(), size);
-  p_mem->data[size] = '\0';
+// Returns the value of `p_pragma`, -1 on failure.
+int64_t SQLite::read_pragma(const char *p_pragma) {
+  sqlite3_stmt *stmt = prepare(p_pragma);
+  ERR_FAIL_COND_V(stmt == nullptr, -1);
+  const int64_t value = step_pragma(stmt);
+  sqlite3_finalize(stmt);
+  return value;
+}
 
-  //
-  spmemvfs_env_init();
-  int err = spmemvfs_open_db(&p_db, name.utf8().get_data(), p_mem);
+Dictionary SQLite::migrate(Array p_migrations, bool p_disable_foreign_keys) {
+  sqlite3 *dbs = get_handler();
+  ERR_FAIL_COND_V_MSG(dbs == nullptr, Dictionary(),
+                      "Cannot migrate! Database is not opened.");
+  ERR_FAIL_COND_V_MSG(!sqlite3_get_autocommit(dbs), Dictionary(),
+                      "Cannot migrate within a transaction.");
+
+  const uint64_t begin_usec = OS::get_singleton()->get_ticks_usec();
+  const int64_t from_version = read_pragma("PRAGMA user_version;");
+  ERR_FAIL_COND_V(from_version < 0, Dictionary());
+  ERR_FAIL_COND_V_MSG(from_version > p_migrations.size(), Dictionary(),
+                      "The database version (" + itos(from_version) +
+                          ") is newer than the migrations (" +
+                          itos(p_migrations.size()) + ").");
+
+  Dictionary report;
+  Array steps;
+  report["from_version"] = from_version;
+  report["version"] = from_version;
+  report["steps"] = steps;
+  if (from_version == p_migrations.size()) {
+    report["usec"] = OS::get_singleton()->get_ticks_usec() - begin_usec;
+    return report;
+  }
 
-  if (err != SQLITE_OK || p_db.mem != p_mem) {
-    print_error("Cannot open buffered database!");
-    return false;
+  // `foreign_keys` can't be changed within a transaction. Disabled on
+  // request, the tables can be rebuilt in any order, but the foreign key
+  // actions don't run either.
+  const bool foreign_keys = read_pragma("PRAGMA foreign_keys;") == 1;
+  const bool disable_foreign_keys = foreign_keys && p_disable_foreign_keys;
+  if (disable_foreign_keys) {
+    sqlite3_exec(dbs, "PRAGMA foreign_keys = OFF;", nullptr, nullptr, nullptr);
   }
 
-  memory_read = true;
-  return true;
-}
+  String error;
+  // Exclusive: no other connection can write meanwhile. The readers never see
+  // a half migrated database, but in WAL mode they keep reading the version
+  // before the migrations until they commit.
+  if (sqlite3_exec(dbs, "BEGIN EXCLUSIVE;", nullptr, nullptr, nullptr) !=
+      SQLITE_OK) {
+    error = get_last_error_message();
+  }
+  // Checks the keys at commit, still running the actions, like ON DELETE
+  // CASCADE. Reset by the end of the transaction.
+  if (error.is_empty() && foreign_keys && !disable_foreign_keys &&
+      sqlite3_exec(dbs, "PRAGMA defer_foreign_keys = ON;", nullptr, nullptr,
+                   nullptr) != SQLITE_OK) {
+    error = get_last_error_message();
+  }
 
-void SQLite::close() {
-  // Finalize all queries before close the DB.
-  // Reverse order because I need to remove the not available queries.
-  for (uint32_t i = queries.size(); i > 0; i -= 1) {
-    SQLiteQuery *query =
-        Object::cast_to<SQLiteQuery>(queries[i - 1]->get_ref());
-    if (query != nullptr) {
-      query->finalize();
+  for (int i = from_version; i < p_migrations.size() && error.is_empty();
+       i++) {
+    const uint64_t step_usec = OS::get_singleton()->get_ticks_usec();
+    const Variant &migration = p_migrations[i];
+
+    if (migration.get_type() == Variant::STRING) {
+      Ref<SQLiteCompiledScript> script;
+      script.instantiate();
+      script->init(this, migration);
+      if (!script->run(false)) {
+        error = script->get_last_error_message();
+      }
+    } else if (migration.get_type() == Variant::CALLABLE) {
+      const Callable function = migration;
+      const Variant db_arg = this;
+      const Variant *args[1] = {&db_arg};
+      Variant ret;
+      Callable::CallError ce;
+      function.call(args, 1, ret, ce);
+      if (ce.error != Callable::CallError::CALL_OK) {
+        error = Variant::get_callable_error_text(function, args, 1, ce);
+      } else if (ret.get_type() == Variant::BOOL && !bool(ret)) {
+        error = "The function returned false.";
+      }
     } else {
-      memdelete(queries[i - 1]);
-      queries.remove_at(i - 1);
+      error = "Expected a SQL script or a Callable.";
     }
+
+    if (!error.is_empty()) {
+      error = "Migration " + itos(i + 1) + " failed: " + error;
+      break;
+    }
+    Dictionary step;
+    step["version"] = i + 1;
+    step["usec"] = OS::get_singleton()->get_ticks_usec() - step_usec;
+    steps.push_back(step);
   }
 
-  if (db) {
-    // Cannot close database!
-    if (sqlite3_close_v2(db) != SQLITE_OK) {
-      print_error("Cannot close database: " + get_last_error_message());
+  if (error.is_empty()) {
+    const String version = "PRAGMA user_version = " +
+                           itos(p_migrations.size()) + ";";
+    if (sqlite3_exec(dbs, version.utf8().get_data(), nullptr, nullptr,
+                     nullptr) != SQLITE_OK) {
+      error = get_last_error_message();
+    }
+  }
+  if (error.is_empty() && foreign_keys) {
+    sqlite3_stmt *stmt = prepare("PRAGMA foreign_key_check;");
+    if (stmt == nullptr) {
+      error = get_last_error_message();
     } else {
-      db = nullptr;
+      if (sqlite3_step(stmt) == SQLITE_ROW) {
+        error = "A foreign key of the table \"" +
+                String::utf8(reinterpret_cast<const char *>(
+                    sqlite3_column_text(stmt, 0))) +
+                "\" is violated.";
+      }
+      sqlite3_finalize(stmt);
     }
   }
-
-  if (memory_read) {
-    // Close virtual filesystem database
-    spmemvfs_close_db(&p_db);
-    spmemvfs_env_fini();
-    memory_read = false;
+  if (error.is_empty() &&
+      sqlite3_exec(dbs, "COMMIT;", nullptr, nullptr, nullptr) != SQLITE_OK) {
+    error = get_last_error_message();
   }
-}
-
-sqlite3_stmt *SQLite::prepare(const char *query) {
-  // Get database pointer
-  sqlite3 *dbs = get_handler();
-
-  ERR_FAIL_COND_V_MSG(dbs == nullptr, nullptr,
-                      "Cannot prepare query! Database is not opened.");
 
-  // Prepare the statement
-  sqlite3_stmt *stmt = nullptr;
-  int result = sqlite3_prepare_v2(dbs, query, -1, &stmt, nullptr);
+  if (!error.is_empty() && !sqlite3_get_autocommit(dbs)) {
+    sqlite3_exec(dbs, "ROLLBACK;", nullptr, nullptr, nullptr);
+  }
+  if (disable_foreign_keys) {
+    sqlite3_exec(dbs, "PRAGMA foreign_keys = ON;", nullptr, nullptr, nullptr);
+  }
+  ERR_FAIL_COND_V_MSG(!error.is_empty(), Dictionary(), error);
 
-  // Cannot prepare query!
-  ERR_FAIL_COND_V_MSG(result != SQLITE_OK, nullptr,
-                      "SQL Error: " + get_last_error_message());
-  return stmt;
+  report["version"] = p_migrations.size();
+  report["usec"] = OS::get_singleton()->get_ticks_usec() - begin_usec;
+  return report;
 }
 
-bool SQLite::bind_args(sqlite3_stmt *stmt, Array args) {
-  // Check parameter count
-  int param_count = sqlite3_bind_parameter_count(stmt);
-  if (param_count != args.size()) {
-    print_error("SQLiteQuery failed; expected " + itos(param_count) +
-                " arguments, got " + itos(args.size()));
-    return false;
+void SQLite::queue_flush_changes() {
+  // Called with `changes_mutex` locked.
+  if (!flush_queued) {
+    flush_queued = true;
+    call_deferred(SNAME("_flush_changes"));
   }
+}
 
-  /**
-   * SQLite data types:
-   * - NULL
-   * - INTEGER (signed, max 8 bytes)
-   * - REAL (stored as a double-precision float)
-   * - TEXT (stored in database encoding of UTF-8, UTF-16BE or UTF-16LE)
-   * - BLOB (1:1 storage)
-   */
+void SQLite::_flush_changes() {
+  LocalVector<ChangeEvent> events;
+  HashMap<String, HashSet<int64_t>> tables;
+  uint32_t commits;
+  uint32_t rollbacks;
+  {
+    MutexLock lock(changes_mutex);
+    events = committed_changes;
+    tables = committed_tables;
+    commits = commit_count;
+    rollbacks = rollback_count;
+    committed_changes.clear();
+    committed_tables.clear();
+    commit_count = 0;
+    rollback_count = 0;
+    flush_queued = false;
+  }
 
-  for (int i = 0; i < param_count; i++) {
-    int retcode;
-    switch (args[i].get_type()) {
-    case Variant::Type::NIL:
-      retcode = sqlite3_bind_null(stmt, i + 1);
-      break;
-    case Variant::Type::BOOL:
-    case Variant::Type::INT:
-      retcode = sqlite3_bind_int(stmt, i + 1, (int)args[i]);
-      break;
-    case Variant::Type::FLOAT:
-      retcode = sqlite3_bind_double(stmt, i + 1, (double)args[i]);
-      break;
-    case Variant::Type::STRING:
-      retcode = sqlite3_bind_text(
-          stmt, i + 1, String(args[i]).utf8().get_data(), -1, SQLITE_TRANSIENT);
-      break;
-    case Variant::Type::PACKED_BYTE_ARRAY:
-      retcode =
-          sqlite3_bind_blob(stmt, i + 1, PackedByteArray(args[i]).ptr(),
-                            PackedByteArray(args[i]).size(), SQLITE_TRANSIENT);
-      break;
-    default:
-      print_error(
-          "SQLite was passed unhandled Variant with TYPE_* enum " +
-          itos(args[i].get_type()) +
-          ". Please serialize your object into a String or a PoolByteArray.\n");
-      return false;
+  // Per row notifications, each transaction followed by `committed`.
+  for (const ChangeEvent &event : events) {
+    if (event.operation == 0) {
+      emit_signal(SNAME("committed"));
+    } else {
+      emit_signal(SNAME("row_changed"), event.table, event.operation,
+                  event.rowid);
     }
+  }
 
-    if (retcode != SQLITE_OK) {
-      print_error(
-          "SQLiteQuery failed, an error occured while binding argument" +
-          itos(i + 1) + " of " + itos(args.size()) + " (SQLite errcode " +
-          itos(retcode) + ")");
-      return false;
+  // Coalesced notifications.
+  if (!tables.is_empty()) {
+    for (const KeyValue<String, HashSet<int64_t>> &E : tables) {
+      PackedInt64Array rowids;
+      rowids.resize(E.value.size());
+      int64_t *w = rowids.ptrw();
+      for (const int64_t &rowid : E.value) {
+        *w++ = rowid;
+      }
+      emit_signal(SNAME("table_changed"), E.key, rowids);
     }
+    emit_signal(SNAME("committed"));
+  } else if (events.is_empty() && commits > 0) {
+    // Transactions that didn't change any row.
+    emit_signal(SNAME("committed"));
   }
 
-  return true;
+  if (rollbacks > 0) {
+    emit_signal(SNAME("rolled_back"));
+  }
 }
 
-bool SQLite::query_with_args(String query, Array args) {
-  sqlite3_stmt *stmt = prepare(query.utf8().get_data());
+void SQLite::set_change_notifications(ChangeNotifications p_mode) {
+  ERR_FAIL_COND_MSG(is_open_pending(),
+                    "The database is being opened on a thread.");
+  {
+    MutexLock lock(changes_mutex);
+    change_notifications = p_mode;
+    pending_changes.clear();
+    savepoints.clear();
+  }
+  if (p_mode != CHANGE_NOTIFICATIONS_DISABLED && get_handler() != nullptr) {
+    // `DELETE FROM table` must report its rows.
+    install_statement_hooks();
+  }
+}
 
-  // Failed to prepare the query
-  ERR_FAIL_COND_V_MSG(stmt == nullptr, false,
-                      "SQLiteQuery preparation error: " +
+SQLite::ChangeNotifications SQLite::get_change_notifications() const {
+  return change_notifications;
+}
+
+Ref<SQLiteSession> SQLite::create_session(String p_database) {
+  sqlite3 *dbs = get_handler();
+  ERR_FAIL_COND_V_MSG(dbs == nullptr, Ref<SQLiteSession>(),
+                      "Cannot create a session! Database is not opened.");
+
+  sqlite3_session *handle = nullptr;
+  const int result =
+      sqlite3session_create(dbs, p_database.utf8().get_data(), &handle);
+  ERR_FAIL_COND_V_MSG(result != SQLITE_OK, Ref<SQLiteSession>(),
+                      "Cannot create the session: " +
                           get_last_error_message());
 
-  // Error occurred during argument binding
-  if (!bind_args(stmt, args)) {
-    sqlite3_finalize(stmt);
-    ERR_FAIL_V_MSG(false,
-                   "Error during arguments bind: " + get_last_error_message());
-  }
+  Ref<SQLiteSession> session;
+  session.instantiate();
+  session->init(this, handle);
 
-  // Evaluate the sql query
-  sqlite3_step(stmt);
-  sqlite3_finalize(stmt);
+  WeakRef *wr = memnew(WeakRef);
+  wr->set_obj(session.ptr());
+  sessions.push_back(wr);
 
-  return true;
+  return session;
 }
 
-Ref<SQLiteQuery> SQLite::create_query(String p_query) {
-  Ref<SQLiteQuery> query;
-  query.instantiate();
-  query->init(this, p_query);
+static int changeset_conflict(void *p_ctx, int p_conflict,
+                              sqlite3_changeset_iter *p_iter) {
+  const Callable *handler = static_cast<const Callable *>(p_ctx);
+  if (handler->is_null()) {
+    return SQLITE_CHANGESET_ABORT;
+  }
 
-  WeakRef *wr = memnew(WeakRef);
-  wr->set_obj(query.ptr());
-  queries.push_back(wr);
+  const char *table = nullptr;
+  int column_count = 0;
+  int operation = 0;
+  sqlite3changeset_op(p_iter, &table, &column_count, &operation, nullptr);
+
+  const Variant conflict_arg = p_conflict;
+  const Variant table_arg = String::utf8(table);
+  const Variant operation_arg = operation;
+  const Variant *args[3] = {&conflict_arg, &table_arg, &operation_arg};
+  Variant ret;
+  Callable::CallError ce;
+  handler->call(args, 3, ret, ce);
+  ERR_FAIL_COND_V_MSG(ce.error != Callable::CallError::CALL_OK,
+                      SQLITE_CHANGESET_ABORT,
+                      "Error calling the changeset conflict handler: " +
+                          Variant::get_callable_error_text(*handler, args, 3,
+                                                           ce));
+
+  const int action = ret;
+  if (action == SQLITE_CHANGESET_OMIT || action == SQLITE_CHANGESET_ABORT) {
+    return action;
+  }
+  // REPLACE is only allowed for these two kinds of conflict.
+  ERR_FAIL_COND_V_MSG(action != SQLITE_CHANGESET_REPLACE ||
+                          (p_conflict != SQLITE_CHANGESET_DATA &&
+                           p_conflict != SQLITE_CHANGESET_CONFLICT),
+                      SQLITE_CHANGESET_ABORT,
+                      "Invalid action returned by the changeset conflict "
+                      "handler: " + itos(action));
+  return action;
+}
 
-  return query;
+bool SQLite::apply_changeset(PackedByteArray p_changeset,
+                             Callable p_conflict_handler) {
+  sqlite3 *dbs = get_handler();
+  ERR_FAIL_COND_V_MSG(dbs == nullptr, false,
+                      "Cannot apply the changeset! Database is not opened.");
+
+  const int result = sqlite3changeset_apply(
+      dbs, p_changeset.size(), (void *)p_changeset.ptr(), nullptr,
+      changeset_conflict, &p_conflict_handler);
+  ERR_FAIL_COND_V_MSG(result != SQLITE_OK, false,
+                      "Cannot apply the changeset: " +
+                          get_last_error_message());
+  return true;
 }
 
 bool SQLite::query(String query) {
@@ -430,20 +3144,35 @@ Array SQLite::fetch_rows(String statement, Array args, int result_type) {
     return result;
   }
 
+  // The keys are the same for every row.
+  const int col_count = sqlite3_column_count(stmt);
+  LocalVector<Variant> keys;
+  if (result_type != RESULT_NUM) {
+    keys.resize(col_count);
+    for (int i = 0; i < col_count; i++) {
+      keys[i] = String::utf8(sqlite3_column_name(stmt, i));
+    }
+  }
+
   // Fetch rows
-  while (sqlite3_step(stmt) == SQLITE_ROW) {
+  int res;
+  while ((res = sqlite3_step(stmt)) == SQLITE_ROW) {
     // Do a step
-    result.append(parse_row(stmt, result_type));
+    result.append(parse_row(stmt, result_type, keys));
   }
 
   // Delete prepared statement
   sqlite3_finalize(stmt);
+  if (res != SQLITE_DONE) {
+    discard_statement_changes();
+  }
 
   // Return the result
   return result;
 }
 
-Dictionary SQLite::parse_row(sqlite3_stmt *stmt, int result_type) {
+Dictionary SQLite::parse_row(sqlite3_stmt *stmt, int result_type,
+                             const LocalVector<Variant> &keys) {
   Dictionary result;
 
   // Get column count
@@ -451,52 +3180,16 @@ Dictionary SQLite::parse_row(sqlite3_stmt *stmt, int result_type) {
 
   // Fetch all column
   for (int i = 0; i < col_count; i++) {
-    // Key name
-    const char *col_name = sqlite3_column_name(stmt, i);
-    String key = String(col_name);
-
-    // Value
-    int col_type = sqlite3_column_type(stmt, i);
-    Variant value;
-
-    // Get column value
-    switch (col_type) {
-    case SQLITE_INTEGER:
-      value = Variant(sqlite3_column_int(stmt, i));
-      break;
-
-    case SQLITE_FLOAT:
-      value = Variant(sqlite3_column_double(stmt, i));
-      break;
-
-    case SQLITE_TEXT: {
-      int size = sqlite3_column_bytes(stmt, i);
-      String str =
-          String::utf8((const char *)sqlite3_column_text(stmt, i), size);
-      value = Variant(str);
-      break;
-    }
-    case SQLITE_BLOB: {
-      PackedByteArray arr;
-      int size = sqlite3_column_bytes(stmt, i);
-      arr.resize(size);
-      memcpy((void *)arr.ptr(), sqlite3_column_blob(stmt, i), size);
-      value = Variant(arr);
-      break;
-    }
-
-    default:
-      break;
-    }
+    const Variant value = column_value(stmt, i);
 
     // Set dictionary value
     if (result_type == RESULT_NUM)
       result[i] = value;
     else if (result_type == RESULT_ASSOC)
-      result[key] = value;
+      result[keys[i]] = value;
     else {
       result[i] = value;
-      result[key] = value;
+      result[keys[i]] = value;
     }
   }
 
@@ -519,6 +3212,52 @@ Array SQLite::fetch_assoc_with_args(String query, Array args) {
   return fetch_rows(query, args, RESULT_ASSOC);
 }
 
+Array SQLite::knn(String p_table, String p_column, PackedFloat32Array p_query,
+                  int p_k, VectorMetric p_metric, int p_probes) {
+  return sqlite_vector_knn(get_handler(), p_table, p_column, p_query, p_k,
+                           SQLiteVectorMetric(p_metric), p_probes);
+}
+
+bool SQLite::create_vector_index(String p_table, String p_column, int p_lists,
+                                 int p_iterations) {
+  return sqlite_vector_create_index(get_handler(), p_table, p_column, p_lists,
+                                    p_iterations);
+}
+
+bool SQLite::drop_vector_index(String p_table, String p_column) {
+  return sqlite_vector_drop_index(get_handler(), p_table, p_column);
+}
+
+Dictionary SQLite::get_memory_stats(bool p_reset) const {
+  ERR_FAIL_COND_V_MSG(get_handler() == nullptr, Dictionary(),
+                      "Database is not opened.");
+  return sqlite_memory_connection_stats(get_handler(), p_reset);
+}
+
+Dictionary SQLite::get_global_memory_stats() {
+  return sqlite_memory_global_stats();
+}
+
+Dictionary SQLite::get_page_cache_stats() const {
+  ERR_FAIL_COND_V_MSG(!sqlite_pcache_is_enabled(), Dictionary(),
+                      "The shared page cache is disabled, enable "
+                      "`sqlite/memory/shared_page_cache` in the project "
+                      "settings.");
+  return sqlite_pcache_owner_stats(this);
+}
+
+void SQLite::set_shared_page_cache_budget(int64_t p_bytes) {
+  sqlite_pcache_set_budget(p_bytes);
+}
+
+int64_t SQLite::get_shared_page_cache_budget() {
+  return sqlite_pcache_get_budget();
+}
+
+Dictionary SQLite::get_shared_page_cache_stats() {
+  return sqlite_pcache_global_stats();
+}
+
 String SQLite::get_last_error_message() const {
   return sqlite3_errmsg(get_handler());
 }
@@ -533,18 +3272,91 @@ SQLite::~SQLite() {
       query->init(nullptr, "");
     }
   }
+  for (uint32_t i = 0; i < scripts.size(); i += 1) {
+    SQLiteCompiledScript *script =
+        Object::cast_to<SQLiteCompiledScript>(scripts[i]->get_ref());
+    if (script != nullptr) {
+      script->init(nullptr, "");
+    }
+  }
 }
 
 void SQLite::_bind_methods() {
   ClassDB::bind_method(D_METHOD("open", "path"), &SQLite::open);
+  ClassDB::bind_method(D_METHOD("open_with_options", "path", "options"),
+                       &SQLite::open_with_options);
+  ClassDB::bind_method(D_METHOD("open_encrypted", "path", "key"),
+                       &SQLite::open_encrypted);
+  ClassDB::bind_method(D_METHOD("open_async", "path", "options"),
+                       &SQLite::open_async, DEFVAL(Dictionary()));
+  ClassDB::bind_method(D_METHOD("is_opening"), &SQLite::is_opening);
+  ClassDB::bind_method(D_METHOD("wait_open"), &SQLite::wait_open);
+  ClassDB::bind_method(D_METHOD("_open_async_finished"),
+                       &SQLite::_open_async_finished);
   ClassDB::bind_method(D_METHOD("open_in_memory"), &SQLite::open_in_memory);
   ClassDB::bind_method(D_METHOD("open_buffered", "path", "buffers", "size"),
                        &SQLite::open_buffered);
 
   ClassDB::bind_method(D_METHOD("close"), &SQLite::close);
 
+  ClassDB::bind_static_method("SQLite", D_METHOD("get_export_metadata", "path"),
+                              &SQLite::get_export_metadata);
+  ClassDB::bind_static_method(
+      "SQLite",
+      D_METHOD("compress_database", "source", "destination", "mode",
+               "group_size"),
+      &SQLite::compress_database, DEFVAL(Compression::MODE_ZSTD),
+      DEFVAL(65536));
   ClassDB::bind_method(D_METHOD("create_query", "statement"),
                        &SQLite::create_query);
+  ClassDB::bind_method(D_METHOD("prepare_all"), &SQLite::prepare_all);
+  ClassDB::bind_method(D_METHOD("execute_script", "sql", "transaction"),
+                       &SQLite::execute_script, DEFVAL(true));
+  ClassDB::bind_method(D_METHOD("compile_script", "sql"),
+                       &SQLite::compile_script);
+  ClassDB::bind_method(
+      D_METHOD("migrate", "migrations", "disable_foreign_keys"),
+      &SQLite::migrate, DEFVAL(false));
+  ClassDB::bind_method(
+      D_METHOD("export_csv", "query", "arguments", "path", "options"),
+      &SQLite::export_csv, DEFVAL(Dictionary()));
+  ClassDB::bind_method(D_METHOD("import_csv", "path", "table", "options"),
+                       &SQLite::import_csv, DEFVAL(Dictionary()));
+  ClassDB::bind_method(D_METHOD("upsert", "table", "rows", "conflict_columns"),
+                       &SQLite::upsert);
+
+  ClassDB::bind_method(D_METHOD("backup_to", "destination", "pages_per_step"),
+                       &SQLite::backup_to, DEFVAL(64));
+  ClassDB::bind_method(D_METHOD("backup_from", "source", "pages_per_step"),
+                       &SQLite::backup_from, DEFVAL(-1));
+
+  ClassDB::bind_method(D_METHOD("set_change_notifications", "mode"),
+                       &SQLite::set_change_notifications);
+  ClassDB::bind_method(D_METHOD("get_change_notifications"),
+                       &SQLite::get_change_notifications);
+  ClassDB::bind_method(D_METHOD("_flush_changes"), &SQLite::_flush_changes);
+  ADD_PROPERTY(PropertyInfo(Variant::INT, "change_notifications",
+                            PROPERTY_HINT_ENUM, "Disabled,Rows,Coalesced"),
+               "set_change_notifications", "get_change_notifications");
+
+  ADD_SIGNAL(MethodInfo("row_changed", PropertyInfo(Variant::STRING, "table"),
+                        PropertyInfo(Variant::INT, "operation"),
+                        PropertyInfo(Variant::INT, "rowid")));
+  ADD_SIGNAL(MethodInfo("table_changed",
+                        PropertyInfo(Variant::STRING, "table"),
+                        PropertyInfo(Variant::PACKED_INT64_ARRAY, "rowids")));
+  ADD_SIGNAL(MethodInfo("committed"));
+  ADD_SIGNAL(MethodInfo("csv_import_progress",
+                        PropertyInfo(Variant::STRING, "table"),
+                        PropertyInfo(Variant::FLOAT, "progress")));
+  ADD_SIGNAL(MethodInfo("rolled_back"));
+  ADD_SIGNAL(MethodInfo("opened", PropertyInfo(Variant::BOOL, "success")));
+
+  ClassDB::bind_method(D_METHOD("create_session", "database"),
+                       &SQLite::create_session, DEFVAL("main"));
+  ClassDB::bind_method(
+      D_METHOD("apply_changeset", "changeset", "conflict_handler"),
+      &SQLite::apply_changeset, DEFVAL(Callable()));
 
   ClassDB::bind_method(D_METHOD("query", "statement"), &SQLite::query);
   ClassDB::bind_method(D_METHOD("query_with_args", "statement", "args"),
@@ -557,4 +3369,70 @@ void SQLite::_bind_methods() {
                        &SQLite::fetch_assoc);
   ClassDB::bind_method(D_METHOD("fetch_assoc_with_args", "statement", "args"),
                        &SQLite::fetch_assoc_with_args);
+  ClassDB::bind_static_method("SQLite", D_METHOD("carray", "values"),
+                              &SQLite::carray);
+
+  ClassDB::bind_method(D_METHOD("create_function", "name", "function", "argc",
+                                "deterministic"),
+                       &SQLite::create_function, DEFVAL(-1), DEFVAL(false));
+  ClassDB::bind_method(D_METHOD("create_aggregate", "name", "step", "final",
+                                "argc", "deterministic"),
+                       &SQLite::create_aggregate, DEFVAL(-1), DEFVAL(false));
+
+  ClassDB::bind_method(D_METHOD("knn", "table", "column", "query", "k",
+                                "metric", "probes"),
+                       &SQLite::knn, DEFVAL(VECTOR_METRIC_L2), DEFVAL(8));
+  ClassDB::bind_method(D_METHOD("create_vector_index", "table", "column",
+                                "lists", "iterations"),
+                       &SQLite::create_vector_index, DEFVAL(256), DEFVAL(10));
+  ClassDB::bind_method(D_METHOD("drop_vector_index", "table", "column"),
+                       &SQLite::drop_vector_index);
+
+  ClassDB::bind_method(D_METHOD("get_memory_stats", "reset"),
+                       &SQLite::get_memory_stats, DEFVAL(false));
+  ClassDB::bind_static_method("SQLite", D_METHOD("get_global_memory_stats"),
+                              &SQLite::get_global_memory_stats);
+
+  ClassDB::bind_method(D_METHOD("get_page_cache_stats"),
+                       &SQLite::get_page_cache_stats);
+
+  ClassDB::bind_method(D_METHOD("set_result_cache_budget", "bytes"),
+                       &SQLite::set_result_cache_budget);
+  ClassDB::bind_method(D_METHOD("get_result_cache_budget"),
+                       &SQLite::get_result_cache_budget);
+  ClassDB::bind_method(D_METHOD("get_result_cache_stats"),
+                       &SQLite::get_result_cache_stats);
+  ClassDB::bind_method(D_METHOD("clear_result_cache"),
+                       &SQLite::clear_result_cache);
+  ClassDB::bind_static_method(
+      "SQLite", D_METHOD("set_shared_page_cache_budget", "bytes"),
+      &SQLite::set_shared_page_cache_budget);
+  ClassDB::bind_static_method("SQLite",
+                              D_METHOD("get_shared_page_cache_budget"),
+                              &SQLite::get_shared_page_cache_budget);
+  ClassDB::bind_static_method("SQLite",
+                              D_METHOD("get_shared_page_cache_stats"),
+                              &SQLite::get_shared_page_cache_stats);
+
+  BIND_ENUM_CONSTANT(OPERATION_INSERT);
+  BIND_ENUM_CONSTANT(OPERATION_UPDATE);
+  BIND_ENUM_CONSTANT(OPERATION_DELETE);
+
+  BIND_ENUM_CONSTANT(CHANGESET_CONFLICT_DATA);
+  BIND_ENUM_CONSTANT(CHANGESET_CONFLICT_NOTFOUND);
+  BIND_ENUM_CONSTANT(CHANGESET_CONFLICT_CONFLICT);
+  BIND_ENUM_CONSTANT(CHANGESET_CONFLICT_CONSTRAINT);
+  BIND_ENUM_CONSTANT(CHANGESET_CONFLICT_FOREIGN_KEY);
+
+  BIND_ENUM_CONSTANT(CHANGESET_OMIT);
+  BIND_ENUM_CONSTANT(CHANGESET_REPLACE);
+  BIND_ENUM_CONSTANT(CHANGESET_ABORT);
+
+  BIND_ENUM_CONSTANT(CHANGE_NOTIFICATIONS_DISABLED);
+  BIND_ENUM_CONSTANT(CHANGE_NOTIFICATIONS_ROWS);
+  BIND_ENUM_CONSTANT(CHANGE_NOTIFICATIONS_COALESCED);
+
+  BIND_ENUM_CONSTANT(VECTOR_METRIC_L2);
+  BIND_ENUM_CONSTANT(VECTOR_METRIC_COSINE);
+  BIND_ENUM_CONSTANT(VECTOR_METRIC_DOT);
 }
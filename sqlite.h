@@ -3,7 +3,22 @@
 
 #include "core/config/engine.h"
 #include "core/object/ref_counted.h"
+#include "core/object/script_language.h"
+#include "core/os/mutex.h"
+#include "core/os/thread.h"
+#include "core/templates/hash_map.h"
+#include "core/templates/hash_set.h"
+#include "core/variant/callable.h"
 #include "core/templates/local_vector.h"
+#include "core/templates/pair.h"
+
+#include "sqlite_backup.h"
+#include "sqlite_carray.h"
+#include "sqlite_result_cache.h"
+#include "sqlite_script.h"
+#include "sqlite_session.h"
+#include "sqlite_vector.h"
+#include "sqlite_zvfs.h"
 
 // SQLite3
 #include "thirdparty/sqlite/spmemvfs.h"
@@ -14,10 +29,48 @@ class SQLite;
 class SQLiteQuery : public RefCounted {
   GDCLASS(SQLiteQuery, RefCounted);
 
+  friend class SQLite;
+
   SQLite *db = nullptr;
   sqlite3_stmt *stmt = nullptr;
   String query;
 
+  // Result cache: `id` keys the results of this query, `cached_tables` are
+  // the tables read by the statement, found while it's prepared.
+  static SafeNumeric<uint64_t> last_id;
+  uint64_t id = 0;
+  bool cache_results = false;
+  bool cacheable = false;
+  LocalVector<uint32_t> cached_tables;
+
+  // Row decoding, chosen once per statement from the declared types of the
+  // columns, or from the first row: uniform rows use a loop specialized for
+  // their type, the others a reader per column.
+  enum RowLayout {
+    ROW_UNRESOLVED,
+    ROW_INTEGER,
+    ROW_REAL,
+    ROW_MIXED,
+  };
+  typedef Variant (*ColumnReader)(sqlite3_stmt *p_stmt, int p_column);
+  LocalVector<int> column_types;
+  LocalVector<ColumnReader> column_readers;
+  RowLayout row_layout = ROW_UNRESOLVED;
+
+  // How the columns are assigned by `execute_into_objects()`, resolved the
+  // first time it's called with `object_class`, and again when a schema
+  // change gives the statement other columns.
+  struct ObjectColumn {
+    StringName property;
+    // The native setter, when there is one, called without looking it up.
+    MethodBind *setter = nullptr;
+    bool assigned = false;
+  };
+  Variant object_class;
+  StringName object_native_class;
+  Ref<Script> object_script;
+  LocalVector<ObjectColumn> object_columns;
+
 protected:
   static void _bind_methods();
 
@@ -65,19 +118,81 @@ public:
   /// Returns: `[[0,1], [1,2], [2,3]]`
   Variant batch_execute(Array p_rows);
 
+  /// Executes the query, and returns an Array with an Object per row, which
+  /// columns are assigned to the properties of the same name. `p_class` is
+  /// a class name, native or registered with `class_name`, or a Script.
+  /// ```
+  /// var query = db.create_query("SELECT name, score FROM players;")
+  /// var players = query.execute_into_objects(PlayerData)
+  /// ```
+  /// The columns are mapped to the properties once per query, the columns
+  /// without a matching property are ignored.
+  Variant execute_into_objects(Variant p_class, Array p_args = Array());
+
+  /// Executes the query, and returns the values of the column `p_column`
+  /// in a packed array, without a container per row.
+  /// ```
+  /// var ids = db.create_query("SELECT id FROM players;").execute_column()
+  /// # ids is a PackedInt64Array
+  /// ```
+  /// `p_type` is the Variant type of the result: PackedInt32Array,
+  /// PackedInt64Array, PackedFloat32Array, PackedFloat64Array,
+  /// PackedStringArray or Array. By default it's chosen from the first value
+  /// which isn't NULL. The values are converted by SQLite, NULL gives 0 or
+  /// an empty String.
+  Variant execute_column(Array p_args = Array(), int p_column = 0,
+                         int p_type = Variant::NIL);
+
+  /// Executes the query, and returns the first column of its first row, or
+  /// null when there are no rows. The other rows aren't read.
+  /// ```
+  /// var query = db.create_query("SELECT count(*) FROM players;")
+  /// var count = query.execute_scalar()
+  /// ```
+  Variant execute_scalar(Array p_args = Array());
+
+  /// Executes the query, and returns the result as JSON text, written
+  /// straight from the statement: an Array of objects, or with
+  /// `p_columnar` an object with an Array per column.
+  /// ```
+  /// print(db.create_query("SELECT id, name FROM players;").execute_json())
+  /// # prints: [{"id":1,"name":"a"},{"id":2,"name":"b"}]
+  /// ```
+  /// Integers keep their 64 bits, BLOBs are written in base64 and
+  /// non-finite reals as null. Returns an empty String in case of error.
+  String execute_json(Array p_args = Array(), bool p_columnar = false);
+
+  /// Like `execute_json()`, but returns the UTF-8 text, ready to be sent.
+  PackedByteArray execute_json_bytes(Array p_args = Array(),
+                                     bool p_columnar = false);
+
   /// Return the list of columns of this query.
   Array get_columns();
 
+  /// Keeps the results of `execute()` in the result cache of the database,
+  /// per arguments, until a table they were read from changes. The cached
+  /// Array is returned as is, so it must not be modified. Queries which
+  /// write, call random() or read virtual or WITHOUT ROWID tables are never
+  /// cached.
+  void set_cache_results(bool p_enabled);
+  bool is_caching_results() const;
+
   void finalize();
 
 private:
   bool prepare();
+  void reset_column_types();
+  void resolve_decoders();
+  Array decode_row();
+  bool map_object_columns(const Variant &p_class);
+  Object *instantiate_object() const;
 };
 
 class SQLite : public RefCounted {
   GDCLASS(SQLite, RefCounted);
 
   friend class SQLiteQuery;
+  friend class SQLiteCompiledScript;
 
 private:
   // sqlite handler
@@ -86,16 +201,100 @@ private:
   // vfs
   spmemvfs_db_t p_db;
   bool memory_read;
+  // Name of the encrypted database, as known by the encryption VFS.
+  String encrypted_name;
 
   ::LocalVector<WeakRef *, uint32_t, true> queries;
+  ::LocalVector<WeakRef *, uint32_t, true> scripts;
+  ::LocalVector<WeakRef *, uint32_t, true> sessions;
+  ::LocalVector<WeakRef *, uint32_t, true> backups;
+
+  struct UserFunction {
+    String name;
+    Callable function;
+    Callable step;
+    Callable final;
+    int argc = -1;
+    bool deterministic = false;
+  };
+
+  // SQL functions registered by the user, they are installed on every
+  // connection this object opens.
+  LocalVector<UserFunction> functions;
+
+  // Validated `open_with_options()` options.
+  struct OpenOptions {
+    int flags = SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE;
+    bool uri = false;
+    bool immutable = false;
+    int busy_timeout = -1;
+    // Reads the file ahead once opened, see `sqlite_memory_prefault()`.
+    bool prefault = false;
+    // Pragma name and value, in the order they have to be applied.
+    LocalVector<Pair<String, String>> pragmas;
+  };
+
+  static bool parse_open_options(const Dictionary &p_options,
+                                 OpenOptions &r_options);
+  bool apply_open_options(const OpenOptions &p_options);
+
+  bool open_memory(const String &name, const PackedByteArray &buffers,
+                   int64_t size, const char *vfs);
+  // Registers the functions and the hooks on a new connection, which is
+  // closed when that fails.
+  bool setup_connection();
+  bool configure_connection();
+
+  // `open_async()`: the database is opened on `open_thread`, and is handed
+  // to the other threads once it has been joined.
+  struct AsyncOpen {
+    String path;
+    Dictionary options;
+    PackedStringArray warm_up;
+    bool prepare_queries = false;
+    bool success = false;
+  };
+  AsyncOpen async_open;
+  Thread open_thread;
+  // Joined by `close()`, `opened` is still to be emitted, with false.
+  bool open_aborted = false;
+  static void open_thread_func(void *p_self);
+  void warm_up(const PackedStringArray &p_names);
+  // True on the other threads while `open_async()` runs.
+  bool is_open_pending() const;
+  void _open_async_finished();
+  void finish_open_async();
+  Ref<SQLiteBackup> create_backup(const Variant &p_other, int p_pages_per_step,
+                                  bool p_to_other);
+  bool register_function(const UserFunction &p_function);
+
+  // Statements of `upsert()`, by their SQL: one per table and set of
+  // columns. `r_keys` are the columns, in the order of the parameters.
+  HashMap<String, sqlite3_stmt *> upsert_statements;
+  sqlite3_stmt *upsert_statement(const String &p_table, const Dictionary &p_row,
+                                 const PackedStringArray &p_conflict_columns,
+                                 LocalVector<Variant> &r_keys);
+  void clear_upsert_statements();
 
   sqlite3_stmt *prepare(const char *statement);
   Array fetch_rows(String query, Array args, int result_type = RESULT_BOTH);
-  sqlite3 *get_handler() const { return memory_read ? p_db.handle : db; }
-  Dictionary parse_row(sqlite3_stmt *stmt, int result_type);
+  // Null on the other threads while `open_async()` runs, so that every entry
+  // point fails as if the database was closed.
+  sqlite3 *get_handler() const {
+    if (is_open_pending()) {
+      return nullptr;
+    }
+    return memory_read ? p_db.handle : db;
+  }
+  Dictionary parse_row(sqlite3_stmt *stmt, int result_type,
+                       const LocalVector<Variant> &keys);
 
 public:
   static bool bind_args(sqlite3_stmt *stmt, Array args);
+  static bool bind_value(sqlite3_stmt *stmt, int index, const Variant &value);
+
+  /// Returns `p_name` as a quoted SQL identifier: `"p_name"`.
+  static String quote_identifier(const String &p_name);
 
 protected:
   static void _bind_methods();
@@ -103,21 +302,297 @@ protected:
 public:
   enum { RESULT_BOTH = 0, RESULT_NUM, RESULT_ASSOC };
 
+  enum Operation {
+    OPERATION_INSERT = SQLITE_INSERT,
+    OPERATION_UPDATE = SQLITE_UPDATE,
+    OPERATION_DELETE = SQLITE_DELETE,
+  };
+
+  enum ChangesetConflict {
+    CHANGESET_CONFLICT_DATA = SQLITE_CHANGESET_DATA,
+    CHANGESET_CONFLICT_NOTFOUND = SQLITE_CHANGESET_NOTFOUND,
+    CHANGESET_CONFLICT_CONFLICT = SQLITE_CHANGESET_CONFLICT,
+    CHANGESET_CONFLICT_CONSTRAINT = SQLITE_CHANGESET_CONSTRAINT,
+    CHANGESET_CONFLICT_FOREIGN_KEY = SQLITE_CHANGESET_FOREIGN_KEY,
+  };
+
+  enum ChangesetAction {
+    CHANGESET_OMIT = SQLITE_CHANGESET_OMIT,
+    CHANGESET_REPLACE = SQLITE_CHANGESET_REPLACE,
+    CHANGESET_ABORT = SQLITE_CHANGESET_ABORT,
+  };
+
+  enum VectorMetric {
+    VECTOR_METRIC_L2 = SQLITE_VECTOR_METRIC_L2,
+    VECTOR_METRIC_COSINE = SQLITE_VECTOR_METRIC_COSINE,
+    VECTOR_METRIC_DOT = SQLITE_VECTOR_METRIC_DOT,
+  };
+
+  enum ChangeNotifications {
+    CHANGE_NOTIFICATIONS_DISABLED,
+    CHANGE_NOTIFICATIONS_ROWS,
+    CHANGE_NOTIFICATIONS_COALESCED,
+  };
+
+private:
+  // Changes reported by the SQLite hooks. The hooks can't touch the
+  // connection, so the signals are emitted later by `_flush_changes()`.
+  struct ChangeEvent {
+    String table;
+    // 0 marks the end of a committed transaction.
+    int operation = 0;
+    int64_t rowid = 0;
+  };
+
+  ChangeNotifications change_notifications = CHANGE_NOTIFICATIONS_DISABLED;
+  Mutex changes_mutex;
+  // Changes of the transaction in progress.
+  LocalVector<ChangeEvent> pending_changes;
+  // Savepoints of the transaction in progress, with the number of pending
+  // changes when they started: `ROLLBACK TO` doesn't call the rollback hook.
+  LocalVector<Pair<String, uint32_t>> savepoints;
+  // The number of pending changes when the last statement started. Within a
+  // transaction, a failed statement is undone without calling the rollback
+  // hook either.
+  uint32_t statement_changes = 0;
+  // CHANGE_NOTIFICATIONS_ROWS: committed changes, not emitted yet.
+  LocalVector<ChangeEvent> committed_changes;
+  // CHANGE_NOTIFICATIONS_COALESCED: rowids changed per table.
+  HashMap<String, HashSet<int64_t>> committed_tables;
+  uint32_t commit_count = 0;
+  uint32_t rollback_count = 0;
+  bool flush_queued = false;
+
+  static void update_hook(void *p_self, int p_operation,
+                          const char *p_database, const char *p_table,
+                          sqlite3_int64 p_rowid);
+  static int commit_hook(void *p_self);
+  static void rollback_hook(void *p_self);
+  void queue_flush_changes();
+  void _flush_changes();
+  // Drops the changes of the statement which just failed.
+  void discard_statement_changes();
+
+  // Results of the queries with `cache_results`. Tracking starts with the
+  // first of these queries.
+  SQLiteResultCache result_cache;
+  bool result_cache_tracking = false;
+  // Installed for the result cache and the change notifications: the
+  // authorizer, to find the tables read by the queries and to make every
+  // DELETE report its rows, and the trace hook, to see the savepoint
+  // statements run.
+  bool statement_hooks = false;
+  // Tables read by the statement being prepared.
+  LocalVector<uint32_t> *discovered_tables = nullptr;
+  bool discovered_uncacheable = false;
+  // Changes made by other connections and schema changes.
+  sqlite3_stmt *data_version_stmt = nullptr;
+  sqlite3_stmt *schema_version_stmt = nullptr;
+  int64_t data_version = -1;
+  int64_t schema_version = -1;
+
+  static int authorizer(void *p_self, int p_action, const char *p_arg1,
+                        const char *p_arg2, const char *p_database,
+                        const char *p_trigger);
+  bool is_volatile_function(const char *p_name) const;
+
+  // Savepoint statements, found when they run by the trace hook.
+  enum TransactionStatement {
+    TRANSACTION_OTHER,
+    TRANSACTION_SAVEPOINT,
+    TRANSACTION_RELEASE,
+    TRANSACTION_ROLLBACK_TO,
+  };
+  static TransactionStatement parse_transaction_statement(const char *p_sql,
+                                                          String &r_savepoint);
+  static int trace_hook(unsigned p_type, void *p_self, void *p_stmt,
+                        void *p_sql);
+  void install_statement_hooks();
+  void start_result_cache_tracking();
+  bool check_cached_tables(const LocalVector<uint32_t> &p_tables);
+  void refresh_result_cache();
+
+  int64_t read_pragma(const char *p_pragma);
+
+public:
   SQLite();
   ~SQLite();
 
   // methods
   bool open(String path);
+
+  /// Opens the database with the given flags and pragmas:
+  /// ```
+  /// db.open_with_options("user://world.db", {
+  ///     "preset": "write_heavy",
+  ///     "cache_size": -65536,
+  /// })
+  /// ```
+  /// - `preset`: `read_mostly`, `write_heavy` or `bulk_load`; the other
+  ///   keys override the values of the preset.
+  /// - `read_only`, `no_mutex`, `uri`, `immutable`: `sqlite3_open_v2()`
+  ///   flags.
+  /// - `journal_mode`, `synchronous`, `cache_size`, `mmap_size`,
+  ///   `temp_store`, `page_size`, `busy_timeout`: the matching pragmas.
+  /// - `prefault`: reads the file ahead, up to `mmap_size` when mapped, so
+  ///   the first queries don't wait on the disk. Only in the background on
+  ///   Linux, elsewhere the open reads the file.
+  /// Unknown keys and invalid values fail the open.
+  bool open_with_options(String p_path, Dictionary p_options);
+  /// Opens or creates a database encrypted with AES, using a 16, 24 or 32
+  /// bytes `p_key`. The database, its journal and its WAL are encrypted page
+  /// by page, so it can be queried like any other database.
+  /// ```
+  /// db.open_encrypted("user://save.db", key)
+  /// # Encrypting an existing database:
+  /// db.backup_from("user://plain.db").run()
+  /// ```
+  bool open_encrypted(String p_path, PackedByteArray p_key);
+  /// Opens the database on a thread, with the options of
+  /// `open_with_options()`, then emits `opened`. Also loads the schema and,
+  /// with the `warm_up` option, reads the listed tables and indexes into the
+  /// page cache. With `prepare_queries`, `prepare_all()` is called before
+  /// `opened` is emitted. The database can't be used until then.
+  /// ```
+  /// db.open_async("user://world.db", {"warm_up": ["chunks", "chunks_xy"]})
+  /// await db.opened
+  /// ```
+  bool open_async(String p_path, Dictionary p_options = Dictionary());
+  bool is_opening() const;
+  /// Waits for `open_async()`, returns true if the database is open.
+  bool wait_open();
   bool open_in_memory();
   bool open_buffered(String name, PackedByteArray buffers, int64_t size);
   void close();
 
+  /// Returns the metadata written by the export plugin for the database at
+  /// `p_path` (`page_size`, `page_count`, `user_version`, `schema_version`,
+  /// `schema_hash` and `size`), or an empty Dictionary when there is none.
+  static Dictionary get_export_metadata(String p_path);
+
+  /// Writes a compressed copy of the database `p_source` to `p_destination`,
+  /// which `open()` reads directly, read only, decompressing only the groups
+  /// of `p_group_size` bytes it uses. `p_mode` is a `File.COMPRESSION_*`
+  /// mode.
+  static bool compress_database(String p_source, String p_destination,
+                                int p_mode = Compression::MODE_ZSTD,
+                                int p_group_size = 65536);
+
+  /// Writes the result of `p_query` to the CSV file `p_path`, streamed a
+  /// chunk at a time. Returns the number of rows written, or -1 on error.
+  /// `p_options` takes `delimiter` (",") and `header` (true).
+  int64_t export_csv(String p_query, Array p_args, String p_path,
+                     Dictionary p_options = Dictionary());
+
+  /// Inserts the records of the CSV file `p_path` into `p_table`, in one
+  /// transaction. The file is split in chunks parsed on threads, while the
+  /// rows are inserted by a single prepared statement. Returns the number of
+  /// rows inserted, or -1 on error, in which case nothing is inserted.
+  /// `csv_import_progress` is emitted after each chunk.
+  /// ```
+  /// db.import_csv("res://items.csv", "items", {"delimiter": ";"})
+  /// ```
+  /// `p_options` takes `delimiter` (","), `header` (true), `columns`
+  /// (the names when there is no header), `create_table` (true),
+  /// `infer_types` (true), `threads` and `chunk_size` (1 MiB).
+  int64_t import_csv(String p_path, String p_table,
+                     Dictionary p_options = Dictionary());
+
+  /// Inserts the Dictionaries `p_rows` into `p_table`, or updates the rows
+  /// which conflict on `p_conflict_columns`, in one transaction. The columns
+  /// are the keys of the Dictionaries; the statement of each set of columns
+  /// is prepared once and kept. Returns the number of rows inserted or
+  /// updated, or -1 on error, in which case nothing is written.
+  /// ```
+  /// db.upsert("players", [{"id": 1, "name": "Ada", "score": 10}], ["id"])
+  /// ```
+  int64_t upsert(String p_table, Array p_rows,
+                 PackedStringArray p_conflict_columns);
+
   /// Compiles the query into bytecode and returns an handle to it for a faster
   /// execution.
   /// Note: you can create the query at any time, but you can execute it only
   /// when the DB is open.
   Ref<SQLiteQuery> create_query(String p_query);
 
+  /// Prepares every query created by `create_query()` which isn't prepared
+  /// yet, rather than on their first execution. Returns false if any of
+  /// them failed.
+  bool prepare_all();
+
+  /// Executes every statement of `p_sql`, in one transaction unless
+  /// `p_transaction` is false. Returns false, with nothing changed, as soon
+  /// as a statement fails.
+  /// ```
+  /// db.execute_script(FileAccess.get_file_as_string("res://schema.sql"))
+  /// ```
+  bool execute_script(String p_sql, bool p_transaction = true);
+
+  /// Compiles a script of many statements to be run repeatedly, keeping its
+  /// statements prepared; see `execute_script()`.
+  Ref<SQLiteCompiledScript> compile_script(String p_sql);
+
+  /// Brings the database to the version `p_migrations.size()`, tracked by
+  /// `PRAGMA user_version`: the migration `i` upgrades from the version `i`
+  /// to `i + 1`. A migration is a SQL script, or a Callable called with this
+  /// database and returning false on failure.
+  /// ```
+  /// db.migrate([
+  ///     "CREATE TABLE players (id INTEGER PRIMARY KEY, name TEXT);",
+  ///     "ALTER TABLE players ADD COLUMN score INTEGER DEFAULT 0;",
+  /// ])
+  /// ```
+  /// The pending migrations run in one exclusive transaction, with the
+  /// foreign keys checked once at the end. In WAL mode the other connections
+  /// keep reading the previous version meanwhile. Returns the
+  /// `from_version`, the `version`, the `usec` taken and the `steps`
+  /// (`version` and `usec` of each migration), or an empty Dictionary on
+  /// failure, in which case the database is left unchanged.
+  ///
+  /// `p_disable_foreign_keys` turns `foreign_keys` off during the migrations,
+  /// for the table rebuilds which drop a referenced table. The foreign key
+  /// actions, like `ON DELETE CASCADE`, don't run then.
+  Dictionary migrate(Array p_migrations, bool p_disable_foreign_keys = false);
+
+  /// Starts an online backup of this database into `p_destination`, a path
+  /// or another open `SQLite`. Nothing is copied until the returned backup
+  /// is stepped, run, or started on a thread.
+  /// ```
+  /// var backup = db.backup_to("user://world_backup.db", 128)
+  /// # In _process():
+  /// if backup.step() != SQLiteBackup.STATUS_RUNNING:
+  ///     print("Backup finished")
+  /// ```
+  Ref<SQLiteBackup> backup_to(Variant p_destination,
+                              int p_pages_per_step = 64);
+
+  /// Replaces the content of this database by a copy of `p_source`, a path
+  /// or another open `SQLite`; for example to load a database from disk into
+  /// one opened with `open_in_memory()`.
+  Ref<SQLiteBackup> backup_from(Variant p_source, int p_pages_per_step = -1);
+
+  /// Selects how the changes are reported:
+  /// - `CHANGE_NOTIFICATIONS_ROWS`: `row_changed(table, operation, rowid)`
+  ///   for every committed change, followed by `committed`.
+  /// - `CHANGE_NOTIFICATIONS_COALESCED`: `table_changed(table, rowids)` once
+  ///   per changed table, then `committed`, at most once per frame.
+  /// The signals are deferred to the end of the frame: SQLite doesn't allow
+  /// to use the connection from within its hooks.
+  void set_change_notifications(ChangeNotifications p_mode);
+  ChangeNotifications get_change_notifications() const;
+
+  /// Creates a session recording the changes made to `p_database`; attach
+  /// the tables to record with `SQLiteSession.attach()`.
+  Ref<SQLiteSession> create_session(String p_database = "main");
+
+  /// Applies a changeset or patchset produced by a `SQLiteSession`.
+  /// On conflict `p_conflict_handler` is called as
+  /// `handler(conflict: ChangesetConflict, table: String, operation:
+  /// Operation)` and returns a `ChangesetAction`; without handler the whole
+  /// changeset is aborted.
+  bool apply_changeset(PackedByteArray p_changeset,
+                       Callable p_conflict_handler = Callable());
+
   bool query(String statement);
   bool query_with_args(String statement, Array args);
   Array fetch_array(String statement);
@@ -125,6 +600,76 @@ public:
   Array fetch_assoc(String statement);
   Array fetch_assoc_with_args(String statement, Array args);
 
+  /// Wraps `p_values`, a packed array, to be read as a table by `carray(?)`
+  /// when passed as an argument. Packed arrays are otherwise bound as BLOBs.
+  static Ref<SQLiteCArray> carray(const Variant &p_values);
+
+  /// Registers a scalar SQL function, implemented by `p_function`.
+  /// ```
+  /// db.create_function("double_it", func(x): return x * 2, 1, true)
+  /// db.fetch_array("SELECT double_it(price) FROM items;")
+  /// ```
+  /// `p_argc` is the number of arguments, or -1 for any. Deterministic
+  /// functions can be used in indexes and constant folded by the planner.
+  bool create_function(String p_name, Callable p_function, int p_argc = -1,
+                       bool p_deterministic = false);
+
+  /// Registers an aggregate SQL function: `p_step` is called per row as
+  /// `step(state, ...args)` and returns the new state (initially `null`),
+  /// `p_final` is called as `final(state)` and returns the result.
+  bool create_aggregate(String p_name, Callable p_step, Callable p_final,
+                        int p_argc = -1, bool p_deterministic = false);
+
+  /// Returns the `p_k` rows whose `p_column` vector (a BLOB of float32) is
+  /// the closest to `p_query`, as `[{ "rowid": int, "distance": float }]`.
+  /// Uses the IVF index built by `create_vector_index()` when there is one,
+  /// scanning the `p_probes` lists whose centroid is the closest by
+  /// `p_metric`; otherwise scans the whole table.
+  Array knn(String p_table, String p_column, PackedFloat32Array p_query,
+            int p_k, VectorMetric p_metric = VECTOR_METRIC_L2,
+            int p_probes = 8);
+
+  /// Clusters the vectors of `p_column` in `p_lists` lists, stored in the
+  /// `<table>_<column>_ivf_centroids` and `<table>_<column>_ivf_lists`
+  /// tables. Rows inserted afterwards are only found once it's rebuilt.
+  bool create_vector_index(String p_table, String p_column, int p_lists = 256,
+                           int p_iterations = 10);
+  bool drop_vector_index(String p_table, String p_column);
+
+  /// Returns the memory used by this connection: page cache, lookaside
+  /// buffers, schema and prepared statements, with the cache and lookaside
+  /// hit counts and the memory map. `p_reset` restarts the counters.
+  Dictionary get_memory_stats(bool p_reset = false) const;
+
+  /// Returns the memory used by SQLite for all the connections.
+  static Dictionary get_global_memory_stats();
+
+  /// Returns the pages, bytes, hits, misses and evictions of this connection
+  /// in the shared page cache (`sqlite/memory/shared_page_cache`).
+  Dictionary get_page_cache_stats() const;
+
+  /// Bytes of pages the shared page cache keeps for all the connections,
+  /// 0 for no limit. The least recently used pages are evicted first,
+  /// whatever their database.
+  static void set_shared_page_cache_budget(int64_t p_bytes);
+  static int64_t get_shared_page_cache_budget();
+  static Dictionary get_shared_page_cache_stats();
+
+  /// Bytes of results kept for the queries with `cache_results`, 8 MiB by
+  /// default. The least recently used results are evicted first.
+  void set_result_cache_budget(int64_t p_bytes);
+  int64_t get_result_cache_budget() const;
+  /// Returns the hits, misses, hit rate, invalidations, evictions, entries
+  /// and size of the result cache.
+  Dictionary get_result_cache_stats() const;
+  void clear_result_cache();
+
   String get_last_error_message() const;
 };
+
+VARIANT_ENUM_CAST(SQLite::Operation);
+VARIANT_ENUM_CAST(SQLite::ChangesetConflict);
+VARIANT_ENUM_CAST(SQLite::ChangesetAction);
+VARIANT_ENUM_CAST(SQLite::VectorMetric);
+VARIANT_ENUM_CAST(SQLite::ChangeNotifications);
 #endif
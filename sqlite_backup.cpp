@@ -0,0 +1,218 @@
+#include "sqlite_backup.h"
+
+#include "sqlite.h"
+
+#include "core/os/os.h"
+
+SQLiteBackup::SQLiteBackup() {
+  status.set(STATUS_FAILED);
+  remaining.set(-1);
+  page_count.set(-1);
+}
+
+SQLiteBackup::~SQLiteBackup() { finish(); }
+
+bool SQLiteBackup::init(const Ref<SQLite> &p_source,
+                        const Ref<SQLite> &p_destination,
+                        sqlite3 *p_source_handle,
+                        sqlite3 *p_destination_handle,
+                        sqlite3 *p_owned_connection, int p_pages_per_step) {
+  source = p_source;
+  destination = p_destination;
+  owned_connection = p_owned_connection;
+  pages_per_step = p_pages_per_step;
+  // Connections opened with `SQLITE_OPEN_NOMUTEX` have no mutex.
+  serialized = sqlite3_db_mutex(p_source_handle) != nullptr &&
+               sqlite3_db_mutex(p_destination_handle) != nullptr;
+
+  backup = sqlite3_backup_init(p_destination_handle, "main", p_source_handle,
+                               "main");
+  if (backup == nullptr) {
+    // The error is stored in the destination connection.
+    ERR_PRINT("Cannot start the backup: " +
+              String(sqlite3_errmsg(p_destination_handle)));
+    finish();
+    return false;
+  }
+  status.set(STATUS_RUNNING);
+  return true;
+}
+
+SQLiteBackup::Status SQLiteBackup::step() {
+  if (backup == nullptr) {
+    return Status(status.get());
+  }
+  ERR_FAIL_COND_V_MSG(thread.is_started() &&
+                          Thread::get_caller_id() != thread.get_id(),
+                      STATUS_RUNNING, "The backup is running on a thread.");
+
+  const int result = sqlite3_backup_step(backup, pages_per_step);
+  remaining.set(sqlite3_backup_remaining(backup));
+  page_count.set(sqlite3_backup_pagecount(backup));
+
+  switch (result) {
+  case SQLITE_OK:
+  case SQLITE_BUSY:
+  case SQLITE_LOCKED:
+    // More to copy, or the source is locked: try again on the next step.
+    return STATUS_RUNNING;
+  case SQLITE_DONE:
+    status.set(STATUS_DONE);
+    break;
+  default:
+    ERR_PRINT("The backup failed: " + String(sqlite3_errstr(result)));
+    status.set(STATUS_FAILED);
+    break;
+  }
+
+  // Finishing right away, rather than waiting for the owner, releases the
+  // locks held on both databases.
+  sqlite3_backup_finish(backup);
+  backup = nullptr;
+  return Status(status.get());
+}
+
+SQLiteBackup::Status SQLiteBackup::run(int p_busy_timeout_msec) {
+  ERR_FAIL_COND_V_MSG(thread.is_started(), Status(status.get()),
+                      "The backup is running on a thread.");
+  const int pages = pages_per_step;
+  // Copy everything at once.
+  pages_per_step = -1;
+  const uint64_t start = OS::get_singleton()->get_ticks_msec();
+  while (step() == STATUS_RUNNING) {
+    // The source is locked by another connection.
+    if (OS::get_singleton()->get_ticks_msec() - start >=
+        uint64_t(MAX(0, p_busy_timeout_msec))) {
+      sqlite3_backup_finish(backup);
+      backup = nullptr;
+      status.set(STATUS_FAILED);
+      ERR_PRINT("The backup failed: the source stayed locked for " +
+                itos(p_busy_timeout_msec) + " ms.");
+      break;
+    }
+    OS::get_singleton()->delay_usec(1000);
+  }
+  pages_per_step = pages;
+  return Status(status.get());
+}
+
+void SQLiteBackup::thread_func(void *p_self) {
+  SQLiteBackup *self = static_cast<SQLiteBackup *>(p_self);
+  while (!self->cancel_requested.is_set() && self->step() == STATUS_RUNNING) {
+    if (self->thread_step_delay_usec > 0) {
+      OS::get_singleton()->delay_usec(self->thread_step_delay_usec);
+    }
+  }
+  self->call_deferred(SNAME("_thread_finished"));
+}
+
+void SQLiteBackup::_thread_finished() {
+  if (thread.is_started()) {
+    thread.wait_to_finish();
+  }
+  emit_signal(SNAME("finished"), status.get() == STATUS_DONE);
+}
+
+bool SQLiteBackup::start_thread(int p_step_delay_usec) {
+  ERR_FAIL_COND_V_MSG(backup == nullptr, false, "The backup is finished.");
+  ERR_FAIL_COND_V_MSG(thread.is_started(), false,
+                      "The backup is already running on a thread.");
+  ERR_FAIL_COND_V_MSG(!serialized, false,
+                      "Cannot run the backup on a thread: a database was "
+                      "opened with `no_mutex`.");
+  thread_step_delay_usec = MAX(0, p_step_delay_usec);
+  cancel_requested.clear();
+  thread.start(thread_func, this);
+  return true;
+}
+
+bool SQLiteBackup::is_thread_running() const {
+  return thread.is_started() && status.get() == STATUS_RUNNING;
+}
+
+SQLiteBackup::Status SQLiteBackup::wait() {
+  if (thread.is_started()) {
+    thread.wait_to_finish();
+  }
+  return Status(status.get());
+}
+
+SQLiteBackup::Status SQLiteBackup::get_status() const {
+  return Status(status.get());
+}
+
+int SQLiteBackup::get_remaining() const { return remaining.get(); }
+
+int SQLiteBackup::get_page_count() const { return page_count.get(); }
+
+float SQLiteBackup::get_progress() const {
+  const int count = page_count.get();
+  if (status.get() == STATUS_DONE) {
+    return 1.0;
+  }
+  if (count <= 0) {
+    return 0.0;
+  }
+  return float(count - remaining.get()) / float(count);
+}
+
+void SQLiteBackup::set_pages_per_step(int p_pages) {
+  ERR_FAIL_COND_MSG(p_pages == 0, "Use -1 to copy all the pages at once.");
+  pages_per_step = p_pages;
+}
+
+int SQLiteBackup::get_pages_per_step() const { return pages_per_step; }
+
+void SQLiteBackup::finish() {
+  if (thread.is_started()) {
+    cancel_requested.set();
+    thread.wait_to_finish();
+  }
+  if (backup != nullptr) {
+    sqlite3_backup_finish(backup);
+    backup = nullptr;
+    if (status.get() == STATUS_RUNNING) {
+      // Interrupted.
+      status.set(STATUS_FAILED);
+    }
+  }
+  if (owned_connection != nullptr) {
+    sqlite3_close_v2(owned_connection);
+    owned_connection = nullptr;
+  }
+  source.unref();
+  destination.unref();
+}
+
+void SQLiteBackup::_bind_methods() {
+  ClassDB::bind_method(D_METHOD("step"), &SQLiteBackup::step);
+  ClassDB::bind_method(D_METHOD("run", "busy_timeout_msec"),
+                       &SQLiteBackup::run, DEFVAL(5000));
+  ClassDB::bind_method(D_METHOD("start_thread", "step_delay_usec"),
+                       &SQLiteBackup::start_thread, DEFVAL(0));
+  ClassDB::bind_method(D_METHOD("is_thread_running"),
+                       &SQLiteBackup::is_thread_running);
+  ClassDB::bind_method(D_METHOD("wait"), &SQLiteBackup::wait);
+  ClassDB::bind_method(D_METHOD("get_status"), &SQLiteBackup::get_status);
+  ClassDB::bind_method(D_METHOD("get_remaining"),
+                       &SQLiteBackup::get_remaining);
+  ClassDB::bind_method(D_METHOD("get_page_count"),
+                       &SQLiteBackup::get_page_count);
+  ClassDB::bind_method(D_METHOD("get_progress"), &SQLiteBackup::get_progress);
+  ClassDB::bind_method(D_METHOD("set_pages_per_step", "pages"),
+                       &SQLiteBackup::set_pages_per_step);
+  ClassDB::bind_method(D_METHOD("get_pages_per_step"),
+                       &SQLiteBackup::get_pages_per_step);
+  ClassDB::bind_method(D_METHOD("finish"), &SQLiteBackup::finish);
+  ClassDB::bind_method(D_METHOD("_thread_finished"),
+                       &SQLiteBackup::_thread_finished);
+
+  ADD_PROPERTY(PropertyInfo(Variant::INT, "pages_per_step"),
+               "set_pages_per_step", "get_pages_per_step");
+
+  ADD_SIGNAL(MethodInfo("finished", PropertyInfo(Variant::BOOL, "success")));
+
+  BIND_ENUM_CONSTANT(STATUS_RUNNING);
+  BIND_ENUM_CONSTANT(STATUS_DONE);
+  BIND_ENUM_CONSTANT(STATUS_FAILED);
+}
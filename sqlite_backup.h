@@ -0,0 +1,91 @@
+#ifndef GDSQLITE_BACKUP_H
+#define GDSQLITE_BACKUP_H
+
+#include "core/object/ref_counted.h"
+#include "core/os/thread.h"
+#include "core/templates/safe_refcount.h"
+
+#include "thirdparty/sqlite/sqlite3.h"
+
+class SQLite;
+
+/// Online backup of a database, copied a few pages at a time so it can be
+/// spread over many frames or run on a thread while the database is in use.
+class SQLiteBackup : public RefCounted {
+  GDCLASS(SQLiteBackup, RefCounted);
+
+public:
+  enum Status {
+    STATUS_RUNNING,
+    STATUS_DONE,
+    STATUS_FAILED,
+  };
+
+private:
+  // Keeps both ends alive until the backup is finished.
+  Ref<SQLite> source;
+  Ref<SQLite> destination;
+  // Connection opened by this backup, when an end was given as a path.
+  sqlite3 *owned_connection = nullptr;
+  sqlite3_backup *backup = nullptr;
+  // Both connections can be used from another thread: neither was opened
+  // with `no_mutex`.
+  bool serialized = false;
+
+  int pages_per_step = 64;
+  SafeNumeric<int> status;
+  SafeNumeric<int> remaining;
+  SafeNumeric<int> page_count;
+
+  Thread thread;
+  SafeFlag cancel_requested;
+  uint64_t thread_step_delay_usec = 0;
+
+  static void thread_func(void *p_self);
+  void _thread_finished();
+
+protected:
+  static void _bind_methods();
+
+public:
+  SQLiteBackup();
+  ~SQLiteBackup();
+
+  /// Takes the ownership of `p_owned_connection`, if any.
+  bool init(const Ref<SQLite> &p_source, const Ref<SQLite> &p_destination,
+            sqlite3 *p_source_handle, sqlite3 *p_destination_handle,
+            sqlite3 *p_owned_connection, int p_pages_per_step);
+
+  /// Copies the next `pages_per_step` pages. While the source is locked by
+  /// another connection the step does nothing and the backup keeps running.
+  Status step();
+
+  /// Copies everything that remains, blocking. Fails once the source stayed
+  /// locked by another connection for `p_busy_timeout_msec`.
+  Status run(int p_busy_timeout_msec = 5000);
+
+  /// Runs the backup on a thread, sleeping `p_step_delay_usec` between two
+  /// steps to leave the database available to the game. `finished` is
+  /// emitted once done. Refused when a connection was opened with
+  /// `no_mutex`, which can't be shared with a thread.
+  bool start_thread(int p_step_delay_usec = 0);
+  bool is_thread_running() const;
+  /// Waits for the thread started by `start_thread()`.
+  Status wait();
+
+  Status get_status() const;
+  int get_remaining() const;
+  int get_page_count() const;
+  float get_progress() const;
+
+  void set_pages_per_step(int p_pages);
+  int get_pages_per_step() const;
+
+  /// Releases the backup. Automatically called when done, on failure and
+  /// when any of the databases is closed.
+  void finish();
+};
+
+VARIANT_ENUM_CAST(SQLiteBackup::Status);
+
+#endif
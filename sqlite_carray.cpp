@@ -0,0 +1,268 @@
+#include "sqlite_carray.h"
+
+#include "core/error/error_macros.h"
+
+// Type tag used with `sqlite3_bind_pointer()`, so `carray` only accepts
+// pointers bound by this module.
+static const char *CARRAY_POINTER_TYPE = "godot_carray";
+
+enum {
+  CARRAY_COLUMN_VALUE = 0,
+  CARRAY_COLUMN_POINTER,
+};
+
+struct CArrayCursor {
+  sqlite3_vtab_cursor base;
+  Variant::Type type = Variant::NIL;
+  // Only the array matching `type` is set; they are ref counted, so holding
+  // them doesn't copy the data.
+  PackedInt32Array int32s;
+  PackedInt64Array int64s;
+  PackedFloat32Array float32s;
+  PackedFloat64Array float64s;
+  PackedStringArray strings;
+  int64_t index = 0;
+  int64_t count = 0;
+};
+
+static int carray_connect(sqlite3 *p_db, void *p_aux, int p_argc,
+                          const char *const *p_argv, sqlite3_vtab **r_vtab,
+                          char **r_err) {
+  const int res =
+      sqlite3_declare_vtab(p_db, "CREATE TABLE x(value, pointer HIDDEN)");
+  if (res != SQLITE_OK) {
+    return res;
+  }
+  sqlite3_vtab *vtab =
+      static_cast<sqlite3_vtab *>(sqlite3_malloc(sizeof(sqlite3_vtab)));
+  if (vtab == nullptr) {
+    return SQLITE_NOMEM;
+  }
+  memset(vtab, 0, sizeof(sqlite3_vtab));
+  sqlite3_vtab_config(p_db, SQLITE_VTAB_INNOCUOUS);
+  *r_vtab = vtab;
+  return SQLITE_OK;
+}
+
+static int carray_disconnect(sqlite3_vtab *p_vtab) {
+  sqlite3_free(p_vtab);
+  return SQLITE_OK;
+}
+
+static int carray_open(sqlite3_vtab *p_vtab, sqlite3_vtab_cursor **r_cursor) {
+  CArrayCursor *cursor = memnew(CArrayCursor);
+  memset(&cursor->base, 0, sizeof(sqlite3_vtab_cursor));
+  *r_cursor = &cursor->base;
+  return SQLITE_OK;
+}
+
+static int carray_close(sqlite3_vtab_cursor *p_cursor) {
+  memdelete(reinterpret_cast<CArrayCursor *>(p_cursor));
+  return SQLITE_OK;
+}
+
+static int carray_filter(sqlite3_vtab_cursor *p_cursor, int p_idx_num,
+                         const char *p_idx_str, int p_argc,
+                         sqlite3_value **p_argv) {
+  CArrayCursor *cursor = reinterpret_cast<CArrayCursor *>(p_cursor);
+  cursor->type = Variant::NIL;
+  cursor->index = 0;
+  cursor->count = 0;
+
+  if (p_idx_num == 0 || p_argc < 1) {
+    // Not bound: empty table.
+    return SQLITE_OK;
+  }
+
+  const Variant *array = static_cast<const Variant *>(
+      sqlite3_value_pointer(p_argv[0], CARRAY_POINTER_TYPE));
+  if (array == nullptr) {
+    return SQLITE_OK;
+  }
+
+  cursor->type = array->get_type();
+  switch (cursor->type) {
+  case Variant::PACKED_INT32_ARRAY:
+    cursor->int32s = *array;
+    cursor->count = cursor->int32s.size();
+    break;
+  case Variant::PACKED_INT64_ARRAY:
+    cursor->int64s = *array;
+    cursor->count = cursor->int64s.size();
+    break;
+  case Variant::PACKED_FLOAT32_ARRAY:
+    cursor->float32s = *array;
+    cursor->count = cursor->float32s.size();
+    break;
+  case Variant::PACKED_FLOAT64_ARRAY:
+    cursor->float64s = *array;
+    cursor->count = cursor->float64s.size();
+    break;
+  case Variant::PACKED_STRING_ARRAY:
+    cursor->strings = *array;
+    cursor->count = cursor->strings.size();
+    break;
+  default:
+    cursor->type = Variant::NIL;
+    break;
+  }
+  return SQLITE_OK;
+}
+
+static int carray_next(sqlite3_vtab_cursor *p_cursor) {
+  reinterpret_cast<CArrayCursor *>(p_cursor)->index += 1;
+  return SQLITE_OK;
+}
+
+static int carray_eof(sqlite3_vtab_cursor *p_cursor) {
+  const CArrayCursor *cursor = reinterpret_cast<CArrayCursor *>(p_cursor);
+  return cursor->index >= cursor->count;
+}
+
+static int carray_column(sqlite3_vtab_cursor *p_cursor, sqlite3_context *p_ctx,
+                         int p_column) {
+  const CArrayCursor *cursor = reinterpret_cast<CArrayCursor *>(p_cursor);
+  if (p_column != CARRAY_COLUMN_VALUE) {
+    // The hidden pointer column is never read back.
+    sqlite3_result_null(p_ctx);
+    return SQLITE_OK;
+  }
+
+  const int64_t i = cursor->index;
+  switch (cursor->type) {
+  case Variant::PACKED_INT32_ARRAY:
+    sqlite3_result_int64(p_ctx, cursor->int32s[i]);
+    break;
+  case Variant::PACKED_INT64_ARRAY:
+    sqlite3_result_int64(p_ctx, cursor->int64s[i]);
+    break;
+  case Variant::PACKED_FLOAT32_ARRAY:
+    sqlite3_result_double(p_ctx, cursor->float32s[i]);
+    break;
+  case Variant::PACKED_FLOAT64_ARRAY:
+    sqlite3_result_double(p_ctx, cursor->float64s[i]);
+    break;
+  case Variant::PACKED_STRING_ARRAY: {
+    const CharString utf8 = cursor->strings[i].utf8();
+    sqlite3_result_text(p_ctx, utf8.get_data(), utf8.length(),
+                        SQLITE_TRANSIENT);
+  } break;
+  default:
+    sqlite3_result_null(p_ctx);
+    break;
+  }
+  return SQLITE_OK;
+}
+
+static int carray_rowid(sqlite3_vtab_cursor *p_cursor, sqlite3_int64 *r_rowid) {
+  *r_rowid = reinterpret_cast<CArrayCursor *>(p_cursor)->index + 1;
+  return SQLITE_OK;
+}
+
+static int carray_best_index(sqlite3_vtab *p_vtab,
+                             sqlite3_index_info *p_info) {
+  int pointer_constraint = -1;
+  bool unusable = false;
+  for (int i = 0; i < p_info->nConstraint; i++) {
+    const sqlite3_index_info::sqlite3_index_constraint &c =
+        p_info->aConstraint[i];
+    if (c.iColumn != CARRAY_COLUMN_POINTER ||
+        c.op != SQLITE_INDEX_CONSTRAINT_EQ) {
+      continue;
+    }
+    if (!c.usable) {
+      unusable = true;
+      continue;
+    }
+    pointer_constraint = i;
+    break;
+  }
+
+  if (pointer_constraint >= 0) {
+    p_info->aConstraintUsage[pointer_constraint].argvIndex = 1;
+    p_info->aConstraintUsage[pointer_constraint].omit = 1;
+    p_info->estimatedCost = 1.0;
+    p_info->estimatedRows = 100;
+    p_info->idxNum = 1;
+  } else if (unusable) {
+    // Ask the planner for another plan where the array is known.
+    return SQLITE_CONSTRAINT;
+  } else {
+    p_info->estimatedCost = 2147483647.0;
+    p_info->estimatedRows = 2147483647;
+    p_info->idxNum = 0;
+  }
+  return SQLITE_OK;
+}
+
+static sqlite3_module carray_module = {
+    0,                 // iVersion
+    nullptr,           // xCreate: eponymous only.
+    carray_connect,    // xConnect
+    carray_best_index, // xBestIndex
+    carray_disconnect, // xDisconnect
+    nullptr,           // xDestroy
+    carray_open,       // xOpen
+    carray_close,      // xClose
+    carray_filter,     // xFilter
+    carray_next,       // xNext
+    carray_eof,        // xEof
+    carray_column,     // xColumn
+    carray_rowid,      // xRowid
+    nullptr,           // xUpdate
+    nullptr,           // xBegin
+    nullptr,           // xSync
+    nullptr,           // xCommit
+    nullptr,           // xRollback
+    nullptr,           // xFindMethod
+    nullptr,           // xRename
+    nullptr,           // xSavepoint
+    nullptr,           // xRelease
+    nullptr,           // xRollbackTo
+    nullptr,           // xShadowName
+};
+
+bool sqlite_register_carray(sqlite3 *p_db) {
+  const int res = sqlite3_create_module_v2(p_db, "carray", &carray_module,
+                                           nullptr, nullptr);
+  ERR_FAIL_COND_V_MSG(res != SQLITE_OK, false,
+                      "Cannot register the `carray` table-valued function.");
+  return true;
+}
+
+static void carray_pointer_free(void *p_ptr) {
+  memdelete(static_cast<Variant *>(p_ptr));
+}
+
+int sqlite_bind_carray(sqlite3_stmt *p_stmt, int p_index,
+                       const SQLiteCArray *p_array) {
+  // SQLite owns this copy until the parameter is rebound or the statement
+  // finalized; it references the same packed data as `p_array`.
+  return sqlite3_bind_pointer(p_stmt, p_index,
+                              memnew(Variant(p_array->get_values())),
+                              CARRAY_POINTER_TYPE, carray_pointer_free);
+}
+
+void SQLiteCArray::set_values(const Variant &p_values) {
+  switch (p_values.get_type()) {
+  case Variant::PACKED_INT32_ARRAY:
+  case Variant::PACKED_INT64_ARRAY:
+  case Variant::PACKED_FLOAT32_ARRAY:
+  case Variant::PACKED_FLOAT64_ARRAY:
+  case Variant::PACKED_STRING_ARRAY:
+    values = p_values;
+    break;
+  default:
+    ERR_FAIL_MSG("carray() only reads packed arrays of ints, floats and "
+                 "strings, not " +
+                 Variant::get_type_name(p_values.get_type()) + ".");
+  }
+}
+
+Variant SQLiteCArray::get_values() const { return values; }
+
+void SQLiteCArray::_bind_methods() {
+  ClassDB::bind_method(D_METHOD("set_values", "values"),
+                       &SQLiteCArray::set_values);
+  ClassDB::bind_method(D_METHOD("get_values"), &SQLiteCArray::get_values);
+}
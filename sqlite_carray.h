@@ -0,0 +1,38 @@
+#ifndef GDSQLITE_CARRAY_H
+#define GDSQLITE_CARRAY_H
+
+#include "core/object/ref_counted.h"
+#include "core/variant/variant.h"
+
+#include "thirdparty/sqlite/sqlite3.h"
+
+/// A packed array to bind as a query parameter read by `carray(?)`. Packed
+/// arrays passed directly are bound as BLOBs instead, to be stored.
+class SQLiteCArray : public RefCounted {
+  GDCLASS(SQLiteCArray, RefCounted);
+
+  Variant values;
+
+protected:
+  static void _bind_methods();
+
+public:
+  /// Accepts the packed arrays of ints, floats and strings.
+  void set_values(const Variant &p_values);
+  Variant get_values() const;
+};
+
+/// Registers the `carray` table-valued function, which exposes a packed array
+/// bound as a query parameter as a one column table:
+/// ```
+/// db.fetch_array_with_args("SELECT * FROM items WHERE id IN carray(?);",
+///                          [SQLite.carray(PackedInt64Array(ids))])
+/// ```
+bool sqlite_register_carray(sqlite3 *p_db);
+
+/// Binds the array of a `SQLiteCArray` to a statement parameter, to be
+/// consumed by `carray(?)`. The array is shared, not copied.
+int sqlite_bind_carray(sqlite3_stmt *p_stmt, int p_index,
+                       const SQLiteCArray *p_array);
+
+#endif
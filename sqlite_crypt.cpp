@@ -0,0 +1,466 @@
+#include "sqlite_crypt.h"
+
+#include "core/crypto/crypto_core.h"
+#include "core/io/marshalls.h"
+#include "core/os/mutex.h"
+#include "core/templates/hash_map.h"
+#include "core/templates/local_vector.h"
+
+#include "thirdparty/sqlite/spmemvfs.h"
+
+// Distinct counters for the files of a database: a page stored in the
+// journal must not be encrypted with the keystream of the database itself.
+enum {
+  CRYPT_NONCE_NONE = 0,
+  CRYPT_NONCE_MAIN_DB,
+  CRYPT_NONCE_MAIN_JOURNAL,
+  CRYPT_NONCE_WAL,
+};
+
+struct CryptKey {
+  PackedByteArray key;
+  // Number of connections using it.
+  int users = 0;
+};
+
+static Mutex keys_mutex;
+static HashMap<String, CryptKey> keys;
+
+static sqlite3_vfs crypt_vfs;
+static sqlite3_vfs crypt_memory_vfs;
+
+struct CryptFile {
+  // First member: SQLite only sees this part.
+  sqlite3_file base;
+  // File of the underlying VFS, stored right after this struct.
+  sqlite3_file *real = nullptr;
+  // Null for the files that aren't encrypted: temporary files and super
+  // journals, which only hold file names.
+  CryptoCore::AESContext *aes = nullptr;
+  uint64_t nonce = CRYPT_NONCE_NONE;
+  LocalVector<uint8_t> write_buffer;
+
+  ~CryptFile() {
+    if (aes != nullptr) {
+      memdelete(aes);
+    }
+  }
+};
+
+// AES-CTR: XORs `p_data`, at `p_offset` in the file, with the keystream.
+static void crypt_apply(CryptFile *p_file, uint8_t *p_data, int64_t p_size,
+                        int64_t p_offset) {
+  uint8_t counter[16];
+  uint8_t keystream[16];
+  encode_uint64(p_file->nonce, counter);
+
+  int64_t block = p_offset / 16;
+  int64_t skip = p_offset % 16;
+  int64_t done = 0;
+  while (done < p_size) {
+    encode_uint64(block, counter + 8);
+    p_file->aes->encrypt_ecb(counter, keystream);
+    for (int64_t i = skip; i < 16 && done < p_size; i += 1) {
+      p_data[done] ^= keystream[i];
+      done += 1;
+    }
+    skip = 0;
+    block += 1;
+  }
+}
+
+static sqlite3_file *real_file(sqlite3_file *p_file) {
+  return reinterpret_cast<CryptFile *>(p_file)->real;
+}
+
+static int crypt_close(sqlite3_file *p_file) {
+  CryptFile *file = reinterpret_cast<CryptFile *>(p_file);
+  const int result = file->real->pMethods->xClose(file->real);
+  file->~CryptFile();
+  return result;
+}
+
+static int crypt_read(sqlite3_file *p_file, void *p_buffer, int p_amount,
+                      sqlite3_int64 p_offset) {
+  CryptFile *file = reinterpret_cast<CryptFile *>(p_file);
+  const int result =
+      file->real->pMethods->xRead(file->real, p_buffer, p_amount, p_offset);
+  if (file->aes == nullptr) {
+    return result;
+  }
+
+  int64_t size = p_amount;
+  if (result == SQLITE_IOERR_SHORT_READ) {
+    // The part past the end of the file is zeroed, and must stay so.
+    sqlite3_int64 file_size = 0;
+    file->real->pMethods->xFileSize(file->real, &file_size);
+    size = CLAMP(file_size - p_offset, 0, int64_t(p_amount));
+  } else if (result != SQLITE_OK) {
+    return result;
+  }
+  crypt_apply(file, static_cast<uint8_t *>(p_buffer), size, p_offset);
+  return result;
+}
+
+static int crypt_write(sqlite3_file *p_file, const void *p_buffer,
+                       int p_amount, sqlite3_int64 p_offset) {
+  CryptFile *file = reinterpret_cast<CryptFile *>(p_file);
+  if (file->aes == nullptr) {
+    return file->real->pMethods->xWrite(file->real, p_buffer, p_amount,
+                                        p_offset);
+  }
+  file->write_buffer.resize(p_amount);
+  memcpy(file->write_buffer.ptr(), p_buffer, p_amount);
+  crypt_apply(file, file->write_buffer.ptr(), p_amount, p_offset);
+  return file->real->pMethods->xWrite(file->real, file->write_buffer.ptr(),
+                                      p_amount, p_offset);
+}
+
+static int crypt_truncate(sqlite3_file *p_file, sqlite3_int64 p_size) {
+  sqlite3_file *real = real_file(p_file);
+  return real->pMethods->xTruncate(real, p_size);
+}
+
+static int crypt_sync(sqlite3_file *p_file, int p_flags) {
+  sqlite3_file *real = real_file(p_file);
+  return real->pMethods->xSync(real, p_flags);
+}
+
+static int crypt_file_size(sqlite3_file *p_file, sqlite3_int64 *r_size) {
+  sqlite3_file *real = real_file(p_file);
+  return real->pMethods->xFileSize(real, r_size);
+}
+
+static int crypt_lock(sqlite3_file *p_file, int p_lock) {
+  sqlite3_file *real = real_file(p_file);
+  return real->pMethods->xLock(real, p_lock);
+}
+
+static int crypt_unlock(sqlite3_file *p_file, int p_lock) {
+  sqlite3_file *real = real_file(p_file);
+  return real->pMethods->xUnlock(real, p_lock);
+}
+
+static int crypt_check_reserved_lock(sqlite3_file *p_file, int *r_reserved) {
+  sqlite3_file *real = real_file(p_file);
+  return real->pMethods->xCheckReservedLock(real, r_reserved);
+}
+
+static int crypt_file_control(sqlite3_file *p_file, int p_op, void *p_arg) {
+  if (p_op == SQLITE_FCNTL_MMAP_SIZE) {
+    // Never mapped, see `crypt_fetch()`: the limit of the real file doesn't
+    // apply, and `PRAGMA mmap_size` reads 0.
+    *static_cast<sqlite3_int64 *>(p_arg) = 0;
+    return SQLITE_OK;
+  }
+  sqlite3_file *real = real_file(p_file);
+  return real->pMethods->xFileControl(real, p_op, p_arg);
+}
+
+static int crypt_sector_size(sqlite3_file *p_file) {
+  sqlite3_file *real = real_file(p_file);
+  return real->pMethods->xSectorSize(real);
+}
+
+static int crypt_device_characteristics(sqlite3_file *p_file) {
+  sqlite3_file *real = real_file(p_file);
+  return real->pMethods->xDeviceCharacteristics(real);
+}
+
+// The WAL index only holds page numbers and checksums: it's shared as is.
+static int crypt_shm_map(sqlite3_file *p_file, int p_page, int p_page_size,
+                         int p_extend, void volatile **r_memory) {
+  sqlite3_file *real = real_file(p_file);
+  return real->pMethods->xShmMap(real, p_page, p_page_size, p_extend,
+                                 r_memory);
+}
+
+static int crypt_shm_lock(sqlite3_file *p_file, int p_offset, int p_count,
+                          int p_flags) {
+  sqlite3_file *real = real_file(p_file);
+  return real->pMethods->xShmLock(real, p_offset, p_count, p_flags);
+}
+
+static void crypt_shm_barrier(sqlite3_file *p_file) {
+  sqlite3_file *real = real_file(p_file);
+  real->pMethods->xShmBarrier(real);
+}
+
+static int crypt_shm_unmap(sqlite3_file *p_file, int p_delete) {
+  sqlite3_file *real = real_file(p_file);
+  return real->pMethods->xShmUnmap(real, p_delete);
+}
+
+// A memory map would expose the encrypted pages: SQLite reads them instead.
+static int crypt_fetch(sqlite3_file *p_file, sqlite3_int64 p_offset,
+                       int p_amount, void **r_pointer) {
+  *r_pointer = nullptr;
+  return SQLITE_OK;
+}
+
+static int crypt_unfetch(sqlite3_file *p_file, sqlite3_int64 p_offset,
+                         void *p_pointer) {
+  return SQLITE_OK;
+}
+
+static const sqlite3_io_methods crypt_methods = {
+    3,                            // iVersion
+    crypt_close,                  // xClose
+    crypt_read,                   // xRead
+    crypt_write,                  // xWrite
+    crypt_truncate,               // xTruncate
+    crypt_sync,                   // xSync
+    crypt_file_size,              // xFileSize
+    crypt_lock,                   // xLock
+    crypt_unlock,                 // xUnlock
+    crypt_check_reserved_lock,    // xCheckReservedLock
+    crypt_file_control,           // xFileControl
+    crypt_sector_size,            // xSectorSize
+    crypt_device_characteristics, // xDeviceCharacteristics
+    crypt_shm_map,                // xShmMap
+    crypt_shm_lock,               // xShmLock
+    crypt_shm_barrier,            // xShmBarrier
+    crypt_shm_unmap,              // xShmUnmap
+    crypt_fetch,                  // xFetch
+    crypt_unfetch,                // xUnfetch
+};
+
+// For the files without shared memory, like the ones of spmemvfs.
+static const sqlite3_io_methods crypt_methods_v1 = {
+    1,                            // iVersion
+    crypt_close,                  // xClose
+    crypt_read,                   // xRead
+    crypt_write,                  // xWrite
+    crypt_truncate,               // xTruncate
+    crypt_sync,                   // xSync
+    crypt_file_size,              // xFileSize
+    crypt_lock,                   // xLock
+    crypt_unlock,                 // xUnlock
+    crypt_check_reserved_lock,    // xCheckReservedLock
+    crypt_file_control,           // xFileControl
+    crypt_sector_size,            // xSectorSize
+    crypt_device_characteristics, // xDeviceCharacteristics
+    nullptr,                      // xShmMap
+    nullptr,                      // xShmLock
+    nullptr,                      // xShmBarrier
+    nullptr,                      // xShmUnmap
+    nullptr,                      // xFetch
+    nullptr,                      // xUnfetch
+};
+
+static int crypt_open(sqlite3_vfs *p_vfs, const char *p_name,
+                      sqlite3_file *r_file, int p_flags, int *r_out_flags) {
+  sqlite3_vfs *parent = static_cast<sqlite3_vfs *>(p_vfs->pAppData);
+  CryptFile *file = memnew_placement(r_file, CryptFile);
+  file->real = reinterpret_cast<sqlite3_file *>(file + 1);
+
+  const int result =
+      parent->xOpen(parent, p_name, file->real, p_flags, r_out_flags);
+  if (result != SQLITE_OK) {
+    if (file->real->pMethods != nullptr) {
+      file->real->pMethods->xClose(file->real);
+    }
+    file->~CryptFile();
+    // SQLite calls xClose only when the open succeeds.
+    r_file->pMethods = nullptr;
+    return result;
+  }
+
+  // Temporary files have no name, and aren't encrypted: `open_encrypted()`
+  // keeps them in memory.
+  const char *database = nullptr;
+  if (p_name != nullptr) {
+    if (p_flags & SQLITE_OPEN_MAIN_DB) {
+      file->nonce = CRYPT_NONCE_MAIN_DB;
+      database = p_name;
+    } else if (p_flags & SQLITE_OPEN_MAIN_JOURNAL) {
+      file->nonce = CRYPT_NONCE_MAIN_JOURNAL;
+      database = sqlite3_filename_database(p_name);
+    } else if (p_flags & SQLITE_OPEN_WAL) {
+      file->nonce = CRYPT_NONCE_WAL;
+      database = sqlite3_filename_database(p_name);
+    }
+  }
+
+  if (database != nullptr) {
+    {
+      MutexLock lock(keys_mutex);
+      const CryptKey *key = keys.getptr(String::utf8(database));
+      if (key != nullptr) {
+        file->aes = memnew(CryptoCore::AESContext);
+        file->aes->set_encode_key(key->key.ptr(), key->key.size() * 8);
+      }
+    }
+    if (file->aes == nullptr) {
+      // The file would be read and written in clear, for example a database
+      // attached to an encrypted one.
+      ERR_PRINT("Cannot open `" + String::utf8(p_name) +
+                "`: no encryption key is registered for it.");
+      file->real->pMethods->xClose(file->real);
+      file->~CryptFile();
+      r_file->pMethods = nullptr;
+      return SQLITE_CANTOPEN;
+    }
+  }
+
+  file->base.pMethods = file->real->pMethods->iVersion >= 3
+                            ? &crypt_methods
+                            : &crypt_methods_v1;
+  return SQLITE_OK;
+}
+
+static int crypt_delete(sqlite3_vfs *p_vfs, const char *p_name, int p_sync) {
+  sqlite3_vfs *parent = static_cast<sqlite3_vfs *>(p_vfs->pAppData);
+  return parent->xDelete(parent, p_name, p_sync);
+}
+
+static int crypt_access(sqlite3_vfs *p_vfs, const char *p_name, int p_flags,
+                        int *r_result) {
+  sqlite3_vfs *parent = static_cast<sqlite3_vfs *>(p_vfs->pAppData);
+  return parent->xAccess(parent, p_name, p_flags, r_result);
+}
+
+static int crypt_full_pathname(sqlite3_vfs *p_vfs, const char *p_name,
+                               int p_size, char *r_name) {
+  sqlite3_vfs *parent = static_cast<sqlite3_vfs *>(p_vfs->pAppData);
+  return parent->xFullPathname(parent, p_name, p_size, r_name);
+}
+
+static void *crypt_dl_open(sqlite3_vfs *p_vfs, const char *p_name) {
+  sqlite3_vfs *parent = static_cast<sqlite3_vfs *>(p_vfs->pAppData);
+  return parent->xDlOpen(parent, p_name);
+}
+
+static void crypt_dl_error(sqlite3_vfs *p_vfs, int p_size, char *r_error) {
+  sqlite3_vfs *parent = static_cast<sqlite3_vfs *>(p_vfs->pAppData);
+  parent->xDlError(parent, p_size, r_error);
+}
+
+static void (*crypt_dl_sym(sqlite3_vfs *p_vfs, void *p_handle,
+                           const char *p_symbol))(void) {
+  sqlite3_vfs *parent = static_cast<sqlite3_vfs *>(p_vfs->pAppData);
+  return parent->xDlSym(parent, p_handle, p_symbol);
+}
+
+static void crypt_dl_close(sqlite3_vfs *p_vfs, void *p_handle) {
+  sqlite3_vfs *parent = static_cast<sqlite3_vfs *>(p_vfs->pAppData);
+  parent->xDlClose(parent, p_handle);
+}
+
+static int crypt_randomness(sqlite3_vfs *p_vfs, int p_size, char *r_buffer) {
+  sqlite3_vfs *parent = static_cast<sqlite3_vfs *>(p_vfs->pAppData);
+  return parent->xRandomness(parent, p_size, r_buffer);
+}
+
+static int crypt_sleep(sqlite3_vfs *p_vfs, int p_microseconds) {
+  sqlite3_vfs *parent = static_cast<sqlite3_vfs *>(p_vfs->pAppData);
+  return parent->xSleep(parent, p_microseconds);
+}
+
+static int crypt_current_time(sqlite3_vfs *p_vfs, double *r_time) {
+  sqlite3_vfs *parent = static_cast<sqlite3_vfs *>(p_vfs->pAppData);
+  return parent->xCurrentTime(parent, r_time);
+}
+
+static int crypt_get_last_error(sqlite3_vfs *p_vfs, int p_size,
+                                char *r_error) {
+  sqlite3_vfs *parent = static_cast<sqlite3_vfs *>(p_vfs->pAppData);
+  return parent->xGetLastError(parent, p_size, r_error);
+}
+
+static int crypt_current_time_int64(sqlite3_vfs *p_vfs,
+                                    sqlite3_int64 *r_time) {
+  sqlite3_vfs *parent = static_cast<sqlite3_vfs *>(p_vfs->pAppData);
+  return parent->xCurrentTimeInt64(parent, r_time);
+}
+
+static void crypt_init_vfs(sqlite3_vfs &r_vfs, const char *p_name,
+                           sqlite3_vfs *p_parent) {
+  memset(&r_vfs, 0, sizeof(r_vfs));
+  r_vfs.iVersion = MIN(p_parent->iVersion, 2);
+  r_vfs.szOsFile = sizeof(CryptFile) + p_parent->szOsFile;
+  r_vfs.mxPathname = p_parent->mxPathname;
+  r_vfs.zName = p_name;
+  r_vfs.pAppData = p_parent;
+  r_vfs.xOpen = crypt_open;
+  r_vfs.xDelete = crypt_delete;
+  r_vfs.xAccess = crypt_access;
+  r_vfs.xFullPathname = crypt_full_pathname;
+  r_vfs.xDlOpen = crypt_dl_open;
+  r_vfs.xDlError = crypt_dl_error;
+  r_vfs.xDlSym = crypt_dl_sym;
+  r_vfs.xDlClose = crypt_dl_close;
+  r_vfs.xRandomness = crypt_randomness;
+  r_vfs.xSleep = crypt_sleep;
+  r_vfs.xCurrentTime = crypt_current_time;
+  if (p_parent->xGetLastError != nullptr) {
+    r_vfs.xGetLastError = crypt_get_last_error;
+  }
+  if (r_vfs.iVersion >= 2) {
+    r_vfs.xCurrentTimeInt64 = crypt_current_time_int64;
+  }
+}
+
+void sqlite_crypt_initialize() {
+  sqlite3_vfs *parent = sqlite3_vfs_find(nullptr);
+  ERR_FAIL_COND_MSG(parent == nullptr, "SQLite has no default VFS.");
+  crypt_init_vfs(crypt_vfs, SQLITE_CRYPT_NAME, parent);
+  sqlite3_vfs_register(&crypt_vfs, 0);
+}
+
+bool sqlite_crypt_initialize_memory() {
+  MutexLock lock(keys_mutex);
+  if (crypt_memory_vfs.zName != nullptr) {
+    return true;
+  }
+  sqlite3_vfs *parent = sqlite3_vfs_find(SPMEMVFS_NAME);
+  ERR_FAIL_COND_V_MSG(parent == nullptr, false,
+                      "spmemvfs must be registered first.");
+  crypt_init_vfs(crypt_memory_vfs, SQLITE_CRYPT_MEMORY_NAME, parent);
+  return sqlite3_vfs_register(&crypt_memory_vfs, 0) == SQLITE_OK;
+}
+
+String sqlite_crypt_add_key(const char *p_vfs, const String &p_path,
+                            const PackedByteArray &p_key) {
+  ERR_FAIL_COND_V_MSG(p_key.size() != 16 && p_key.size() != 24 &&
+                          p_key.size() != 32,
+                      String(),
+                      "The encryption key must be 16, 24 or 32 bytes long.");
+  sqlite3_vfs *vfs = sqlite3_vfs_find(p_vfs);
+  ERR_FAIL_COND_V(vfs == nullptr, String());
+
+  // The name SQLite gives to the file when opening it.
+  LocalVector<char> full_path;
+  full_path.resize(vfs->mxPathname + 1);
+  const int result = vfs->xFullPathname(vfs, p_path.utf8().get_data(),
+                                        full_path.size(), full_path.ptr());
+  ERR_FAIL_COND_V(result != SQLITE_OK, String());
+  const String name = String::utf8(full_path.ptr());
+
+  MutexLock lock(keys_mutex);
+  CryptKey *key = keys.getptr(name);
+  if (key != nullptr) {
+    const bool same_key = key->key.size() == p_key.size() &&
+                          memcmp(key->key.ptr(), p_key.ptr(), p_key.size()) ==
+                              0;
+    ERR_FAIL_COND_V_MSG(!same_key, String(),
+                        "This database is already open with another key.");
+    key->users += 1;
+    return name;
+  }
+  CryptKey new_key;
+  new_key.key = p_key;
+  new_key.users = 1;
+  keys.insert(name, new_key);
+  return name;
+}
+
+void sqlite_crypt_remove_key(const String &p_name) {
+  MutexLock lock(keys_mutex);
+  CryptKey *key = keys.getptr(p_name);
+  ERR_FAIL_COND(key == nullptr);
+  key->users -= 1;
+  if (key->users == 0) {
+    keys.erase(p_name);
+  }
+}
@@ -0,0 +1,32 @@
+#ifndef GDSQLITE_CRYPT_H
+#define GDSQLITE_CRYPT_H
+
+#include "core/string/ustring.h"
+#include "core/variant/variant.h"
+
+#include "thirdparty/sqlite/sqlite3.h"
+
+/// Encryption shim over the default VFS, for database files.
+#define SQLITE_CRYPT_NAME "godot_crypt"
+/// Encryption shim over spmemvfs, for databases read from memory.
+#define SQLITE_CRYPT_MEMORY_NAME "godot_crypt_memory"
+
+/// Registers `SQLITE_CRYPT_NAME`. The database, its rollback journal and its
+/// WAL are encrypted with AES-CTR, and can't be opened without their key.
+/// The counter of each 16 bytes block is derived from its position in the
+/// file, so every page can be read and written on its own: a rewritten page
+/// reuses its keystream, and nothing is authenticated.
+void sqlite_crypt_initialize();
+
+/// Registers `SQLITE_CRYPT_MEMORY_NAME`, once spmemvfs is registered.
+bool sqlite_crypt_initialize_memory();
+
+/// Registers the key of the database `p_path`, opened through `p_vfs`, and
+/// returns its name for `sqlite_crypt_remove_key()`, or an empty String if
+/// the key is invalid or another key is in use for this database.
+String sqlite_crypt_add_key(const char *p_vfs, const String &p_path,
+                            const PackedByteArray &p_key);
+
+void sqlite_crypt_remove_key(const String &p_name);
+
+#endif
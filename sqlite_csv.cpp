@@ -0,0 +1,476 @@
+#include "sqlite_csv.h"
+
+#include "core/crypto/crypto_core.h"
+#include "core/os/os.h"
+
+// Flushed to the file once this big.
+static const uint32_t EXPORT_BUFFER_SIZE = 64 * 1024;
+
+bool sqlite_csv_parse_options(const Dictionary &p_options,
+                              SQLiteCSVOptions &r_options) {
+  r_options.threads = MAX(1, OS::get_singleton()->get_processor_count() - 1);
+
+  const Array keys = p_options.keys();
+  for (int i = 0; i < keys.size(); i += 1) {
+    const String key = keys[i];
+    const Variant &value = p_options[keys[i]];
+    if (key == "delimiter") {
+      const String delimiter = value;
+      ERR_FAIL_COND_V_MSG(delimiter.length() != 1 || delimiter[0] > 127 ||
+                              delimiter[0] == '"' || delimiter[0] == '\n' ||
+                              delimiter[0] == '\r',
+                          false,
+                          "The `delimiter` option must be one ASCII "
+                          "character.");
+      r_options.delimiter = delimiter[0];
+    } else if (key == "header") {
+      r_options.header = value;
+    } else if (key == "columns") {
+      r_options.columns = value;
+    } else if (key == "create_table") {
+      r_options.create_table = value;
+    } else if (key == "infer_types") {
+      r_options.infer_types = value;
+    } else if (key == "threads") {
+      ERR_FAIL_COND_V_MSG(int(value) < 1, false,
+                          "The `threads` option must be at least 1.");
+      r_options.threads = value;
+    } else if (key == "chunk_size") {
+      ERR_FAIL_COND_V_MSG(int(value) < 4096, false,
+                          "The `chunk_size` option must be at least 4096.");
+      r_options.chunk_size = value;
+    } else {
+      ERR_FAIL_V_MSG(false, "Unknown CSV option: " + key);
+    }
+  }
+  return true;
+}
+
+// Reads `p_text` as an INTEGER or a REAL, as SQLite would write them.
+static bool parse_number(const char *p_text, uint32_t p_length,
+                         SQLiteCSVCell &r_cell) {
+  if (p_length == 0 || p_length > 64) {
+    return false;
+  }
+  uint32_t i = 0;
+  if (p_text[i] == '-' || p_text[i] == '+') {
+    i++;
+  }
+  const uint32_t digits_begin = i;
+  bool overflow = false;
+  uint64_t integer = 0;
+  for (; i < p_length && is_digit(p_text[i]); i++) {
+    const uint64_t digit = p_text[i] - '0';
+    overflow = overflow || integer > (UINT64_MAX - digit) / 10;
+    integer = integer * 10 + digit;
+  }
+  const uint32_t digit_count = i - digits_begin;
+  if (i == p_length && digit_count > 0) {
+    const bool negative = p_text[0] == '-';
+    if (!overflow && integer <= uint64_t(INT64_MAX) + (negative ? 1 : 0)) {
+      r_cell.type = SQLITE_INTEGER;
+      r_cell.integer = negative ? int64_t(0 - integer) : int64_t(integer);
+      return true;
+    }
+  }
+
+  // A real: digits, an optional fraction and an optional exponent.
+  uint32_t fraction_count = 0;
+  if (i < p_length && p_text[i] == '.') {
+    for (i++; i < p_length && is_digit(p_text[i]); i++) {
+      fraction_count++;
+    }
+  }
+  if (digit_count == 0 && fraction_count == 0) {
+    return false;
+  }
+  if (i < p_length && (p_text[i] == 'e' || p_text[i] == 'E')) {
+    i++;
+    if (i < p_length && (p_text[i] == '-' || p_text[i] == '+')) {
+      i++;
+    }
+    const uint32_t exponent_begin = i;
+    while (i < p_length && is_digit(p_text[i])) {
+      i++;
+    }
+    if (i == exponent_begin) {
+      return false;
+    }
+  }
+  if (i != p_length) {
+    return false;
+  }
+  char copy[65];
+  memcpy(copy, p_text, p_length);
+  copy[p_length] = '\0';
+  r_cell.type = SQLITE_FLOAT;
+  r_cell.real = String::to_float(copy);
+  return true;
+}
+
+static void write_bytes(LocalVector<uint8_t> &r_buffer, const void *p_data,
+                        uint32_t p_size) {
+  const uint32_t offset = r_buffer.size();
+  r_buffer.resize(offset + p_size);
+  memcpy(r_buffer.ptr() + offset, p_data, p_size);
+}
+
+static void write_field(LocalVector<uint8_t> &r_buffer, const char *p_text,
+                        int p_size, char p_delimiter, bool p_quote) {
+  bool quote = p_quote;
+  for (int i = 0; i < p_size && !quote; i++) {
+    const char c = p_text[i];
+    quote = c == '"' || c == '\n' || c == '\r' || c == p_delimiter;
+  }
+  if (!quote) {
+    write_bytes(r_buffer, p_text, p_size);
+    return;
+  }
+  r_buffer.push_back('"');
+  for (int i = 0; i < p_size; i++) {
+    if (p_text[i] == '"') {
+      r_buffer.push_back('"');
+    }
+    r_buffer.push_back(p_text[i]);
+  }
+  r_buffer.push_back('"');
+}
+
+int64_t sqlite_csv_export(sqlite3_stmt *p_stmt, const Ref<FileAccess> &p_file,
+                          const SQLiteCSVOptions &p_options) {
+  const int col_count = sqlite3_column_count(p_stmt);
+  LocalVector<uint8_t> buffer;
+  buffer.reserve(EXPORT_BUFFER_SIZE + 4096);
+
+  if (p_options.header) {
+    for (int i = 0; i < col_count; i++) {
+      if (i > 0) {
+        buffer.push_back(p_options.delimiter);
+      }
+      const char *name = sqlite3_column_name(p_stmt, i);
+      write_field(buffer, name, strlen(name), p_options.delimiter, false);
+    }
+    buffer.push_back('\n');
+  }
+
+  int64_t rows = 0;
+  int res = SQLITE_ROW;
+  char number[32];
+  while ((res = sqlite3_step(p_stmt)) == SQLITE_ROW) {
+    for (int i = 0; i < col_count; i++) {
+      if (i > 0) {
+        buffer.push_back(p_options.delimiter);
+      }
+      switch (sqlite3_column_type(p_stmt, i)) {
+      case SQLITE_INTEGER: {
+        const long long value = sqlite3_column_int64(p_stmt, i);
+        write_bytes(buffer, number,
+                    snprintf(number, sizeof(number), "%lld", value));
+      } break;
+      case SQLITE_FLOAT: {
+        const double value = sqlite3_column_double(p_stmt, i);
+        write_bytes(buffer, number,
+                    snprintf(number, sizeof(number), "%.17g", value));
+      } break;
+      case SQLITE_TEXT: {
+        // Quoted when it would be read back as NULL or as a number.
+        const char *text = (const char *)sqlite3_column_text(p_stmt, i);
+        const int size = sqlite3_column_bytes(p_stmt, i);
+        SQLiteCSVCell cell;
+        write_field(buffer, text, size, p_options.delimiter,
+                    size == 0 || parse_number(text, size, cell));
+      } break;
+      case SQLITE_BLOB: {
+        // Base64, which never needs to be quoted.
+        const int size = sqlite3_column_bytes(p_stmt, i);
+        const uint32_t offset = buffer.size();
+        buffer.resize(offset + (size + 2) / 3 * 4 + 1);
+        size_t length = 0;
+        CryptoCore::b64_encode(
+            buffer.ptr() + offset, buffer.size() - offset, &length,
+            (const uint8_t *)sqlite3_column_blob(p_stmt, i), size);
+        buffer.resize(offset + length);
+      } break;
+      default:
+        // NULL is an empty field.
+        break;
+      }
+    }
+    buffer.push_back('\n');
+    rows += 1;
+
+    if (buffer.size() >= EXPORT_BUFFER_SIZE) {
+      p_file->store_buffer(buffer.ptr(), buffer.size());
+      buffer.clear();
+    }
+  }
+  p_file->store_buffer(buffer.ptr(), buffer.size());
+
+  return res == SQLITE_DONE ? rows : -1;
+}
+
+uint64_t SQLiteCSVParser::parse_record(uint64_t p_pos, uint64_t p_end,
+                                       LocalVector<SQLiteCSVCell> &r_cells,
+                                       LocalVector<char> &r_text,
+                                       String &r_error) const {
+  uint64_t pos = p_pos;
+  while (true) {
+    SQLiteCSVCell cell;
+    if (pos < p_end && data[pos] == '"') {
+      // Quoted, always TEXT.
+      const uint64_t quote = pos;
+      pos++;
+      const uint64_t begin = pos;
+      uint64_t text_begin = 0;
+      while (pos < p_end) {
+        if (data[pos] != '"') {
+          if (cell.unescaped) {
+            r_text.push_back(data[pos]);
+          }
+          pos++;
+          continue;
+        }
+        if (pos + 1 < p_end && data[pos + 1] == '"') {
+          // Escaped quote, from there the value is copied without them.
+          if (!cell.unescaped) {
+            cell.unescaped = true;
+            text_begin = r_text.size();
+            r_text.resize(text_begin + (pos - begin));
+            memcpy(r_text.ptr() + text_begin, data + begin, pos - begin);
+          }
+          r_text.push_back('"');
+          pos += 2;
+          continue;
+        }
+        break;
+      }
+      if (pos >= p_end) {
+        r_error = "The quoted field at byte " + itos(quote) +
+                  " has no closing quote.";
+        return p_end;
+      }
+      if (cell.unescaped) {
+        cell.offset = text_begin;
+        cell.length = r_text.size() - text_begin;
+      } else {
+        cell.offset = begin;
+        cell.length = pos - begin;
+      }
+      cell.type = SQLITE_TEXT;
+      // Skips the closing quote.
+      pos++;
+      if (pos < p_end && data[pos] != delimiter && data[pos] != '\n' &&
+          data[pos] != '\r') {
+        r_error = "Unexpected character after the closing quote at byte " +
+                  itos(pos) + ".";
+        return pos;
+      }
+    } else {
+      const uint64_t begin = pos;
+      while (pos < p_end && data[pos] != delimiter && data[pos] != '\n' &&
+             data[pos] != '\r') {
+        pos++;
+      }
+      cell.offset = begin;
+      cell.length = pos - begin;
+      if (cell.length > 0) {
+        if (!infer_types ||
+            !parse_number((const char *)data + begin, cell.length, cell)) {
+          cell.type = SQLITE_TEXT;
+          cell.offset = begin;
+        }
+      }
+    }
+    r_cells.push_back(cell);
+
+    if (pos < p_end && data[pos] == delimiter) {
+      pos++;
+      continue;
+    }
+    if (pos < p_end && data[pos] == '\r') {
+      pos++;
+    }
+    if (pos < p_end && data[pos] == '\n') {
+      pos++;
+    }
+    return pos;
+  }
+}
+
+void SQLiteCSVParser::parse_chunk(Chunk &p_chunk) const {
+  uint64_t pos = p_chunk.begin;
+  while (pos < p_chunk.end) {
+    if (data[pos] == '\n' || data[pos] == '\r') {
+      // Empty lines are skipped.
+      pos++;
+      continue;
+    }
+    const uint32_t row_begin = p_chunk.cells.size();
+    const uint64_t record = pos;
+    pos = parse_record(pos, p_chunk.end, p_chunk.cells, p_chunk.text,
+                       p_chunk.error);
+    if (!p_chunk.error.is_empty()) {
+      p_chunk.cells.resize(row_begin);
+      return;
+    }
+    const int fields = p_chunk.cells.size() - row_begin;
+    if (fields != column_count) {
+      p_chunk.error = "The record at byte " + itos(record) + " has " +
+                      itos(fields) + " fields instead of " +
+                      itos(column_count) + ".";
+      p_chunk.cells.resize(row_begin);
+      return;
+    }
+  }
+}
+
+void SQLiteCSVParser::thread_func(void *p_self) {
+  SQLiteCSVParser *self = static_cast<SQLiteCSVParser *>(p_self);
+  while (true) {
+    const uint32_t index = self->next_chunk.postincrement();
+    if (index >= uint32_t(self->chunk_count)) {
+      break;
+    }
+    Chunk &chunk = self->chunks[index];
+    if (!self->cancel_requested.is_set()) {
+      self->parse_chunk(chunk);
+    }
+    chunk.ready.post();
+  }
+}
+
+bool SQLiteCSVParser::start(const uint8_t *p_data, uint64_t p_size,
+                            const SQLiteCSVOptions &p_options,
+                            PackedStringArray &r_columns) {
+  ERR_FAIL_COND_V(chunks != nullptr, false);
+  data = p_data;
+  size = p_size;
+  delimiter = p_options.delimiter;
+  infer_types = p_options.infer_types;
+
+  uint64_t pos = 0;
+  // UTF-8 BOM.
+  if (size >= 3 && data[0] == 0xEF && data[1] == 0xBB && data[2] == 0xBF) {
+    pos = 3;
+  }
+  while (pos < size && (data[pos] == '\n' || data[pos] == '\r')) {
+    pos++;
+  }
+  ERR_FAIL_COND_V_MSG(pos >= size, false, "The CSV file is empty.");
+
+  // The first record gives the number of columns.
+  LocalVector<SQLiteCSVCell> cells;
+  LocalVector<char> text;
+  const bool was_inferring = infer_types;
+  infer_types = false;
+  String error;
+  const uint64_t first_record_end =
+      parse_record(pos, size, cells, text, error);
+  infer_types = was_inferring;
+  ERR_FAIL_COND_V_MSG(!error.is_empty(), false, error);
+  column_count = cells.size();
+
+  r_columns = p_options.columns;
+  if (p_options.header) {
+    if (r_columns.is_empty()) {
+      for (uint32_t i = 0; i < cells.size(); i++) {
+        r_columns.push_back(
+            String::utf8(get_text(text, cells[i]), cells[i].length));
+      }
+    }
+    pos = first_record_end;
+  }
+  ERR_FAIL_COND_V_MSG(r_columns.size() != column_count, false,
+                      "The CSV file has " + itos(column_count) +
+                          " columns, but " + itos(r_columns.size()) +
+                          " names are given.");
+
+  // Splits on the new lines which aren't quoted. As in `parse_record()`, a
+  // quote opens a quoted field only at the start of the field, elsewhere
+  // it's text.
+  LocalVector<uint64_t> bounds;
+  bounds.push_back(pos);
+  uint64_t target = pos + p_options.chunk_size;
+  bool quoted = false;
+  bool field_start = true;
+  for (uint64_t i = pos; i < size; i++) {
+    const uint8_t c = data[i];
+    if (quoted) {
+      if (c == '"') {
+        if (i + 1 < size && data[i + 1] == '"') {
+          // Escaped quote.
+          i++;
+        } else {
+          quoted = false;
+        }
+      }
+    } else if (c == '"' && field_start) {
+      quoted = true;
+      field_start = false;
+    } else if (c == delimiter || c == '\r') {
+      field_start = true;
+    } else if (c == '\n') {
+      field_start = true;
+      if (i + 1 >= target && i + 1 < size) {
+        bounds.push_back(i + 1);
+        target = i + 1 + p_options.chunk_size;
+      }
+    } else {
+      field_start = false;
+    }
+  }
+  bounds.push_back(size);
+
+  chunk_count = bounds.size() - 1;
+  chunks = memnew_arr(Chunk, chunk_count);
+  for (int i = 0; i < chunk_count; i++) {
+    chunks[i].begin = bounds[i];
+    chunks[i].end = bounds[i + 1];
+  }
+
+  next_chunk.set(0);
+  cancel_requested.clear();
+  const int thread_count = MIN(p_options.threads, chunk_count);
+  for (int i = 0; i < thread_count; i++) {
+    Thread *thread = memnew(Thread);
+    thread->start(thread_func, this);
+    threads.push_back(thread);
+  }
+  return true;
+}
+
+SQLiteCSVParser::Chunk &SQLiteCSVParser::wait_chunk(int p_index) {
+  CRASH_BAD_INDEX(p_index, chunk_count);
+  chunks[p_index].ready.wait();
+  return chunks[p_index];
+}
+
+void SQLiteCSVParser::release_chunk(int p_index) {
+  ERR_FAIL_INDEX(p_index, chunk_count);
+  chunks[p_index].cells.reset();
+  chunks[p_index].text.reset();
+}
+
+const char *SQLiteCSVParser::get_text(const LocalVector<char> &p_text,
+                                      const SQLiteCSVCell &p_cell) const {
+  if (p_cell.unescaped) {
+    return p_text.ptr() + p_cell.offset;
+  }
+  return (const char *)data + p_cell.offset;
+}
+
+void SQLiteCSVParser::finish() {
+  cancel_requested.set();
+  for (Thread *thread : threads) {
+    thread->wait_to_finish();
+    memdelete(thread);
+  }
+  threads.clear();
+  if (chunks != nullptr) {
+    memdelete_arr(chunks);
+    chunks = nullptr;
+  }
+  chunk_count = 0;
+}
+
+SQLiteCSVParser::~SQLiteCSVParser() { finish(); }
@@ -0,0 +1,106 @@
+#ifndef GDSQLITE_CSV_H
+#define GDSQLITE_CSV_H
+
+#include "core/io/file_access.h"
+#include "core/os/semaphore.h"
+#include "core/os/thread.h"
+#include "core/templates/local_vector.h"
+#include "core/templates/safe_refcount.h"
+#include "core/variant/variant.h"
+
+#include "thirdparty/sqlite/sqlite3.h"
+
+struct SQLiteCSVOptions {
+  char delimiter = ',';
+  // The first record holds the column names.
+  bool header = true;
+  // Column names, used instead of the header.
+  PackedStringArray columns;
+  // Creates the table when it doesn't exist, with the column types inferred
+  // from the first chunk.
+  bool create_table = true;
+  // Reads the unquoted numbers as INTEGER and REAL, instead of TEXT.
+  bool infer_types = true;
+  int threads = 1;
+  int chunk_size = 1 << 20;
+};
+
+/// Reads the options of `export_csv()` and `import_csv()`.
+bool sqlite_csv_parse_options(const Dictionary &p_options,
+                              SQLiteCSVOptions &r_options);
+
+/// Writes the rows of `p_stmt` to `p_file`, a chunk at a time. Returns the
+/// number of rows written, or -1 if the statement failed.
+int64_t sqlite_csv_export(sqlite3_stmt *p_stmt, const Ref<FileAccess> &p_file,
+                          const SQLiteCSVOptions &p_options);
+
+/// A value read from a CSV file. TEXT values point into the CSV content,
+/// or in the chunk when they had escaped quotes.
+struct SQLiteCSVCell {
+  int type = SQLITE_NULL;
+  bool unescaped = false;
+  uint32_t length = 0;
+  union {
+    int64_t integer;
+    double real;
+    uint64_t offset = 0;
+  };
+};
+
+/// Parses a CSV content on threads, split in chunks of whole records. The
+/// chunks are parsed in parallel and consumed in order with `wait_chunk()`.
+class SQLiteCSVParser {
+public:
+  struct Chunk {
+    uint64_t begin = 0;
+    uint64_t end = 0;
+    LocalVector<SQLiteCSVCell> cells;
+    // The unescaped quoted values.
+    LocalVector<char> text;
+    String error;
+    Semaphore ready;
+  };
+
+private:
+  const uint8_t *data = nullptr;
+  uint64_t size = 0;
+  char delimiter = ',';
+  bool infer_types = true;
+  int column_count = 0;
+
+  Chunk *chunks = nullptr;
+  int chunk_count = 0;
+  SafeNumeric<uint32_t> next_chunk;
+  SafeFlag cancel_requested;
+  LocalVector<Thread *> threads;
+
+  static void thread_func(void *p_self);
+  // Returns the end of the record, `r_error` is set when it's malformed.
+  uint64_t parse_record(uint64_t p_pos, uint64_t p_end,
+                        LocalVector<SQLiteCSVCell> &r_cells,
+                        LocalVector<char> &r_text, String &r_error) const;
+  void parse_chunk(Chunk &p_chunk) const;
+
+public:
+  /// Reads the header, splits `p_data` in chunks and starts the threads.
+  /// `p_data` must stay valid until `finish()`.
+  bool start(const uint8_t *p_data, uint64_t p_size,
+             const SQLiteCSVOptions &p_options, PackedStringArray &r_columns);
+
+  int get_chunk_count() const { return chunk_count; }
+  int get_column_count() const { return column_count; }
+  /// Returns the chunk `p_index`, once parsed.
+  Chunk &wait_chunk(int p_index);
+  /// Frees the cells of a chunk which has been consumed.
+  void release_chunk(int p_index);
+  /// Returns the start of a TEXT value of the chunk holding `p_text`.
+  const char *get_text(const LocalVector<char> &p_text,
+                       const SQLiteCSVCell &p_cell) const;
+
+  /// Stops the threads, the remaining chunks are left unparsed.
+  void finish();
+
+  ~SQLiteCSVParser();
+};
+
+#endif
@@ -0,0 +1,412 @@
+#include "sqlite_functions.h"
+
+#include "core/math/math_funcs.h"
+#include "core/templates/hashfuncs.h"
+#include "core/templates/local_vector.h"
+
+Variant sqlite_value_to_variant(sqlite3_value *p_value) {
+  switch (sqlite3_value_type(p_value)) {
+  case SQLITE_INTEGER:
+    return Variant(int64_t(sqlite3_value_int64(p_value)));
+
+  case SQLITE_FLOAT:
+    return Variant(sqlite3_value_double(p_value));
+
+  case SQLITE_TEXT: {
+    const int size = sqlite3_value_bytes(p_value);
+    return Variant(
+        String::utf8((const char *)sqlite3_value_text(p_value), size));
+  }
+  case SQLITE_BLOB: {
+    PackedByteArray arr;
+    const int size = sqlite3_value_bytes(p_value);
+    if (size > 0) {
+      arr.resize(size);
+      memcpy(arr.ptrw(), sqlite3_value_blob(p_value), size);
+    }
+    return Variant(arr);
+  }
+  default:
+    // SQLITE_NULL
+    return Variant();
+  }
+}
+
+void sqlite_result_variant(sqlite3_context *p_ctx, const Variant &p_value) {
+  switch (p_value.get_type()) {
+  case Variant::NIL:
+    sqlite3_result_null(p_ctx);
+    break;
+  case Variant::BOOL:
+  case Variant::INT:
+    sqlite3_result_int64(p_ctx, int64_t(p_value));
+    break;
+  case Variant::FLOAT:
+    sqlite3_result_double(p_ctx, double(p_value));
+    break;
+  case Variant::STRING:
+  case Variant::STRING_NAME: {
+    const CharString utf8 = String(p_value).utf8();
+    sqlite3_result_text(p_ctx, utf8.get_data(), utf8.length(),
+                        SQLITE_TRANSIENT);
+  } break;
+  case Variant::PACKED_BYTE_ARRAY: {
+    const PackedByteArray arr = p_value;
+    sqlite3_result_blob(p_ctx, arr.ptr(), arr.size(), SQLITE_TRANSIENT);
+  } break;
+  case Variant::PACKED_FLOAT32_ARRAY: {
+    // Stored as raw float32 values, the layout used for vector columns.
+    const PackedFloat32Array arr = p_value;
+    sqlite3_result_blob(p_ctx, arr.ptr(), arr.size() * sizeof(float),
+                        SQLITE_TRANSIENT);
+  } break;
+  default: {
+    const CharString err =
+        ("SQLite function returned an unhandled Variant of type " +
+         Variant::get_type_name(p_value.get_type()) + ".")
+            .utf8();
+    sqlite3_result_error(p_ctx, err.get_data(), err.length());
+  } break;
+  }
+}
+
+// ----------------------------------------------------------------- Callables
+
+struct SQLiteCallableFunction {
+  Callable function;
+  Callable step;
+  Callable final;
+};
+
+static void callable_function_destroy(void *p_data) {
+  memdelete(static_cast<SQLiteCallableFunction *>(p_data));
+}
+
+static bool call_for_context(sqlite3_context *p_ctx, const Callable &p_callable,
+                             const Variant **p_args, int p_argcount,
+                             Variant &r_ret) {
+  Callable::CallError ce;
+  p_callable.call(p_args, p_argcount, r_ret, ce);
+  if (ce.error != Callable::CallError::CALL_OK) {
+    const CharString err = Variant::get_callable_error_text(
+                               p_callable, p_args, p_argcount, ce)
+                               .utf8();
+    sqlite3_result_error(p_ctx, err.get_data(), err.length());
+    return false;
+  }
+  return true;
+}
+
+static void callable_function_call(sqlite3_context *p_ctx, int p_argc,
+                                   sqlite3_value **p_argv) {
+  const SQLiteCallableFunction *data =
+      static_cast<SQLiteCallableFunction *>(sqlite3_user_data(p_ctx));
+
+  LocalVector<Variant> args;
+  LocalVector<const Variant *> argptrs;
+  args.resize(p_argc);
+  argptrs.resize(p_argc);
+  for (int i = 0; i < p_argc; i++) {
+    args[i] = sqlite_value_to_variant(p_argv[i]);
+    argptrs[i] = &args[i];
+  }
+
+  Variant ret;
+  if (call_for_context(p_ctx, data->function, argptrs.ptr(), p_argc, ret)) {
+    sqlite_result_variant(p_ctx, ret);
+  }
+}
+
+static Variant *aggregate_state(sqlite3_context *p_ctx, bool p_create) {
+  // SQLite zeroes the context on first allocation, and returns nullptr when
+  // `xFinal` is reached without any `xStep`.
+  Variant **slot = static_cast<Variant **>(
+      sqlite3_aggregate_context(p_ctx, p_create ? sizeof(Variant *) : 0));
+  if (slot == nullptr) {
+    return nullptr;
+  }
+  if (*slot == nullptr && p_create) {
+    *slot = memnew(Variant);
+  }
+  return *slot;
+}
+
+static void callable_aggregate_step(sqlite3_context *p_ctx, int p_argc,
+                                    sqlite3_value **p_argv) {
+  const SQLiteCallableFunction *data =
+      static_cast<SQLiteCallableFunction *>(sqlite3_user_data(p_ctx));
+
+  Variant *state = aggregate_state(p_ctx, true);
+  if (state == nullptr) {
+    sqlite3_result_error_nomem(p_ctx);
+    return;
+  }
+
+  // The state is passed as the first argument.
+  LocalVector<Variant> args;
+  LocalVector<const Variant *> argptrs;
+  args.resize(p_argc + 1);
+  argptrs.resize(p_argc + 1);
+  args[0] = *state;
+  argptrs[0] = &args[0];
+  for (int i = 0; i < p_argc; i++) {
+    args[i + 1] = sqlite_value_to_variant(p_argv[i]);
+    argptrs[i + 1] = &args[i + 1];
+  }
+
+  Variant ret;
+  if (call_for_context(p_ctx, data->step, argptrs.ptr(), p_argc + 1, ret)) {
+    *state = ret;
+  }
+}
+
+static void callable_aggregate_final(sqlite3_context *p_ctx) {
+  const SQLiteCallableFunction *data =
+      static_cast<SQLiteCallableFunction *>(sqlite3_user_data(p_ctx));
+
+  Variant *state = aggregate_state(p_ctx, false);
+  Variant empty_state;
+  const Variant *argptr = state ? state : &empty_state;
+
+  Variant ret;
+  if (call_for_context(p_ctx, data->final, &argptr, 1, ret)) {
+    sqlite_result_variant(p_ctx, ret);
+  }
+
+  if (state != nullptr) {
+    memdelete(state);
+  }
+}
+
+static int function_flags(bool p_deterministic) {
+  return SQLITE_UTF8 | (p_deterministic ? SQLITE_DETERMINISTIC : 0);
+}
+
+int sqlite_create_callable_function(sqlite3 *p_db, const String &p_name,
+                                    const Callable &p_function, int p_argc,
+                                    bool p_deterministic) {
+  SQLiteCallableFunction *data = memnew(SQLiteCallableFunction);
+  data->function = p_function;
+  // On failure SQLite invokes the destructor, so `data` is never leaked.
+  return sqlite3_create_function_v2(
+      p_db, p_name.utf8().get_data(), p_argc, function_flags(p_deterministic),
+      data, callable_function_call, nullptr, nullptr,
+      callable_function_destroy);
+}
+
+int sqlite_create_callable_aggregate(sqlite3 *p_db, const String &p_name,
+                                     const Callable &p_step,
+                                     const Callable &p_final, int p_argc,
+                                     bool p_deterministic) {
+  SQLiteCallableFunction *data = memnew(SQLiteCallableFunction);
+  data->step = p_step;
+  data->final = p_final;
+  return sqlite3_create_function_v2(
+      p_db, p_name.utf8().get_data(), p_argc, function_flags(p_deterministic),
+      data, nullptr, callable_aggregate_step, callable_aggregate_final,
+      callable_function_destroy);
+}
+
+// ------------------------------------------------------- Built in functions
+
+static bool has_null_arg(int p_argc, sqlite3_value **p_argv) {
+  for (int i = 0; i < p_argc; i++) {
+    if (sqlite3_value_type(p_argv[i]) == SQLITE_NULL) {
+      return true;
+    }
+  }
+  return false;
+}
+
+/// `clamp(value, min, max)`: stays an integer when all the arguments are.
+static void fn_clamp(sqlite3_context *p_ctx, int p_argc,
+                     sqlite3_value **p_argv) {
+  if (has_null_arg(p_argc, p_argv)) {
+    sqlite3_result_null(p_ctx);
+    return;
+  }
+  if (sqlite3_value_numeric_type(p_argv[0]) == SQLITE_INTEGER &&
+      sqlite3_value_numeric_type(p_argv[1]) == SQLITE_INTEGER &&
+      sqlite3_value_numeric_type(p_argv[2]) == SQLITE_INTEGER) {
+    const int64_t v = sqlite3_value_int64(p_argv[0]);
+    const int64_t lo = sqlite3_value_int64(p_argv[1]);
+    const int64_t hi = sqlite3_value_int64(p_argv[2]);
+    sqlite3_result_int64(p_ctx, v < lo ? lo : (v > hi ? hi : v));
+  } else {
+    const double v = sqlite3_value_double(p_argv[0]);
+    const double lo = sqlite3_value_double(p_argv[1]);
+    const double hi = sqlite3_value_double(p_argv[2]);
+    sqlite3_result_double(p_ctx, v < lo ? lo : (v > hi ? hi : v));
+  }
+}
+
+/// `lerp(from, to, weight)`
+static void fn_lerp(sqlite3_context *p_ctx, int p_argc,
+                    sqlite3_value **p_argv) {
+  if (has_null_arg(p_argc, p_argv)) {
+    sqlite3_result_null(p_ctx);
+    return;
+  }
+  sqlite3_result_double(p_ctx, Math::lerp(sqlite3_value_double(p_argv[0]),
+                                          sqlite3_value_double(p_argv[1]),
+                                          sqlite3_value_double(p_argv[2])));
+}
+
+/// `inverse_lerp(from, to, value)`
+static void fn_inverse_lerp(sqlite3_context *p_ctx, int p_argc,
+                            sqlite3_value **p_argv) {
+  if (has_null_arg(p_argc, p_argv)) {
+    sqlite3_result_null(p_ctx);
+    return;
+  }
+  sqlite3_result_double(p_ctx,
+                        Math::inverse_lerp(sqlite3_value_double(p_argv[0]),
+                                           sqlite3_value_double(p_argv[1]),
+                                           sqlite3_value_double(p_argv[2])));
+}
+
+/// `vecN_distance(a1, .., aN, b1, .., bN)`, the `_squared` variant skips the
+/// square root and is enough to sort or compare against a squared radius.
+template <int N, bool SQUARED>
+static void fn_vec_distance(sqlite3_context *p_ctx, int p_argc,
+                            sqlite3_value **p_argv) {
+  if (has_null_arg(p_argc, p_argv)) {
+    sqlite3_result_null(p_ctx);
+    return;
+  }
+  double sum = 0.0;
+  for (int i = 0; i < N; i++) {
+    const double d =
+        sqlite3_value_double(p_argv[i]) - sqlite3_value_double(p_argv[N + i]);
+    sum += d * d;
+  }
+  sqlite3_result_double(p_ctx, SQUARED ? sum : Math::sqrt(sum));
+}
+
+/// `vecN_dot(a1, .., aN, b1, .., bN)`
+template <int N>
+static void fn_vec_dot(sqlite3_context *p_ctx, int p_argc,
+                       sqlite3_value **p_argv) {
+  if (has_null_arg(p_argc, p_argv)) {
+    sqlite3_result_null(p_ctx);
+    return;
+  }
+  double sum = 0.0;
+  for (int i = 0; i < N; i++) {
+    sum +=
+        sqlite3_value_double(p_argv[i]) * sqlite3_value_double(p_argv[N + i]);
+  }
+  sqlite3_result_double(p_ctx, sum);
+}
+
+/// `bit_count(value)`: number of bits set in a 64 bits integer.
+static void fn_bit_count(sqlite3_context *p_ctx, int p_argc,
+                         sqlite3_value **p_argv) {
+  if (has_null_arg(p_argc, p_argv)) {
+    sqlite3_result_null(p_ctx);
+    return;
+  }
+  uint64_t v = uint64_t(sqlite3_value_int64(p_argv[0]));
+  int count = 0;
+  while (v) {
+    v &= v - 1;
+    count += 1;
+  }
+  sqlite3_result_int(p_ctx, count);
+}
+
+enum BitOp { BIT_TEST, BIT_SET, BIT_CLEAR };
+
+/// `bit_test(value, bit)`, `bit_set(value, bit)` and `bit_clear(value, bit)`.
+template <BitOp OP>
+static void fn_bit_op(sqlite3_context *p_ctx, int p_argc,
+                      sqlite3_value **p_argv) {
+  if (has_null_arg(p_argc, p_argv)) {
+    sqlite3_result_null(p_ctx);
+    return;
+  }
+  const int64_t bit = sqlite3_value_int64(p_argv[1]);
+  if (bit < 0 || bit > 63) {
+    sqlite3_result_error(p_ctx, "Bit index must be between 0 and 63.", -1);
+    return;
+  }
+  const uint64_t v = uint64_t(sqlite3_value_int64(p_argv[0]));
+  const uint64_t mask = uint64_t(1) << bit;
+  switch (OP) {
+  case BIT_TEST:
+    sqlite3_result_int(p_ctx, (v & mask) ? 1 : 0);
+    break;
+  case BIT_SET:
+    sqlite3_result_int64(p_ctx, int64_t(v | mask));
+    break;
+  case BIT_CLEAR:
+    sqlite3_result_int64(p_ctx, int64_t(v & ~mask));
+    break;
+  }
+}
+
+/// `hash(value)`: stable 32 bits hash (djb2) of the value. Text is hashed as
+/// its UTF-8 bytes, so it's stable across runs and platforms.
+static void fn_hash(sqlite3_context *p_ctx, int p_argc,
+                    sqlite3_value **p_argv) {
+  sqlite3_value *value = p_argv[0];
+  uint32_t h = 0;
+  switch (sqlite3_value_type(value)) {
+  case SQLITE_INTEGER:
+    h = hash_djb2_one_64(uint64_t(sqlite3_value_int64(value)));
+    break;
+  case SQLITE_FLOAT:
+    h = hash_djb2_one_float(sqlite3_value_double(value));
+    break;
+  case SQLITE_TEXT: {
+    const uint8_t *text = sqlite3_value_text(value);
+    h = hash_djb2_buffer(text, sqlite3_value_bytes(value));
+  } break;
+  case SQLITE_BLOB: {
+    const uint8_t *blob =
+        static_cast<const uint8_t *>(sqlite3_value_blob(value));
+    h = hash_djb2_buffer(blob, sqlite3_value_bytes(value));
+  } break;
+  default:
+    sqlite3_result_null(p_ctx);
+    return;
+  }
+  sqlite3_result_int64(p_ctx, int64_t(h));
+}
+
+struct SQLiteBuiltinFunction {
+  const char *name;
+  int argc;
+  void (*func)(sqlite3_context *, int, sqlite3_value **);
+};
+
+static const SQLiteBuiltinFunction builtin_functions[] = {
+    {"clamp", 3, fn_clamp},
+    {"lerp", 3, fn_lerp},
+    {"inverse_lerp", 3, fn_inverse_lerp},
+    {"vec2_distance", 4, fn_vec_distance<2, false>},
+    {"vec2_distance_squared", 4, fn_vec_distance<2, true>},
+    {"vec3_distance", 6, fn_vec_distance<3, false>},
+    {"vec3_distance_squared", 6, fn_vec_distance<3, true>},
+    {"vec2_dot", 4, fn_vec_dot<2>},
+    {"vec3_dot", 6, fn_vec_dot<3>},
+    {"bit_count", 1, fn_bit_count},
+    {"bit_test", 2, fn_bit_op<BIT_TEST>},
+    {"bit_set", 2, fn_bit_op<BIT_SET>},
+    {"bit_clear", 2, fn_bit_op<BIT_CLEAR>},
+    {"hash", 1, fn_hash},
+};
+
+bool sqlite_register_builtin_functions(sqlite3 *p_db) {
+  // Pure functions: SQLite can use them in indexes and constant-fold them.
+  const int flags = SQLITE_UTF8 | SQLITE_DETERMINISTIC | SQLITE_INNOCUOUS;
+  for (const SQLiteBuiltinFunction &f : builtin_functions) {
+    const int res = sqlite3_create_function_v2(p_db, f.name, f.argc, flags,
+                                               nullptr, f.func, nullptr,
+                                               nullptr, nullptr);
+    ERR_FAIL_COND_V_MSG(res != SQLITE_OK, false,
+                        "Cannot register the SQL function: " +
+                            String(f.name));
+  }
+  return true;
+}
@@ -0,0 +1,33 @@
+#ifndef GDSQLITE_FUNCTIONS_H
+#define GDSQLITE_FUNCTIONS_H
+
+#include "core/variant/callable.h"
+#include "core/variant/variant.h"
+
+#include "thirdparty/sqlite/sqlite3.h"
+
+/// Converts an SQLite value, as received by a SQL function, into a Variant.
+Variant sqlite_value_to_variant(sqlite3_value *p_value);
+
+/// Sets the result of a SQL function from a Variant.
+void sqlite_result_variant(sqlite3_context *p_ctx, const Variant &p_value);
+
+/// Registers the native SQL functions shipped with this module (`clamp`,
+/// `lerp`, `vec3_distance`, `bit_count`, `hash`, ...) on the given connection.
+bool sqlite_register_builtin_functions(sqlite3 *p_db);
+
+/// Registers a scalar SQL function that calls `p_function`.
+int sqlite_create_callable_function(sqlite3 *p_db, const String &p_name,
+                                    const Callable &p_function, int p_argc,
+                                    bool p_deterministic);
+
+/// Registers an aggregate SQL function.
+/// `p_step` is called for each row as `step(state, ...args)` and must return
+/// the new state; `p_final` is called once as `final(state)` and its return
+/// value is the result of the aggregate. The state starts as `null`.
+int sqlite_create_callable_aggregate(sqlite3 *p_db, const String &p_name,
+                                     const Callable &p_step,
+                                     const Callable &p_final, int p_argc,
+                                     bool p_deterministic);
+
+#endif
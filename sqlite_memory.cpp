@@ -0,0 +1,267 @@
+#include "sqlite_memory.h"
+#include "sqlite_pcache.h"
+
+#include "core/config/project_settings.h"
+#include "core/io/file_access.h"
+#include "core/os/memory.h"
+#include "core/templates/local_vector.h"
+#include "core/templates/safe_refcount.h"
+
+#ifdef __linux__
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+// Each block starts with its size, which `xSize` and the stats need.
+// Eight bytes keep the blocks 8-byte aligned, as SQLite requires.
+static const size_t HEADER_SIZE = 8;
+
+static bool godot_allocator = false;
+static SafeNumeric<int64_t> memory_used;
+static SafeNumeric<int64_t> memory_peak;
+static SafeNumeric<int64_t> live_blocks;
+
+static void *to_block(void *p_ptr) {
+  return static_cast<uint8_t *>(p_ptr) - HEADER_SIZE;
+}
+
+static int64_t block_size(void *p_ptr) {
+  return *static_cast<int64_t *>(to_block(p_ptr));
+}
+
+static void *init_block(void *p_block, int p_size) {
+  *static_cast<int64_t *>(p_block) = p_size;
+  return static_cast<uint8_t *>(p_block) + HEADER_SIZE;
+}
+
+static void *memory_malloc(int p_size) {
+  void *block = Memory::alloc_static(HEADER_SIZE + p_size);
+  if (block == nullptr) {
+    return nullptr;
+  }
+  memory_peak.exchange_if_greater(memory_used.add(p_size));
+  live_blocks.increment();
+  return init_block(block, p_size);
+}
+
+static void memory_free(void *p_ptr) {
+  if (p_ptr == nullptr) {
+    return;
+  }
+  memory_used.sub(block_size(p_ptr));
+  live_blocks.decrement();
+  Memory::free_static(to_block(p_ptr));
+}
+
+static void *memory_realloc(void *p_ptr, int p_size) {
+  const int64_t previous = block_size(p_ptr);
+  void *block = Memory::realloc_static(to_block(p_ptr), HEADER_SIZE + p_size);
+  if (block == nullptr) {
+    // The old block is still valid.
+    return nullptr;
+  }
+  memory_peak.exchange_if_greater(memory_used.add(p_size - previous));
+  return init_block(block, p_size);
+}
+
+static int memory_size(void *p_ptr) { return int(block_size(p_ptr)); }
+
+static int memory_roundup(int p_size) { return (p_size + 7) & ~7; }
+
+static int memory_init(void *p_data) { return SQLITE_OK; }
+
+static void memory_shutdown(void *p_data) {}
+
+static const sqlite3_mem_methods godot_mem_methods = {
+    memory_malloc,   // xMalloc
+    memory_free,     // xFree
+    memory_realloc,  // xRealloc
+    memory_size,     // xSize
+    memory_roundup,  // xRoundup
+    memory_init,     // xInit
+    memory_shutdown, // xShutdown
+    nullptr,         // pAppData
+};
+
+void sqlite_memory_initialize() {
+  const bool use_godot_allocator =
+      GLOBAL_DEF_RST("sqlite/memory/use_godot_allocator", true);
+  // SQLite defaults; a slot count of 0 disables the lookaside buffers.
+  const int lookaside_slot_size =
+      GLOBAL_DEF_RST("sqlite/memory/lookaside_slot_size", 1200);
+  const int lookaside_slot_count =
+      GLOBAL_DEF_RST("sqlite/memory/lookaside_slot_count", 100);
+
+  if (use_godot_allocator) {
+    godot_allocator =
+        sqlite3_config(SQLITE_CONFIG_MALLOC, &godot_mem_methods) == SQLITE_OK;
+    ERR_FAIL_COND_MSG(!godot_allocator,
+                      "SQLite was initialized before its allocator could be "
+                      "configured.");
+  }
+  ERR_FAIL_COND_MSG(lookaside_slot_size < 0 || lookaside_slot_count < 0,
+                    "Invalid SQLite lookaside settings.");
+  sqlite3_config(SQLITE_CONFIG_LOOKASIDE, lookaside_slot_size,
+                 lookaside_slot_count);
+
+  const bool shared_page_cache =
+      GLOBAL_DEF_RST("sqlite/memory/shared_page_cache", false);
+  const int64_t shared_page_cache_budget_mb =
+      GLOBAL_DEF_RST("sqlite/memory/shared_page_cache_budget_mb", 64);
+  if (shared_page_cache) {
+    sqlite_pcache_configure(shared_page_cache_budget_mb * 1024 * 1024);
+  }
+}
+
+void sqlite_memory_finalize() {
+  sqlite3_shutdown();
+  godot_allocator = false;
+}
+
+// SQLite's own memory counters are off in the `performance` profile.
+#if defined(SQLITE_DEFAULT_MEMSTATUS) && SQLITE_DEFAULT_MEMSTATUS == 0
+static const bool memstatus = false;
+#else
+static const bool memstatus = true;
+#endif
+
+static int64_t status(int p_op, bool p_highwater) {
+  sqlite3_int64 current = 0;
+  sqlite3_int64 highwater = 0;
+  sqlite3_status64(p_op, &current, &highwater, 0);
+  return p_highwater ? highwater : current;
+}
+
+Dictionary sqlite_memory_global_stats() {
+  Dictionary stats;
+  stats["allocator"] = godot_allocator ? "godot" : "system";
+  // -1 when not tracked, rather than a misleading 0.
+  if (godot_allocator) {
+    // Tracked here, whether or not SQLite's own counters are on.
+    stats["memory_used"] = memory_used.get();
+    stats["memory_highwater"] = memory_peak.get();
+    stats["allocations"] = live_blocks.get();
+  } else if (memstatus) {
+    stats["memory_used"] = int64_t(sqlite3_memory_used());
+    stats["memory_highwater"] = int64_t(sqlite3_memory_highwater(0));
+    stats["allocations"] = status(SQLITE_STATUS_MALLOC_COUNT, false);
+  } else {
+    stats["memory_used"] = -1;
+    stats["memory_highwater"] = -1;
+    stats["allocations"] = -1;
+  }
+  stats["largest_allocation"] =
+      memstatus ? status(SQLITE_STATUS_MALLOC_SIZE, true) : -1;
+  stats["page_cache_overflow"] =
+      status(SQLITE_STATUS_PAGECACHE_OVERFLOW, false);
+  return stats;
+}
+
+// The memory map limit and the size of the main database file. Fails when
+// its VFS has no file, like the in memory databases.
+static bool main_file_mmap(sqlite3 *p_db, int64_t &r_mmap_size,
+                           int64_t &r_file_size) {
+  sqlite3_file *file = nullptr;
+  if (sqlite3_file_control(p_db, "main", SQLITE_FCNTL_FILE_POINTER, &file) !=
+          SQLITE_OK ||
+      file == nullptr || file->pMethods == nullptr) {
+    return false;
+  }
+  sqlite3_int64 size = 0;
+  if (file->pMethods->xFileSize(file, &size) != SQLITE_OK) {
+    return false;
+  }
+  r_file_size = size;
+  // -1 reads the limit without changing it. VFSes without xFetch can't map,
+  // and the encrypted one reports 0.
+  sqlite3_int64 mmap_size = -1;
+  if (file->pMethods->iVersion < 3 ||
+      sqlite3_file_control(p_db, "main", SQLITE_FCNTL_MMAP_SIZE,
+                           &mmap_size) != SQLITE_OK) {
+    mmap_size = 0;
+  }
+  r_mmap_size = MAX(sqlite3_int64(0), mmap_size);
+  return true;
+}
+
+Dictionary sqlite_memory_connection_stats(sqlite3 *p_db, bool p_reset) {
+  Dictionary stats;
+  ERR_FAIL_COND_V(p_db == nullptr, stats);
+
+  int current = 0;
+  int highwater = 0;
+  const auto db_status = [&](int p_op) {
+    current = 0;
+    highwater = 0;
+    sqlite3_db_status(p_db, p_op, &current, &highwater, p_reset);
+  };
+
+  db_status(SQLITE_DBSTATUS_CACHE_USED);
+  stats["cache_used"] = current;
+  db_status(SQLITE_DBSTATUS_CACHE_HIT);
+  stats["cache_hit"] = current;
+  db_status(SQLITE_DBSTATUS_CACHE_MISS);
+  stats["cache_miss"] = current;
+  db_status(SQLITE_DBSTATUS_CACHE_WRITE);
+  stats["cache_write"] = current;
+  db_status(SQLITE_DBSTATUS_CACHE_SPILL);
+  stats["cache_spill"] = current;
+
+  db_status(SQLITE_DBSTATUS_LOOKASIDE_USED);
+  stats["lookaside_used"] = current;
+  stats["lookaside_highwater"] = highwater;
+  // The hit and miss counts are only reported as highwater values.
+  db_status(SQLITE_DBSTATUS_LOOKASIDE_HIT);
+  stats["lookaside_hit"] = highwater;
+  db_status(SQLITE_DBSTATUS_LOOKASIDE_MISS_SIZE);
+  stats["lookaside_miss_size"] = highwater;
+  db_status(SQLITE_DBSTATUS_LOOKASIDE_MISS_FULL);
+  stats["lookaside_miss_full"] = highwater;
+
+  db_status(SQLITE_DBSTATUS_SCHEMA_USED);
+  stats["schema_used"] = current;
+  db_status(SQLITE_DBSTATUS_STMT_USED);
+  stats["stmt_used"] = current;
+
+  int64_t mmap_size = 0;
+  int64_t file_size = 0;
+  main_file_mmap(p_db, mmap_size, file_size);
+  stats["mmap_size"] = mmap_size;
+  stats["mmap_used"] = MIN(mmap_size, file_size);
+  return stats;
+}
+
+int64_t sqlite_memory_prefault(sqlite3 *p_db) {
+  ERR_FAIL_COND_V(p_db == nullptr, -1);
+  int64_t mmap_size = 0;
+  int64_t file_size = 0;
+  const char *path = sqlite3_db_filename(p_db, "main");
+  // Empty for the in memory and temporary databases.
+  if (!main_file_mmap(p_db, mmap_size, file_size) || path == nullptr ||
+      path[0] == '\0') {
+    return -1;
+  }
+  const int64_t length = mmap_size > 0 ? MIN(mmap_size, file_size) : file_size;
+
+#ifdef __linux__
+  // Read ahead by the kernel in the background, without copying anything.
+  const int fd = ::open(path, O_RDONLY | O_CLOEXEC);
+  ERR_FAIL_COND_V_MSG(fd < 0, -1,
+                      "Cannot prefault the database: " + String::utf8(path));
+  posix_fadvise(fd, 0, length, POSIX_FADV_WILLNEED);
+  ::close(fd);
+#else
+  // Read once, so the file is in the OS cache. Blocks the open until done.
+  Ref<FileAccess> file =
+      FileAccess::open(String::utf8(path), FileAccess::READ);
+  ERR_FAIL_COND_V_MSG(file.is_null(), -1,
+                      "Cannot prefault the database: " + String::utf8(path));
+  LocalVector<uint8_t> buffer;
+  buffer.resize(1 << 20);
+  for (int64_t position = 0; position < length; position += buffer.size()) {
+    file->get_buffer(buffer.ptr(), MIN(int64_t(buffer.size()),
+                                       length - position));
+  }
+#endif
+  return length;
+}
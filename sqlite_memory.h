@@ -0,0 +1,34 @@
+#ifndef GDSQLITE_MEMORY_H
+#define GDSQLITE_MEMORY_H
+
+#include "core/variant/dictionary.h"
+
+#include "thirdparty/sqlite/sqlite3.h"
+
+/// Configures SQLite from the `sqlite/memory/*` project settings: routes its
+/// allocations through `Memory::alloc_static()`, so they are part of
+/// `OS.get_static_memory_usage()`, sets the default lookaside buffers and
+/// installs the shared page cache.
+/// Must be called before any connection is opened.
+void sqlite_memory_initialize();
+
+/// Shuts SQLite down; every connection must be closed.
+void sqlite_memory_finalize();
+
+/// Memory used by SQLite as a whole.
+Dictionary sqlite_memory_global_stats();
+
+/// Memory used by one connection, from `sqlite3_db_status()`. When
+/// `p_reset` is set, the hit and miss counters restart from zero.
+/// Also reports the memory map of the main database: `mmap_size`, its
+/// limit, and `mmap_used`, the bytes of the file within the map.
+Dictionary sqlite_memory_connection_stats(sqlite3 *p_db, bool p_reset);
+
+/// Asks the OS to read the main database file ahead, up to the memory map
+/// limit or the whole file without map, so the first accesses don't wait on
+/// the disk. On Linux the kernel reads it in the background, elsewhere the
+/// file is read right away, blocking. Returns the number of bytes requested,
+/// -1 if it isn't a file.
+int64_t sqlite_memory_prefault(sqlite3 *p_db);
+
+#endif
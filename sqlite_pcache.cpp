@@ -0,0 +1,437 @@
+#include "sqlite_pcache.h"
+
+#include "core/os/memory.h"
+#include "core/os/mutex.h"
+#include "core/templates/hash_map.h"
+#include "core/templates/local_vector.h"
+#include "core/variant/array.h"
+
+#include "thirdparty/sqlite/sqlite3.h"
+
+struct PageCache;
+
+struct CachePage {
+  // First member: SQLite only sees this part.
+  sqlite3_pcache_page base;
+  PageCache *cache = nullptr;
+  unsigned key = 0;
+  bool pinned = true;
+  // Unpinned pages of purgeable caches are in two LRU lists, the global one
+  // and the one of their cache.
+  CachePage *global_prev = nullptr;
+  CachePage *global_next = nullptr;
+  CachePage *cache_prev = nullptr;
+  CachePage *cache_next = nullptr;
+};
+
+// Intrusive doubly linked list, most recently used page first.
+template <CachePage *CachePage::*PREV, CachePage *CachePage::*NEXT>
+struct PageList {
+  CachePage *first = nullptr;
+  CachePage *last = nullptr;
+
+  void push_front(CachePage *p_page) {
+    p_page->*PREV = nullptr;
+    p_page->*NEXT = first;
+    if (first != nullptr) {
+      first->*PREV = p_page;
+    } else {
+      last = p_page;
+    }
+    first = p_page;
+  }
+
+  void remove(CachePage *p_page) {
+    if (p_page->*PREV != nullptr) {
+      (p_page->*PREV)->*NEXT = p_page->*NEXT;
+    } else {
+      first = p_page->*NEXT;
+    }
+    if (p_page->*NEXT != nullptr) {
+      (p_page->*NEXT)->*PREV = p_page->*PREV;
+    } else {
+      last = p_page->*PREV;
+    }
+    p_page->*PREV = nullptr;
+    p_page->*NEXT = nullptr;
+  }
+};
+
+typedef PageList<&CachePage::global_prev, &CachePage::global_next>
+    GlobalPageList;
+typedef PageList<&CachePage::cache_prev, &CachePage::cache_next>
+    CachePageList;
+
+struct PageCache {
+  int page_size = 0;
+  int extra_size = 0;
+  // Caches of in memory and temporary databases hold the only copy of their
+  // pages: they are never evicted, and don't count in the budget.
+  bool purgeable = true;
+  // Set by `PRAGMA cache_size`, 0 until SQLite sets it.
+  unsigned max_pages = 0;
+  const void *owner = nullptr;
+  String name;
+  HashMap<unsigned, CachePage *> pages;
+  CachePageList unpinned;
+  uint64_t hits = 0;
+  uint64_t misses = 0;
+  uint64_t evictions = 0;
+
+  int64_t page_bytes() const {
+    return sizeof(CachePage) + page_size + extra_size;
+  }
+};
+
+static bool enabled = false;
+// Guards everything below: the caches of different connections, possibly on
+// different threads, share the LRU list and the budget.
+static Mutex mutex;
+static int64_t budget = 0;
+static int64_t used_bytes = 0;
+static int64_t unpurgeable_bytes = 0;
+static GlobalPageList lru;
+static LocalVector<PageCache *> caches;
+// Stats of the destroyed caches, so the totals never go back.
+static uint64_t retired_hits = 0;
+static uint64_t retired_misses = 0;
+static uint64_t retired_evictions = 0;
+
+static thread_local const void *scope_owner = nullptr;
+static thread_local const String *scope_name = nullptr;
+
+static void page_discard(CachePage *p_page) {
+  PageCache *cache = p_page->cache;
+  if (cache->purgeable) {
+    if (!p_page->pinned) {
+      lru.remove(p_page);
+      cache->unpinned.remove(p_page);
+    }
+    used_bytes -= cache->page_bytes();
+  } else {
+    unpurgeable_bytes -= cache->page_bytes();
+  }
+  cache->pages.erase(p_page->key);
+  memfree(p_page);
+}
+
+static void page_evict(CachePage *p_page) {
+  p_page->cache->evictions += 1;
+  page_discard(p_page);
+}
+
+static bool cache_is_full(const PageCache *p_cache) {
+  return p_cache->max_pages > 0 && p_cache->pages.size() >= p_cache->max_pages;
+}
+
+static bool budget_is_exceeded(int64_t p_extra_bytes) {
+  return budget > 0 && used_bytes + p_extra_bytes > budget;
+}
+
+static void enforce_limits(PageCache *p_cache) {
+  while (p_cache->max_pages > 0 &&
+         p_cache->pages.size() > p_cache->max_pages &&
+         p_cache->unpinned.last != nullptr) {
+    page_evict(p_cache->unpinned.last);
+  }
+  while (budget_is_exceeded(0) && lru.last != nullptr) {
+    page_evict(lru.last);
+  }
+}
+
+static int pcache_init(void *p_arg) { return SQLITE_OK; }
+
+static void pcache_shutdown(void *p_arg) {}
+
+static sqlite3_pcache *pcache_create(int p_page_size, int p_extra_size,
+                                     int p_purgeable) {
+  PageCache *cache = memnew(PageCache);
+  cache->page_size = p_page_size;
+  cache->extra_size = p_extra_size;
+  cache->purgeable = p_purgeable != 0;
+  cache->owner = scope_owner;
+  if (scope_name != nullptr) {
+    cache->name = *scope_name;
+  }
+
+  MutexLock lock(mutex);
+  caches.push_back(cache);
+  return reinterpret_cast<sqlite3_pcache *>(cache);
+}
+
+static void pcache_cachesize(sqlite3_pcache *p_cache, int p_max_pages) {
+  PageCache *cache = reinterpret_cast<PageCache *>(p_cache);
+  MutexLock lock(mutex);
+  cache->max_pages = MAX(p_max_pages, 0);
+  if (cache->purgeable) {
+    enforce_limits(cache);
+  }
+}
+
+static int pcache_pagecount(sqlite3_pcache *p_cache) {
+  PageCache *cache = reinterpret_cast<PageCache *>(p_cache);
+  MutexLock lock(mutex);
+  return cache->pages.size();
+}
+
+static sqlite3_pcache_page *pcache_fetch(sqlite3_pcache *p_cache,
+                                         unsigned p_key, int p_create) {
+  PageCache *cache = reinterpret_cast<PageCache *>(p_cache);
+  MutexLock lock(mutex);
+
+  CachePage **found = cache->pages.getptr(p_key);
+  if (found != nullptr) {
+    CachePage *page = *found;
+    cache->hits += 1;
+    if (!page->pinned) {
+      if (cache->purgeable) {
+        lru.remove(page);
+        cache->unpinned.remove(page);
+      }
+      page->pinned = true;
+    }
+    return &page->base;
+  }
+
+  if (p_create == 0) {
+    cache->misses += 1;
+    return nullptr;
+  }
+
+  const int64_t bytes = cache->page_bytes();
+  if (cache->purgeable) {
+    // Make room by evicting the least recently used page of this cache when
+    // it's full, then of any cache while over budget.
+    if (cache_is_full(cache) && cache->unpinned.last != nullptr) {
+      page_evict(cache->unpinned.last);
+    }
+    while (budget_is_exceeded(bytes) && lru.last != nullptr) {
+      page_evict(lru.last);
+    }
+    // Everything left is pinned. SQLite spills its dirty pages and asks
+    // again with `p_create == 2`, which must allocate if at all possible.
+    if (p_create == 1 && (cache_is_full(cache) || budget_is_exceeded(bytes))) {
+      return nullptr;
+    }
+  }
+
+  void *memory = memalloc(bytes);
+  if (memory == nullptr) {
+    return nullptr;
+  }
+  CachePage *page = memnew_placement(memory, CachePage);
+  page->base.pBuf = reinterpret_cast<uint8_t *>(page + 1);
+  page->base.pExtra = static_cast<uint8_t *>(page->base.pBuf) +
+                      cache->page_size;
+  // SQLite expects a zeroed extra area on new pages.
+  memset(page->base.pExtra, 0, cache->extra_size);
+  page->cache = cache;
+  page->key = p_key;
+
+  cache->pages.insert(p_key, page);
+  cache->misses += 1;
+  if (cache->purgeable) {
+    used_bytes += bytes;
+  } else {
+    unpurgeable_bytes += bytes;
+  }
+  return &page->base;
+}
+
+static void pcache_unpin(sqlite3_pcache *p_cache, sqlite3_pcache_page *p_page,
+                         int p_discard) {
+  PageCache *cache = reinterpret_cast<PageCache *>(p_cache);
+  CachePage *page = reinterpret_cast<CachePage *>(p_page);
+  MutexLock lock(mutex);
+
+  if (p_discard) {
+    page_discard(page);
+    return;
+  }
+  page->pinned = false;
+  if (cache->purgeable) {
+    lru.push_front(page);
+    cache->unpinned.push_front(page);
+    enforce_limits(cache);
+  }
+}
+
+static void pcache_rekey(sqlite3_pcache *p_cache, sqlite3_pcache_page *p_page,
+                         unsigned p_old_key, unsigned p_new_key) {
+  PageCache *cache = reinterpret_cast<PageCache *>(p_cache);
+  CachePage *page = reinterpret_cast<CachePage *>(p_page);
+  MutexLock lock(mutex);
+
+  // A page already using the new key is never pinned, and is dropped.
+  CachePage **existing = cache->pages.getptr(p_new_key);
+  if (existing != nullptr) {
+    page_discard(*existing);
+  }
+  cache->pages.erase(p_old_key);
+  page->key = p_new_key;
+  cache->pages.insert(p_new_key, page);
+}
+
+static void pcache_truncate(sqlite3_pcache *p_cache, unsigned p_limit) {
+  PageCache *cache = reinterpret_cast<PageCache *>(p_cache);
+  MutexLock lock(mutex);
+
+  LocalVector<CachePage *> truncated;
+  for (const KeyValue<unsigned, CachePage *> &E : cache->pages) {
+    if (E.key >= p_limit) {
+      truncated.push_back(E.value);
+    }
+  }
+  for (CachePage *page : truncated) {
+    page_discard(page);
+  }
+}
+
+static void pcache_destroy(sqlite3_pcache *p_cache) {
+  PageCache *cache = reinterpret_cast<PageCache *>(p_cache);
+  {
+    MutexLock lock(mutex);
+    while (!cache->pages.is_empty()) {
+      page_discard(cache->pages.begin()->value);
+    }
+    retired_hits += cache->hits;
+    retired_misses += cache->misses;
+    retired_evictions += cache->evictions;
+    caches.erase(cache);
+  }
+  memdelete(cache);
+}
+
+static void pcache_shrink(sqlite3_pcache *p_cache) {
+  PageCache *cache = reinterpret_cast<PageCache *>(p_cache);
+  MutexLock lock(mutex);
+  while (cache->unpinned.last != nullptr) {
+    page_evict(cache->unpinned.last);
+  }
+}
+
+static const sqlite3_pcache_methods2 pcache_methods = {
+    1,                // iVersion
+    nullptr,          // pArg
+    pcache_init,      // xInit
+    pcache_shutdown,  // xShutdown
+    pcache_create,    // xCreate
+    pcache_cachesize, // xCachesize
+    pcache_pagecount, // xPagecount
+    pcache_fetch,     // xFetch
+    pcache_unpin,     // xUnpin
+    pcache_rekey,     // xRekey
+    pcache_truncate,  // xTruncate
+    pcache_destroy,   // xDestroy
+    pcache_shrink,    // xShrink
+};
+
+bool sqlite_pcache_configure(int64_t p_budget) {
+  ERR_FAIL_COND_V_MSG(p_budget < 0, false,
+                      "The page cache budget can't be negative.");
+  const int result = sqlite3_config(SQLITE_CONFIG_PCACHE2, &pcache_methods);
+  ERR_FAIL_COND_V_MSG(result != SQLITE_OK, false,
+                      "SQLite was initialized before the shared page cache "
+                      "could be installed.");
+  budget = p_budget;
+  enabled = true;
+  return true;
+}
+
+bool sqlite_pcache_is_enabled() { return enabled; }
+
+void sqlite_pcache_set_budget(int64_t p_budget) {
+  ERR_FAIL_COND_MSG(!enabled, "The shared page cache is disabled.");
+  ERR_FAIL_COND_MSG(p_budget < 0, "The page cache budget can't be negative.");
+  MutexLock lock(mutex);
+  budget = p_budget;
+  while (budget_is_exceeded(0) && lru.last != nullptr) {
+    page_evict(lru.last);
+  }
+}
+
+int64_t sqlite_pcache_get_budget() {
+  MutexLock lock(mutex);
+  return budget;
+}
+
+static Dictionary cache_stats(const PageCache *p_cache) {
+  Dictionary stats;
+  stats["name"] = p_cache->name;
+  stats["purgeable"] = p_cache->purgeable;
+  stats["pages"] = p_cache->pages.size();
+  stats["bytes"] = int64_t(p_cache->pages.size()) * p_cache->page_bytes();
+  stats["hits"] = p_cache->hits;
+  stats["misses"] = p_cache->misses;
+  stats["evictions"] = p_cache->evictions;
+  return stats;
+}
+
+Dictionary sqlite_pcache_global_stats() {
+  Dictionary stats;
+  stats["enabled"] = enabled;
+  MutexLock lock(mutex);
+
+  uint64_t hits = retired_hits;
+  uint64_t misses = retired_misses;
+  uint64_t evictions = retired_evictions;
+  int64_t pages = 0;
+  Array databases;
+  for (const PageCache *cache : caches) {
+    hits += cache->hits;
+    misses += cache->misses;
+    evictions += cache->evictions;
+    pages += cache->pages.size();
+    databases.push_back(cache_stats(cache));
+  }
+
+  stats["budget"] = budget;
+  stats["used"] = used_bytes;
+  stats["unpurgeable"] = unpurgeable_bytes;
+  stats["pages"] = pages;
+  stats["hits"] = hits;
+  stats["misses"] = misses;
+  stats["evictions"] = evictions;
+  stats["databases"] = databases;
+  return stats;
+}
+
+Dictionary sqlite_pcache_owner_stats(const void *p_owner) {
+  MutexLock lock(mutex);
+  int64_t pages = 0;
+  int64_t bytes = 0;
+  uint64_t hits = 0;
+  uint64_t misses = 0;
+  uint64_t evictions = 0;
+  for (const PageCache *cache : caches) {
+    if (cache->owner != p_owner) {
+      continue;
+    }
+    pages += cache->pages.size();
+    bytes += int64_t(cache->pages.size()) * cache->page_bytes();
+    hits += cache->hits;
+    misses += cache->misses;
+    evictions += cache->evictions;
+  }
+
+  Dictionary stats;
+  stats["pages"] = pages;
+  stats["bytes"] = bytes;
+  stats["hits"] = hits;
+  stats["misses"] = misses;
+  stats["evictions"] = evictions;
+  return stats;
+}
+
+SQLitePageCacheScope::SQLitePageCacheScope(const void *p_owner,
+                                           const String &p_name) {
+  previous_owner = scope_owner;
+  previous_name = scope_name;
+  scope_owner = p_owner;
+  scope_name = &p_name;
+}
+
+SQLitePageCacheScope::~SQLitePageCacheScope() {
+  scope_owner = previous_owner;
+  scope_name = previous_name;
+}
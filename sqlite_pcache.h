@@ -0,0 +1,35 @@
+#ifndef GDSQLITE_PCACHE_H
+#define GDSQLITE_PCACHE_H
+
+#include "core/string/ustring.h"
+#include "core/variant/dictionary.h"
+
+/// Installs a page cache shared by every connection, holding at most
+/// `p_budget` bytes of pages: when it's full, the least recently used page of
+/// any database is evicted. Must be called before SQLite is initialized.
+bool sqlite_pcache_configure(int64_t p_budget);
+
+bool sqlite_pcache_is_enabled();
+
+/// Changes the budget, evicting pages right away when it shrinks.
+void sqlite_pcache_set_budget(int64_t p_budget);
+int64_t sqlite_pcache_get_budget();
+
+/// Usage of the whole cache, with the stats of each database in `databases`.
+Dictionary sqlite_pcache_global_stats();
+
+/// Hits, misses and evictions of the caches created for `p_owner`.
+Dictionary sqlite_pcache_owner_stats(const void *p_owner);
+
+/// While alive, the caches SQLite creates on this thread are attributed to
+/// `p_owner`, so their stats can be reported per database.
+class SQLitePageCacheScope {
+  const void *previous_owner;
+  const String *previous_name;
+
+public:
+  SQLitePageCacheScope(const void *p_owner, const String &p_name);
+  ~SQLitePageCacheScope();
+};
+
+#endif
@@ -0,0 +1,260 @@
+#include "sqlite_result_cache.h"
+
+#include "core/templates/hashfuncs.h"
+#include "core/variant/variant.h"
+
+// Approximate memory held by a result, Variants and their heap data.
+static int64_t estimate_size(const Variant &p_value) {
+  int64_t size = sizeof(Variant);
+  switch (p_value.get_type()) {
+  case Variant::STRING:
+    size += int64_t(String(p_value).length() + 1) * sizeof(char32_t) + 16;
+    break;
+  case Variant::PACKED_BYTE_ARRAY:
+    size += PackedByteArray(p_value).size() + 16;
+    break;
+  case Variant::ARRAY: {
+    const Array array = p_value;
+    size += 32;
+    for (int i = 0; i < array.size(); i++) {
+      size += estimate_size(array[i]);
+    }
+  } break;
+  default:
+    break;
+  }
+  return size;
+}
+
+bool SQLiteResultCache::KeyComparator::compare(const Key &p_a,
+                                               const Key &p_b) {
+  if (p_a.query_id != p_b.query_id ||
+      p_a.arguments.size() != p_b.arguments.size()) {
+    return false;
+  }
+  for (int i = 0; i < p_a.arguments.size(); i++) {
+    if (!p_a.arguments[i].hash_compare(p_b.arguments[i])) {
+      return false;
+    }
+  }
+  return true;
+}
+
+SQLiteResultCache::Key SQLiteResultCache::make_key(uint64_t p_query_id,
+                                                   const Array &p_arguments) {
+  Key key;
+  key.query_id = p_query_id;
+  key.arguments = p_arguments;
+  key.hash = hash_murmur3_one_64(p_query_id);
+  for (int i = 0; i < p_arguments.size(); i++) {
+    key.hash = hash_murmur3_one_32(p_arguments[i].hash(), key.hash);
+  }
+  key.hash = hash_fmix32(key.hash);
+  return key;
+}
+
+uint32_t SQLiteResultCache::track_table(const char *p_schema,
+                                        const char *p_name) {
+  for (uint32_t i = 0; i < tables.size(); i++) {
+    if (strcmp(tables[i].name.get_data(), p_name) == 0 &&
+        strcmp(tables[i].schema.get_data(), p_schema) == 0) {
+      return i;
+    }
+  }
+  Table table;
+  table.schema = p_schema;
+  table.name = p_name;
+  tables.push_back(table);
+  return tables.size() - 1;
+}
+
+const char *SQLiteResultCache::get_table_schema(uint32_t p_index) const {
+  ERR_FAIL_UNSIGNED_INDEX_V(p_index, tables.size(), "");
+  return tables[p_index].schema.get_data();
+}
+
+const char *SQLiteResultCache::get_table_name(uint32_t p_index) const {
+  ERR_FAIL_UNSIGNED_INDEX_V(p_index, tables.size(), "");
+  return tables[p_index].name.get_data();
+}
+
+SQLiteResultCache::TableKind
+SQLiteResultCache::get_table_kind(uint32_t p_index) const {
+  ERR_FAIL_UNSIGNED_INDEX_V(p_index, tables.size(), TABLE_UNTRACKED);
+  return tables[p_index].kind;
+}
+
+void SQLiteResultCache::set_table_kind(uint32_t p_index, TableKind p_kind) {
+  ERR_FAIL_UNSIGNED_INDEX(p_index, tables.size());
+  tables[p_index].kind = p_kind;
+}
+
+void SQLiteResultCache::table_changed(const char *p_schema,
+                                      const char *p_name) {
+  // A few tables at most: a scan is cheaper than hashing the name.
+  for (Table &table : tables) {
+    if (strcmp(table.name.get_data(), p_name) == 0 &&
+        strcmp(table.schema.get_data(), p_schema) == 0) {
+      table.generation += 1;
+      return;
+    }
+  }
+}
+
+void SQLiteResultCache::invalidate_all() { generation += 1; }
+
+bool SQLiteResultCache::is_valid(const Entry *p_entry) const {
+  if (p_entry->generation != generation) {
+    return false;
+  }
+  for (const Pair<uint32_t, uint64_t> &table : p_entry->tables) {
+    if (tables[table.first].generation != table.second) {
+      return false;
+    }
+  }
+  return true;
+}
+
+bool SQLiteResultCache::lookup(uint64_t p_query_id, const Array &p_arguments,
+                               Array &r_result) {
+  HashMap<Key, Entry *, KeyHasher, KeyComparator>::Iterator E =
+      entries.find(make_key(p_query_id, p_arguments));
+  if (!E) {
+    misses += 1;
+    return false;
+  }
+  Entry *entry = E->value;
+  if (!is_valid(entry)) {
+    invalidations += 1;
+    misses += 1;
+    remove(entry);
+    return false;
+  }
+
+  // Moves the entry first.
+  if (entry != first) {
+    entry->prev->next = entry->next;
+    if (entry->next != nullptr) {
+      entry->next->prev = entry->prev;
+    } else {
+      last = entry->prev;
+    }
+    entry->prev = nullptr;
+    entry->next = first;
+    first->prev = entry;
+    first = entry;
+  }
+
+  hits += 1;
+  // A copy: the caller may sort or edit the rows.
+  r_result = entry->result.duplicate(true);
+  return true;
+}
+
+void SQLiteResultCache::store(uint64_t p_query_id, const Array &p_arguments,
+                              const Array &p_result,
+                              const LocalVector<uint32_t> &p_tables) {
+  Key key = make_key(p_query_id, p_arguments);
+  // The arguments must not change with the caller's Array.
+  key.arguments = p_arguments.duplicate(true);
+
+  HashMap<Key, Entry *, KeyHasher, KeyComparator>::Iterator E =
+      entries.find(key);
+  if (E) {
+    remove(E->value);
+  }
+
+  const int64_t entry_size = sizeof(Entry) + estimate_size(p_result) +
+                             estimate_size(p_arguments);
+  if (entry_size > budget) {
+    return;
+  }
+
+  Entry *entry = memnew(Entry);
+  entry->key = key;
+  // The stored rows are returned to the caller as well.
+  entry->result = p_result.duplicate(true);
+  entry->generation = generation;
+  entry->size = entry_size;
+  for (uint32_t table : p_tables) {
+    ERR_CONTINUE(table >= tables.size());
+    entry->tables.push_back(
+        Pair<uint32_t, uint64_t>(table, tables[table].generation));
+  }
+  entry->next = first;
+  if (first != nullptr) {
+    first->prev = entry;
+  } else {
+    last = entry;
+  }
+  first = entry;
+  entries.insert(key, entry);
+  size += entry_size;
+  evict();
+}
+
+void SQLiteResultCache::remove(Entry *p_entry) {
+  if (p_entry->prev != nullptr) {
+    p_entry->prev->next = p_entry->next;
+  } else {
+    first = p_entry->next;
+  }
+  if (p_entry->next != nullptr) {
+    p_entry->next->prev = p_entry->prev;
+  } else {
+    last = p_entry->prev;
+  }
+  size -= p_entry->size;
+  entries.erase(p_entry->key);
+  memdelete(p_entry);
+}
+
+void SQLiteResultCache::evict() {
+  while (size > budget && last != nullptr) {
+    remove(last);
+    evictions += 1;
+  }
+}
+
+void SQLiteResultCache::remove_query(uint64_t p_query_id) {
+  Entry *entry = first;
+  while (entry != nullptr) {
+    Entry *next = entry->next;
+    if (entry->key.query_id == p_query_id) {
+      remove(entry);
+    }
+    entry = next;
+  }
+}
+
+void SQLiteResultCache::set_budget(int64_t p_bytes) {
+  budget = MAX(int64_t(0), p_bytes);
+  evict();
+}
+
+Dictionary SQLiteResultCache::get_stats() const {
+  Dictionary stats;
+  stats["hits"] = hits;
+  stats["misses"] = misses;
+  stats["hit_rate"] = hits + misses > 0 ? double(hits) / (hits + misses) : 0.0;
+  stats["invalidations"] = invalidations;
+  stats["evictions"] = evictions;
+  stats["entries"] = entries.size();
+  stats["size"] = size;
+  stats["budget"] = budget;
+  return stats;
+}
+
+void SQLiteResultCache::clear() {
+  while (first != nullptr) {
+    remove(first);
+  }
+  generation += 1;
+}
+
+void SQLiteResultCache::reset() {
+  clear();
+  tables.clear();
+}
+
+SQLiteResultCache::~SQLiteResultCache() { clear(); }
@@ -0,0 +1,108 @@
+#ifndef GDSQLITE_RESULT_CACHE_H
+#define GDSQLITE_RESULT_CACHE_H
+
+#include "core/string/ustring.h"
+#include "core/templates/hash_map.h"
+#include "core/templates/local_vector.h"
+#include "core/templates/pair.h"
+#include "core/variant/array.h"
+#include "core/variant/dictionary.h"
+
+/// Results of the queries executed with `cache_results`, keyed by query and
+/// arguments. An entry remembers the generation of each table it read, and
+/// is dropped once any of them changed. Bounded by a budget in bytes, the
+/// least recently used entries are evicted first.
+class SQLiteResultCache {
+public:
+  enum TableKind {
+    TABLE_UNCHECKED,
+    // Changes are reported by the update hook.
+    TABLE_TRACKED,
+    // Virtual or WITHOUT ROWID: the update hook doesn't report its changes.
+    TABLE_UNTRACKED,
+  };
+
+private:
+  struct Table {
+    CharString schema;
+    CharString name;
+    uint64_t generation = 0;
+    TableKind kind = TABLE_UNCHECKED;
+  };
+
+  struct Key {
+    uint64_t query_id = 0;
+    Array arguments;
+    uint32_t hash = 0;
+  };
+
+  struct KeyHasher {
+    static uint32_t hash(const Key &p_key) { return p_key.hash; }
+  };
+
+  struct KeyComparator {
+    static bool compare(const Key &p_a, const Key &p_b);
+  };
+
+  struct Entry {
+    Key key;
+    Array result;
+    // Table index and its generation when the result was stored.
+    LocalVector<Pair<uint32_t, uint64_t>> tables;
+    uint64_t generation = 0;
+    int64_t size = 0;
+    // Most recently used first.
+    Entry *prev = nullptr;
+    Entry *next = nullptr;
+  };
+
+  LocalVector<Table> tables;
+  // Bumped when every entry must be dropped.
+  uint64_t generation = 0;
+
+  HashMap<Key, Entry *, KeyHasher, KeyComparator> entries;
+  Entry *first = nullptr;
+  Entry *last = nullptr;
+
+  int64_t budget = 8 * 1024 * 1024;
+  int64_t size = 0;
+  uint64_t hits = 0;
+  uint64_t misses = 0;
+  uint64_t invalidations = 0;
+  uint64_t evictions = 0;
+
+  static Key make_key(uint64_t p_query_id, const Array &p_arguments);
+  bool is_valid(const Entry *p_entry) const;
+  void remove(Entry *p_entry);
+  void evict();
+
+public:
+  /// Returns the index of the table, added the first time.
+  uint32_t track_table(const char *p_schema, const char *p_name);
+  const char *get_table_schema(uint32_t p_index) const;
+  const char *get_table_name(uint32_t p_index) const;
+  TableKind get_table_kind(uint32_t p_index) const;
+  void set_table_kind(uint32_t p_index, TableKind p_kind);
+
+  /// Called by the update hook.
+  void table_changed(const char *p_schema, const char *p_name);
+  /// Drops every entry, lazily.
+  void invalidate_all();
+
+  bool lookup(uint64_t p_query_id, const Array &p_arguments,
+              Array &r_result);
+  void store(uint64_t p_query_id, const Array &p_arguments,
+             const Array &p_result, const LocalVector<uint32_t> &p_tables);
+  void remove_query(uint64_t p_query_id);
+
+  void set_budget(int64_t p_bytes);
+  int64_t get_budget() const { return budget; }
+  Dictionary get_stats() const;
+  void clear();
+  /// Also forgets the tables, when the database is closed.
+  void reset();
+
+  ~SQLiteResultCache();
+};
+
+#endif
@@ -0,0 +1,118 @@
+#include "sqlite_script.h"
+
+#include "sqlite.h"
+
+SQLiteCompiledScript::SQLiteCompiledScript() {}
+
+SQLiteCompiledScript::~SQLiteCompiledScript() { finalize(); }
+
+void SQLiteCompiledScript::init(SQLite *p_db, const String &p_sql) {
+  finalize();
+  db = p_db;
+  sql = p_sql.utf8();
+}
+
+bool SQLiteCompiledScript::prepare_next(sqlite3 *p_handle) {
+  // Skips the whitespace and the comments, which give no statement.
+  while (tail < uint32_t(sql.length())) {
+    const char *begin = sql.get_data() + tail;
+    const char *next = nullptr;
+    sqlite3_stmt *stmt = nullptr;
+    const int result =
+        sqlite3_prepare_v3(p_handle, begin, sql.length() - tail,
+                           SQLITE_PREPARE_PERSISTENT, &stmt, &next);
+    if (result != SQLITE_OK) {
+      return false;
+    }
+    tail = next - sql.get_data();
+    if (stmt != nullptr) {
+      statements.push_back(stmt);
+      return true;
+    }
+  }
+  return true;
+}
+
+bool SQLiteCompiledScript::fail(sqlite3 *p_handle, const String &p_error,
+                                bool p_transaction) {
+  error = p_error;
+  if (p_transaction) {
+    // Fails harmlessly when the failed statement already rolled back the
+    // whole transaction, savepoint included.
+    sqlite3_exec(p_handle,
+                 "ROLLBACK TO execute_script; RELEASE execute_script;",
+                 nullptr, nullptr, nullptr);
+  }
+  ERR_FAIL_V_MSG(false, "SQL Error: " + error);
+}
+
+bool SQLiteCompiledScript::run(bool p_transaction) {
+  ERR_FAIL_COND_V_MSG(db == nullptr, false, "The database has been freed.");
+  sqlite3 *handle = db->get_handler();
+  ERR_FAIL_COND_V_MSG(handle == nullptr, false,
+                      "Cannot run the script! Database is not opened.");
+  error = String();
+
+  if (p_transaction && sqlite3_exec(handle, "SAVEPOINT execute_script;",
+                                    nullptr, nullptr, nullptr) != SQLITE_OK) {
+    error = sqlite3_errmsg(handle);
+    ERR_FAIL_V_MSG(false, "SQL Error: " + error);
+  }
+
+  for (uint32_t i = 0;; i++) {
+    if (i == statements.size()) {
+      if (!prepare_next(handle)) {
+        return fail(handle, sqlite3_errmsg(handle), p_transaction);
+      }
+      if (i == statements.size()) {
+        // The end of the script.
+        break;
+      }
+    }
+
+    sqlite3_stmt *stmt = statements[i];
+    int result;
+    do {
+      result = sqlite3_step(stmt);
+    } while (result == SQLITE_ROW);
+
+    if (result != SQLITE_DONE) {
+      // The message is lost once the statement is reset.
+      const String message = sqlite3_errmsg(handle);
+      sqlite3_reset(stmt);
+      db->discard_statement_changes();
+      return fail(handle, message, p_transaction);
+    }
+    sqlite3_reset(stmt);
+  }
+
+  if (p_transaction && sqlite3_exec(handle, "RELEASE execute_script;",
+                                    nullptr, nullptr, nullptr) != SQLITE_OK) {
+    return fail(handle, sqlite3_errmsg(handle), p_transaction);
+  }
+  return true;
+}
+
+int SQLiteCompiledScript::get_statement_count() const {
+  return statements.size();
+}
+
+String SQLiteCompiledScript::get_last_error_message() const { return error; }
+
+void SQLiteCompiledScript::finalize() {
+  for (sqlite3_stmt *stmt : statements) {
+    sqlite3_finalize(stmt);
+  }
+  statements.clear();
+  tail = 0;
+}
+
+void SQLiteCompiledScript::_bind_methods() {
+  ClassDB::bind_method(D_METHOD("run", "transaction"),
+                       &SQLiteCompiledScript::run, DEFVAL(true));
+  ClassDB::bind_method(D_METHOD("get_statement_count"),
+                       &SQLiteCompiledScript::get_statement_count);
+  ClassDB::bind_method(D_METHOD("get_last_error_message"),
+                       &SQLiteCompiledScript::get_last_error_message);
+  ClassDB::bind_method(D_METHOD("finalize"), &SQLiteCompiledScript::finalize);
+}
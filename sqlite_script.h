@@ -0,0 +1,52 @@
+#ifndef GDSQLITE_SCRIPT_H
+#define GDSQLITE_SCRIPT_H
+
+#include "core/object/ref_counted.h"
+#include "core/templates/local_vector.h"
+
+#include "thirdparty/sqlite/sqlite3.h"
+
+class SQLite;
+
+/// A SQL script of many statements, kept prepared to be run again without
+/// parsing it. The statements are prepared one at a time, during the first
+/// run, right before being executed: a statement can use the tables created
+/// by the previous ones.
+class SQLiteCompiledScript : public RefCounted {
+  GDCLASS(SQLiteCompiledScript, RefCounted);
+
+  SQLite *db = nullptr;
+  CharString sql;
+  // Offset of the first statement not prepared yet.
+  uint32_t tail = 0;
+  LocalVector<sqlite3_stmt *> statements;
+  String error;
+
+  bool prepare_next(sqlite3 *p_handle);
+  bool fail(sqlite3 *p_handle, const String &p_error, bool p_transaction);
+
+protected:
+  static void _bind_methods();
+
+public:
+  SQLiteCompiledScript();
+  ~SQLiteCompiledScript();
+
+  void init(SQLite *p_db, const String &p_sql);
+
+  /// Executes every statement of the script, discarding the rows. With
+  /// `p_transaction` the script runs in a savepoint and nothing is changed
+  /// when a statement fails; disable it for scripts which handle their
+  /// transactions, or contain `VACUUM`.
+  bool run(bool p_transaction = true);
+
+  /// The number of statements prepared so far.
+  int get_statement_count() const;
+  String get_last_error_message() const;
+
+  /// Releases the statements, which are prepared again by the next run.
+  /// Automatically called when the database is closed.
+  void finalize();
+};
+
+#endif
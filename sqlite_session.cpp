@@ -0,0 +1,140 @@
+#include "sqlite_session.h"
+
+#include "sqlite.h"
+
+// Moves a buffer allocated by SQLite into a PackedByteArray.
+static PackedByteArray take_sqlite_buffer(int p_size, void *p_buffer) {
+  PackedByteArray bytes;
+  if (p_size > 0) {
+    bytes.resize(p_size);
+    memcpy(bytes.ptrw(), p_buffer, p_size);
+  }
+  sqlite3_free(p_buffer);
+  return bytes;
+}
+
+SQLiteSession::SQLiteSession() {}
+
+SQLiteSession::~SQLiteSession() { close(); }
+
+void SQLiteSession::init(SQLite *p_db, sqlite3_session *p_session) {
+  db = p_db;
+  session = p_session;
+}
+
+bool SQLiteSession::is_open() const { return session != nullptr; }
+
+bool SQLiteSession::attach(String p_table) {
+  ERR_FAIL_COND_V_MSG(session == nullptr, false, "The session is closed.");
+  int result;
+  if (p_table.is_empty()) {
+    result = sqlite3session_attach(session, nullptr);
+  } else {
+    result = sqlite3session_attach(session, p_table.utf8().get_data());
+  }
+  ERR_FAIL_COND_V_MSG(result != SQLITE_OK, false,
+                      "Cannot attach the table to the session: " +
+                          db->get_last_error_message());
+  return true;
+}
+
+void SQLiteSession::set_enabled(bool p_enabled) {
+  ERR_FAIL_COND_MSG(session == nullptr, "The session is closed.");
+  sqlite3session_enable(session, p_enabled ? 1 : 0);
+}
+
+bool SQLiteSession::is_enabled() const {
+  ERR_FAIL_COND_V_MSG(session == nullptr, false, "The session is closed.");
+  return sqlite3session_enable(session, -1) != 0;
+}
+
+void SQLiteSession::set_indirect(bool p_indirect) {
+  ERR_FAIL_COND_MSG(session == nullptr, "The session is closed.");
+  sqlite3session_indirect(session, p_indirect ? 1 : 0);
+}
+
+bool SQLiteSession::is_indirect() const {
+  ERR_FAIL_COND_V_MSG(session == nullptr, false, "The session is closed.");
+  return sqlite3session_indirect(session, -1) != 0;
+}
+
+bool SQLiteSession::is_empty() const {
+  ERR_FAIL_COND_V_MSG(session == nullptr, true, "The session is closed.");
+  return sqlite3session_isempty(session) != 0;
+}
+
+PackedByteArray SQLiteSession::get_changeset() {
+  ERR_FAIL_COND_V_MSG(session == nullptr, PackedByteArray(),
+                      "The session is closed.");
+  int size = 0;
+  void *buffer = nullptr;
+  const int result = sqlite3session_changeset(session, &size, &buffer);
+  ERR_FAIL_COND_V_MSG(result != SQLITE_OK, PackedByteArray(),
+                      "Cannot create the changeset, error: " + itos(result));
+  return take_sqlite_buffer(size, buffer);
+}
+
+PackedByteArray SQLiteSession::get_patchset() {
+  ERR_FAIL_COND_V_MSG(session == nullptr, PackedByteArray(),
+                      "The session is closed.");
+  int size = 0;
+  void *buffer = nullptr;
+  const int result = sqlite3session_patchset(session, &size, &buffer);
+  ERR_FAIL_COND_V_MSG(result != SQLITE_OK, PackedByteArray(),
+                      "Cannot create the patchset, error: " + itos(result));
+  return take_sqlite_buffer(size, buffer);
+}
+
+void SQLiteSession::close() {
+  if (session) {
+    sqlite3session_delete(session);
+    session = nullptr;
+  }
+}
+
+PackedByteArray SQLiteSession::concat_changesets(PackedByteArray p_a,
+                                                 PackedByteArray p_b) {
+  int size = 0;
+  void *buffer = nullptr;
+  const int result =
+      sqlite3changeset_concat(p_a.size(), (void *)p_a.ptr(), p_b.size(),
+                              (void *)p_b.ptr(), &size, &buffer);
+  ERR_FAIL_COND_V_MSG(result != SQLITE_OK, PackedByteArray(),
+                      "Cannot concatenate the changesets, error: " +
+                          itos(result));
+  return take_sqlite_buffer(size, buffer);
+}
+
+PackedByteArray SQLiteSession::invert_changeset(PackedByteArray p_changeset) {
+  int size = 0;
+  void *buffer = nullptr;
+  const int result = sqlite3changeset_invert(
+      p_changeset.size(), p_changeset.ptr(), &size, &buffer);
+  ERR_FAIL_COND_V_MSG(result != SQLITE_OK, PackedByteArray(),
+                      "Cannot invert the changeset, error: " + itos(result));
+  return take_sqlite_buffer(size, buffer);
+}
+
+void SQLiteSession::_bind_methods() {
+  ClassDB::bind_method(D_METHOD("is_open"), &SQLiteSession::is_open);
+  ClassDB::bind_method(D_METHOD("attach", "table"), &SQLiteSession::attach,
+                       DEFVAL(""));
+  ClassDB::bind_method(D_METHOD("set_enabled", "enabled"),
+                       &SQLiteSession::set_enabled);
+  ClassDB::bind_method(D_METHOD("is_enabled"), &SQLiteSession::is_enabled);
+  ClassDB::bind_method(D_METHOD("set_indirect", "indirect"),
+                       &SQLiteSession::set_indirect);
+  ClassDB::bind_method(D_METHOD("is_indirect"), &SQLiteSession::is_indirect);
+  ClassDB::bind_method(D_METHOD("is_empty"), &SQLiteSession::is_empty);
+  ClassDB::bind_method(D_METHOD("get_changeset"),
+                       &SQLiteSession::get_changeset);
+  ClassDB::bind_method(D_METHOD("get_patchset"), &SQLiteSession::get_patchset);
+  ClassDB::bind_method(D_METHOD("close"), &SQLiteSession::close);
+
+  ClassDB::bind_static_method("SQLiteSession",
+                              D_METHOD("concat_changesets", "a", "b"),
+                              &SQLiteSession::concat_changesets);
+  ClassDB::bind_static_method("SQLiteSession",
+                              D_METHOD("invert_changeset", "changeset"),
+                              &SQLiteSession::invert_changeset);
+}
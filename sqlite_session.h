@@ -0,0 +1,59 @@
+#ifndef GDSQLITE_SESSION_H
+#define GDSQLITE_SESSION_H
+
+#include "core/object/ref_counted.h"
+
+#include "thirdparty/sqlite/sqlite3.h"
+
+class SQLite;
+
+/// Records the changes made to a database, to be sent to another database as
+/// a changeset and applied there with `SQLite.apply_changeset()`.
+class SQLiteSession : public RefCounted {
+  GDCLASS(SQLiteSession, RefCounted);
+
+  SQLite *db = nullptr;
+  sqlite3_session *session = nullptr;
+
+protected:
+  static void _bind_methods();
+
+public:
+  SQLiteSession();
+  ~SQLiteSession();
+
+  void init(SQLite *p_db, sqlite3_session *p_session);
+
+  bool is_open() const;
+
+  /// Starts recording the changes of `p_table`, or of every table when empty.
+  /// Only tables with a PRIMARY KEY are recorded.
+  bool attach(String p_table = "");
+
+  void set_enabled(bool p_enabled);
+  bool is_enabled() const;
+
+  /// Changes made while indirect are flagged as such in the changeset.
+  void set_indirect(bool p_indirect);
+  bool is_indirect() const;
+
+  /// Returns true if no change has been recorded.
+  bool is_empty() const;
+
+  /// Returns all the changes recorded so far. A changeset holds both the old
+  /// and the new values of each row, so conflicts can be detected.
+  PackedByteArray get_changeset();
+
+  /// A more compact version of the changeset: only the primary key of
+  /// deleted rows and the new values of updated columns are stored.
+  PackedByteArray get_patchset();
+
+  /// Stops recording. Automatically called when the database is closed.
+  void close();
+
+  static PackedByteArray concat_changesets(PackedByteArray p_a,
+                                           PackedByteArray p_b);
+  static PackedByteArray invert_changeset(PackedByteArray p_changeset);
+};
+
+#endif
@@ -0,0 +1,924 @@
+#include "sqlite_vector.h"
+
+#include "sqlite.h"
+
+#include "core/math/math_funcs.h"
+#include "core/templates/local_vector.h"
+
+#if (defined(__x86_64__) || defined(__i386__)) && \
+    (defined(__GNUC__) || defined(__clang__))
+#define GDSQLITE_VECTOR_AVX2
+#include <immintrin.h>
+#define GDSQLITE_AVX2_TARGET __attribute__((target("avx2,fma")))
+#endif
+
+#if defined(__SSE2__) || defined(_M_X64) || \
+    (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define GDSQLITE_VECTOR_SSE
+#include <xmmintrin.h>
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define GDSQLITE_VECTOR_NEON
+#include <arm_neon.h>
+#endif
+
+// Vectors come straight from SQLite pages, so they are not guaranteed to be
+// aligned: SIMD kernels use unaligned loads and the scalar tails use memcpy.
+static _FORCE_INLINE_ float load_f32(const void *p_ptr, int p_index) {
+  float v;
+  memcpy(&v, static_cast<const uint8_t *>(p_ptr) + p_index * sizeof(float),
+         sizeof(float));
+  return v;
+}
+
+// ------------------------------------------------------------------- Scalar
+
+static float l2_squared_scalar(const void *p_a, const void *p_b, int p_n) {
+  float sum = 0.0f;
+  for (int i = 0; i < p_n; i++) {
+    const float d = load_f32(p_a, i) - load_f32(p_b, i);
+    sum += d * d;
+  }
+  return sum;
+}
+
+static float dot_scalar(const void *p_a, const void *p_b, int p_n) {
+  float sum = 0.0f;
+  for (int i = 0; i < p_n; i++) {
+    sum += load_f32(p_a, i) * load_f32(p_b, i);
+  }
+  return sum;
+}
+
+static void cosine_terms_scalar(const void *p_a, const void *p_b, int p_n,
+                                float &r_dot, float &r_norm_a,
+                                float &r_norm_b) {
+  float dot = 0.0f, norm_a = 0.0f, norm_b = 0.0f;
+  for (int i = 0; i < p_n; i++) {
+    const float a = load_f32(p_a, i);
+    const float b = load_f32(p_b, i);
+    dot += a * b;
+    norm_a += a * a;
+    norm_b += b * b;
+  }
+  r_dot = dot;
+  r_norm_a = norm_a;
+  r_norm_b = norm_b;
+}
+
+// ---------------------------------------------------------------------- SSE
+
+#ifdef GDSQLITE_VECTOR_SSE
+static _FORCE_INLINE_ float hsum_sse(__m128 p_v) {
+  __m128 shuf = _mm_shuffle_ps(p_v, p_v, _MM_SHUFFLE(2, 3, 0, 1));
+  __m128 sums = _mm_add_ps(p_v, shuf);
+  shuf = _mm_movehl_ps(shuf, sums);
+  sums = _mm_add_ss(sums, shuf);
+  return _mm_cvtss_f32(sums);
+}
+
+static float l2_squared_sse(const void *p_a, const void *p_b, int p_n) {
+  const float *a = static_cast<const float *>(p_a);
+  const float *b = static_cast<const float *>(p_b);
+  __m128 acc = _mm_setzero_ps();
+  int i = 0;
+  for (; i + 4 <= p_n; i += 4) {
+    const __m128 d = _mm_sub_ps(_mm_loadu_ps(a + i), _mm_loadu_ps(b + i));
+    acc = _mm_add_ps(acc, _mm_mul_ps(d, d));
+  }
+  float sum = hsum_sse(acc);
+  for (; i < p_n; i++) {
+    const float d = load_f32(p_a, i) - load_f32(p_b, i);
+    sum += d * d;
+  }
+  return sum;
+}
+
+static float dot_sse(const void *p_a, const void *p_b, int p_n) {
+  const float *a = static_cast<const float *>(p_a);
+  const float *b = static_cast<const float *>(p_b);
+  __m128 acc = _mm_setzero_ps();
+  int i = 0;
+  for (; i + 4 <= p_n; i += 4) {
+    acc = _mm_add_ps(acc, _mm_mul_ps(_mm_loadu_ps(a + i), _mm_loadu_ps(b + i)));
+  }
+  float sum = hsum_sse(acc);
+  for (; i < p_n; i++) {
+    sum += load_f32(p_a, i) * load_f32(p_b, i);
+  }
+  return sum;
+}
+
+static void cosine_terms_sse(const void *p_a, const void *p_b, int p_n,
+                             float &r_dot, float &r_norm_a, float &r_norm_b) {
+  const float *a = static_cast<const float *>(p_a);
+  const float *b = static_cast<const float *>(p_b);
+  __m128 dot = _mm_setzero_ps();
+  __m128 norm_a = _mm_setzero_ps();
+  __m128 norm_b = _mm_setzero_ps();
+  int i = 0;
+  for (; i + 4 <= p_n; i += 4) {
+    const __m128 va = _mm_loadu_ps(a + i);
+    const __m128 vb = _mm_loadu_ps(b + i);
+    dot = _mm_add_ps(dot, _mm_mul_ps(va, vb));
+    norm_a = _mm_add_ps(norm_a, _mm_mul_ps(va, va));
+    norm_b = _mm_add_ps(norm_b, _mm_mul_ps(vb, vb));
+  }
+  r_dot = hsum_sse(dot);
+  r_norm_a = hsum_sse(norm_a);
+  r_norm_b = hsum_sse(norm_b);
+  for (; i < p_n; i++) {
+    const float va = load_f32(p_a, i);
+    const float vb = load_f32(p_b, i);
+    r_dot += va * vb;
+    r_norm_a += va * va;
+    r_norm_b += vb * vb;
+  }
+}
+#endif
+
+// --------------------------------------------------------------------- AVX2
+
+#ifdef GDSQLITE_VECTOR_AVX2
+GDSQLITE_AVX2_TARGET static inline float hsum_avx(__m256 p_v) {
+  __m128 v = _mm_add_ps(_mm256_castps256_ps128(p_v),
+                        _mm256_extractf128_ps(p_v, 1));
+  __m128 shuf = _mm_shuffle_ps(v, v, _MM_SHUFFLE(2, 3, 0, 1));
+  __m128 sums = _mm_add_ps(v, shuf);
+  shuf = _mm_movehl_ps(shuf, sums);
+  sums = _mm_add_ss(sums, shuf);
+  return _mm_cvtss_f32(sums);
+}
+
+// Two accumulators hide the FMA latency on 128-d and larger vectors.
+GDSQLITE_AVX2_TARGET static float l2_squared_avx2(const void *p_a,
+                                                  const void *p_b, int p_n) {
+  const float *a = static_cast<const float *>(p_a);
+  const float *b = static_cast<const float *>(p_b);
+  __m256 acc0 = _mm256_setzero_ps();
+  __m256 acc1 = _mm256_setzero_ps();
+  int i = 0;
+  for (; i + 16 <= p_n; i += 16) {
+    const __m256 d0 =
+        _mm256_sub_ps(_mm256_loadu_ps(a + i), _mm256_loadu_ps(b + i));
+    const __m256 d1 =
+        _mm256_sub_ps(_mm256_loadu_ps(a + i + 8), _mm256_loadu_ps(b + i + 8));
+    acc0 = _mm256_fmadd_ps(d0, d0, acc0);
+    acc1 = _mm256_fmadd_ps(d1, d1, acc1);
+  }
+  for (; i + 8 <= p_n; i += 8) {
+    const __m256 d =
+        _mm256_sub_ps(_mm256_loadu_ps(a + i), _mm256_loadu_ps(b + i));
+    acc0 = _mm256_fmadd_ps(d, d, acc0);
+  }
+  float sum = hsum_avx(_mm256_add_ps(acc0, acc1));
+  for (; i < p_n; i++) {
+    const float d = load_f32(p_a, i) - load_f32(p_b, i);
+    sum += d * d;
+  }
+  return sum;
+}
+
+GDSQLITE_AVX2_TARGET static float dot_avx2(const void *p_a, const void *p_b,
+                                           int p_n) {
+  const float *a = static_cast<const float *>(p_a);
+  const float *b = static_cast<const float *>(p_b);
+  __m256 acc0 = _mm256_setzero_ps();
+  __m256 acc1 = _mm256_setzero_ps();
+  int i = 0;
+  for (; i + 16 <= p_n; i += 16) {
+    acc0 = _mm256_fmadd_ps(_mm256_loadu_ps(a + i), _mm256_loadu_ps(b + i),
+                           acc0);
+    acc1 = _mm256_fmadd_ps(_mm256_loadu_ps(a + i + 8),
+                           _mm256_loadu_ps(b + i + 8), acc1);
+  }
+  for (; i + 8 <= p_n; i += 8) {
+    acc0 = _mm256_fmadd_ps(_mm256_loadu_ps(a + i), _mm256_loadu_ps(b + i),
+                           acc0);
+  }
+  float sum = hsum_avx(_mm256_add_ps(acc0, acc1));
+  for (; i < p_n; i++) {
+    sum += load_f32(p_a, i) * load_f32(p_b, i);
+  }
+  return sum;
+}
+
+GDSQLITE_AVX2_TARGET static void cosine_terms_avx2(const void *p_a,
+                                                   const void *p_b, int p_n,
+                                                   float &r_dot,
+                                                   float &r_norm_a,
+                                                   float &r_norm_b) {
+  const float *a = static_cast<const float *>(p_a);
+  const float *b = static_cast<const float *>(p_b);
+  __m256 dot = _mm256_setzero_ps();
+  __m256 norm_a = _mm256_setzero_ps();
+  __m256 norm_b = _mm256_setzero_ps();
+  int i = 0;
+  for (; i + 8 <= p_n; i += 8) {
+    const __m256 va = _mm256_loadu_ps(a + i);
+    const __m256 vb = _mm256_loadu_ps(b + i);
+    dot = _mm256_fmadd_ps(va, vb, dot);
+    norm_a = _mm256_fmadd_ps(va, va, norm_a);
+    norm_b = _mm256_fmadd_ps(vb, vb, norm_b);
+  }
+  r_dot = hsum_avx(dot);
+  r_norm_a = hsum_avx(norm_a);
+  r_norm_b = hsum_avx(norm_b);
+  for (; i < p_n; i++) {
+    const float va = load_f32(p_a, i);
+    const float vb = load_f32(p_b, i);
+    r_dot += va * vb;
+    r_norm_a += va * va;
+    r_norm_b += vb * vb;
+  }
+}
+#endif
+
+// --------------------------------------------------------------------- NEON
+
+#ifdef GDSQLITE_VECTOR_NEON
+static _FORCE_INLINE_ float hsum_neon(float32x4_t p_v) {
+#ifdef __aarch64__
+  return vaddvq_f32(p_v);
+#else
+  const float32x2_t s = vadd_f32(vget_low_f32(p_v), vget_high_f32(p_v));
+  return vget_lane_f32(vpadd_f32(s, s), 0);
+#endif
+}
+
+static float l2_squared_neon(const void *p_a, const void *p_b, int p_n) {
+  const float *a = static_cast<const float *>(p_a);
+  const float *b = static_cast<const float *>(p_b);
+  float32x4_t acc = vdupq_n_f32(0.0f);
+  int i = 0;
+  for (; i + 4 <= p_n; i += 4) {
+    const float32x4_t d = vsubq_f32(vld1q_f32(a + i), vld1q_f32(b + i));
+    acc = vmlaq_f32(acc, d, d);
+  }
+  float sum = hsum_neon(acc);
+  for (; i < p_n; i++) {
+    const float d = load_f32(p_a, i) - load_f32(p_b, i);
+    sum += d * d;
+  }
+  return sum;
+}
+
+static float dot_neon(const void *p_a, const void *p_b, int p_n) {
+  const float *a = static_cast<const float *>(p_a);
+  const float *b = static_cast<const float *>(p_b);
+  float32x4_t acc = vdupq_n_f32(0.0f);
+  int i = 0;
+  for (; i + 4 <= p_n; i += 4) {
+    acc = vmlaq_f32(acc, vld1q_f32(a + i), vld1q_f32(b + i));
+  }
+  float sum = hsum_neon(acc);
+  for (; i < p_n; i++) {
+    sum += load_f32(p_a, i) * load_f32(p_b, i);
+  }
+  return sum;
+}
+
+static void cosine_terms_neon(const void *p_a, const void *p_b, int p_n,
+                              float &r_dot, float &r_norm_a, float &r_norm_b) {
+  const float *a = static_cast<const float *>(p_a);
+  const float *b = static_cast<const float *>(p_b);
+  float32x4_t dot = vdupq_n_f32(0.0f);
+  float32x4_t norm_a = vdupq_n_f32(0.0f);
+  float32x4_t norm_b = vdupq_n_f32(0.0f);
+  int i = 0;
+  for (; i + 4 <= p_n; i += 4) {
+    const float32x4_t va = vld1q_f32(a + i);
+    const float32x4_t vb = vld1q_f32(b + i);
+    dot = vmlaq_f32(dot, va, vb);
+    norm_a = vmlaq_f32(norm_a, va, va);
+    norm_b = vmlaq_f32(norm_b, vb, vb);
+  }
+  r_dot = hsum_neon(dot);
+  r_norm_a = hsum_neon(norm_a);
+  r_norm_b = hsum_neon(norm_b);
+  for (; i < p_n; i++) {
+    const float va = load_f32(p_a, i);
+    const float vb = load_f32(p_b, i);
+    r_dot += va * vb;
+    r_norm_a += va * va;
+    r_norm_b += vb * vb;
+  }
+}
+#endif
+
+// ----------------------------------------------------------------- Dispatch
+
+struct VectorKernels {
+  const char *name;
+  float (*l2_squared)(const void *, const void *, int);
+  float (*dot)(const void *, const void *, int);
+  void (*cosine_terms)(const void *, const void *, int, float &, float &,
+                       float &);
+};
+
+static VectorKernels select_kernels() {
+#ifdef GDSQLITE_VECTOR_AVX2
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) {
+    return {"avx2", l2_squared_avx2, dot_avx2, cosine_terms_avx2};
+  }
+#endif
+#if defined(GDSQLITE_VECTOR_SSE)
+  return {"sse", l2_squared_sse, dot_sse, cosine_terms_sse};
+#elif defined(GDSQLITE_VECTOR_NEON)
+  return {"neon", l2_squared_neon, dot_neon, cosine_terms_neon};
+#else
+  return {"scalar", l2_squared_scalar, dot_scalar, cosine_terms_scalar};
+#endif
+}
+
+static const VectorKernels &get_kernels() {
+  static const VectorKernels kernels = select_kernels();
+  return kernels;
+}
+
+const char *sqlite_vector_kernel_name() { return get_kernels().name; }
+
+static float cosine_distance(const VectorKernels &p_kernels, const void *p_a,
+                             const void *p_b, int p_dims) {
+  float dot, norm_a, norm_b;
+  p_kernels.cosine_terms(p_a, p_b, p_dims, dot, norm_a, norm_b);
+  const float denom = Math::sqrt(norm_a * norm_b);
+  return denom > 0.0f ? 1.0f - dot / denom : 1.0f;
+}
+
+// Same ordering as `sqlite_vector_distance`, but L2 skips the square root.
+static _FORCE_INLINE_ float rank_distance(const VectorKernels &p_kernels,
+                                         SQLiteVectorMetric p_metric,
+                                         const void *p_a, const void *p_b,
+                                         int p_dims) {
+  switch (p_metric) {
+  case SQLITE_VECTOR_METRIC_COSINE:
+    return cosine_distance(p_kernels, p_a, p_b, p_dims);
+  case SQLITE_VECTOR_METRIC_DOT:
+    return -p_kernels.dot(p_a, p_b, p_dims);
+  default:
+    return p_kernels.l2_squared(p_a, p_b, p_dims);
+  }
+}
+
+float sqlite_vector_distance(SQLiteVectorMetric p_metric, const void *p_a,
+                             const void *p_b, int p_dims) {
+  const float d = rank_distance(get_kernels(), p_metric, p_a, p_b, p_dims);
+  return p_metric == SQLITE_VECTOR_METRIC_L2 ? Math::sqrt(d) : d;
+}
+
+// ------------------------------------------------------------ SQL functions
+
+template <SQLiteVectorMetric METRIC>
+static void fn_vec_distance(sqlite3_context *p_ctx, int p_argc,
+                            sqlite3_value **p_argv) {
+  if (sqlite3_value_type(p_argv[0]) == SQLITE_NULL ||
+      sqlite3_value_type(p_argv[1]) == SQLITE_NULL) {
+    sqlite3_result_null(p_ctx);
+    return;
+  }
+  if (sqlite3_value_type(p_argv[0]) != SQLITE_BLOB ||
+      sqlite3_value_type(p_argv[1]) != SQLITE_BLOB) {
+    sqlite3_result_error(p_ctx, "Vectors must be BLOBs of float32 values.",
+                         -1);
+    return;
+  }
+  const void *a = sqlite3_value_blob(p_argv[0]);
+  const void *b = sqlite3_value_blob(p_argv[1]);
+  const int bytes = sqlite3_value_bytes(p_argv[0]);
+  if (bytes != sqlite3_value_bytes(p_argv[1]) || bytes % sizeof(float) != 0) {
+    sqlite3_result_error(p_ctx, "Vectors must have the same dimension.", -1);
+    return;
+  }
+  sqlite3_result_double(
+      p_ctx, sqlite_vector_distance(METRIC, a, b, bytes / sizeof(float)));
+}
+
+static void fn_vec_dims(sqlite3_context *p_ctx, int p_argc,
+                        sqlite3_value **p_argv) {
+  if (sqlite3_value_type(p_argv[0]) != SQLITE_BLOB) {
+    sqlite3_result_null(p_ctx);
+    return;
+  }
+  sqlite3_result_int(p_ctx, sqlite3_value_bytes(p_argv[0]) / sizeof(float));
+}
+
+bool sqlite_register_vector_functions(sqlite3 *p_db) {
+  struct {
+    const char *name;
+    int argc;
+    void (*func)(sqlite3_context *, int, sqlite3_value **);
+  } functions[] = {
+      {"vec_distance_l2", 2, fn_vec_distance<SQLITE_VECTOR_METRIC_L2>},
+      {"vec_distance_cosine", 2, fn_vec_distance<SQLITE_VECTOR_METRIC_COSINE>},
+      {"vec_distance_dot", 2, fn_vec_distance<SQLITE_VECTOR_METRIC_DOT>},
+      {"vec_dims", 1, fn_vec_dims},
+  };
+  const int flags = SQLITE_UTF8 | SQLITE_DETERMINISTIC | SQLITE_INNOCUOUS;
+  for (const auto &f : functions) {
+    const int res = sqlite3_create_function_v2(p_db, f.name, f.argc, flags,
+                                               nullptr, f.func, nullptr,
+                                               nullptr, nullptr);
+    ERR_FAIL_COND_V_MSG(res != SQLITE_OK, false,
+                        "Cannot register the SQL function: " +
+                            String(f.name));
+  }
+  return true;
+}
+
+// ---------------------------------------------------------------------- kNN
+
+struct KnnCandidate {
+  int64_t rowid;
+  float distance;
+};
+
+/// Bounded max-heap: keeps the `capacity` closest candidates seen so far.
+class KnnHeap {
+  LocalVector<KnnCandidate> heap;
+  uint32_t capacity;
+
+  void sift_up(uint32_t p_index) {
+    while (p_index > 0) {
+      const uint32_t parent = (p_index - 1) / 2;
+      if (heap[parent].distance >= heap[p_index].distance) {
+        break;
+      }
+      SWAP(heap[parent], heap[p_index]);
+      p_index = parent;
+    }
+  }
+
+  void sift_down(uint32_t p_index) {
+    const uint32_t size = heap.size();
+    while (true) {
+      uint32_t largest = p_index;
+      const uint32_t l = p_index * 2 + 1;
+      const uint32_t r = l + 1;
+      if (l < size && heap[l].distance > heap[largest].distance) {
+        largest = l;
+      }
+      if (r < size && heap[r].distance > heap[largest].distance) {
+        largest = r;
+      }
+      if (largest == p_index) {
+        break;
+      }
+      SWAP(heap[largest], heap[p_index]);
+      p_index = largest;
+    }
+  }
+
+public:
+  explicit KnnHeap(uint32_t p_capacity) : capacity(p_capacity) {
+    heap.reserve(p_capacity);
+  }
+
+  _FORCE_INLINE_ bool accepts(float p_distance) const {
+    return heap.size() < capacity || p_distance < heap[0].distance;
+  }
+
+  void push(int64_t p_rowid, float p_distance) {
+    if (heap.size() < capacity) {
+      heap.push_back({p_rowid, p_distance});
+      sift_up(heap.size() - 1);
+    } else if (p_distance < heap[0].distance) {
+      heap[0] = {p_rowid, p_distance};
+      sift_down(0);
+    }
+  }
+
+  /// Empties the heap, returning the candidates closest first.
+  LocalVector<KnnCandidate> take_sorted() {
+    LocalVector<KnnCandidate> sorted;
+    sorted.resize(heap.size());
+    for (uint32_t i = sorted.size(); i > 0; i -= 1) {
+      sorted[i - 1] = heap[0];
+      heap[0] = heap[heap.size() - 1];
+      heap.resize(heap.size() - 1);
+      sift_down(0);
+    }
+    return sorted;
+  }
+};
+
+static String index_centroids_table(const String &p_table,
+                                    const String &p_column) {
+  return p_table + "_" + p_column + "_ivf_centroids";
+}
+
+static String index_lists_table(const String &p_table,
+                                const String &p_column) {
+  return p_table + "_" + p_column + "_ivf_lists";
+}
+
+static String index_info_table(const String &p_table,
+                               const String &p_column) {
+  return p_table + "_" + p_column + "_ivf_info";
+}
+
+static bool table_exists(sqlite3 *p_db, const String &p_name) {
+  sqlite3_stmt *stmt = nullptr;
+  if (sqlite3_prepare_v2(p_db,
+                         "SELECT 1 FROM sqlite_master WHERE type = 'table' "
+                         "AND name = ?;",
+                         -1, &stmt, nullptr) != SQLITE_OK) {
+    return false;
+  }
+  const CharString name = p_name.utf8();
+  sqlite3_bind_text(stmt, 1, name.get_data(), name.length(), SQLITE_STATIC);
+  const bool exists = sqlite3_step(stmt) == SQLITE_ROW;
+  sqlite3_finalize(stmt);
+  return exists;
+}
+
+static sqlite3_stmt *prepare_or_print(sqlite3 *p_db, const String &p_sql) {
+  sqlite3_stmt *stmt = nullptr;
+  const int res =
+      sqlite3_prepare_v2(p_db, p_sql.utf8().get_data(), -1, &stmt, nullptr);
+  ERR_FAIL_COND_V_MSG(res != SQLITE_OK, nullptr,
+                      "SQL Error: " + String(sqlite3_errmsg(p_db)));
+  return stmt;
+}
+
+/// Whether rows were inserted in `p_table` after its index was built. They
+/// are in no list, so a search of the index would never return them.
+static bool has_unindexed_rows(sqlite3 *p_db, const String &p_table,
+                               const String &p_column) {
+  sqlite3_stmt *stmt = nullptr;
+  const String sql =
+      "SELECT EXISTS (SELECT 1 FROM " + SQLite::quote_identifier(p_table) +
+      " WHERE rowid > (SELECT max_rowid FROM " +
+      SQLite::quote_identifier(index_info_table(p_table, p_column)) + "));";
+  if (sqlite3_prepare_v2(p_db, sql.utf8().get_data(), -1, &stmt, nullptr) !=
+      SQLITE_OK) {
+    // No info: an index built by an older version, its state is unknown.
+    return true;
+  }
+  const bool found =
+      sqlite3_step(stmt) == SQLITE_ROW && sqlite3_column_int(stmt, 0) != 0;
+  sqlite3_finalize(stmt);
+  return found;
+}
+
+static int64_t count_rows(sqlite3 *p_db, const String &p_table) {
+  sqlite3_stmt *stmt = prepare_or_print(
+      p_db, "SELECT count(*) FROM " + SQLite::quote_identifier(p_table) + ";");
+  ERR_FAIL_COND_V(stmt == nullptr, -1);
+  const int64_t count =
+      sqlite3_step(stmt) == SQLITE_ROW ? sqlite3_column_int64(stmt, 0) : -1;
+  sqlite3_finalize(stmt);
+  return count;
+}
+
+/// Steps `p_stmt`, which yields `(rowid, vector)` rows, into `r_heap`.
+/// Rows whose vector doesn't have the query dimension are skipped.
+static bool knn_scan(sqlite3_stmt *p_stmt, const VectorKernels &p_kernels,
+                     SQLiteVectorMetric p_metric, const float *p_query,
+                     int p_dims, KnnHeap &r_heap) {
+  const int bytes = p_dims * sizeof(float);
+  while (true) {
+    const int res = sqlite3_step(p_stmt);
+    if (res == SQLITE_DONE) {
+      return true;
+    }
+    if (res != SQLITE_ROW) {
+      return false;
+    }
+    const void *vector = sqlite3_column_blob(p_stmt, 1);
+    if (vector == nullptr || sqlite3_column_bytes(p_stmt, 1) != bytes) {
+      continue;
+    }
+    const float d = rank_distance(p_kernels, p_metric, vector, p_query, p_dims);
+    if (r_heap.accepts(d)) {
+      r_heap.push(sqlite3_column_int64(p_stmt, 0), d);
+    }
+  }
+}
+
+// Above this `k`, knn() clamps it to the row count.
+static const int KNN_COUNTED_K = 1024;
+
+Array sqlite_vector_knn(sqlite3 *p_db, const String &p_table,
+                        const String &p_column,
+                        const PackedFloat32Array &p_query, int p_k,
+                        SQLiteVectorMetric p_metric, int p_probes) {
+  ERR_FAIL_COND_V(p_db == nullptr, Array());
+  ERR_FAIL_COND_V(p_k <= 0, Array());
+  ERR_FAIL_COND_V_MSG(p_query.is_empty(), Array(), "The query is empty.");
+
+  // The heap is allocated for `p_k` rows: counting the rows costs less than
+  // the distances, and avoids allocating for rows which don't exist.
+  if (p_k > KNN_COUNTED_K) {
+    const int64_t rows = count_rows(p_db, p_table);
+    ERR_FAIL_COND_V(rows < 0, Array());
+    p_k = MAX(int64_t(1), MIN(int64_t(p_k), rows));
+  }
+
+  const VectorKernels &kernels = get_kernels();
+  const float *query = p_query.ptr();
+  const int dims = p_query.size();
+  KnnHeap heap(p_k);
+
+  const String centroids_table = index_centroids_table(p_table, p_column);
+  bool use_index = p_probes > 0 && table_exists(p_db, centroids_table);
+  if (use_index && has_unindexed_rows(p_db, p_table, p_column)) {
+    WARN_PRINT_ONCE("Rows were inserted in `" + p_table +
+                    "` since its vector index was built, the whole table is "
+                    "scanned instead. Call `create_vector_index()` again.");
+    use_index = false;
+  }
+  if (use_index) {
+    // Like `p_k`, the heap is allocated for the lists which exist.
+    const int64_t list_count = count_rows(p_db, centroids_table);
+    ERR_FAIL_COND_V(list_count < 0, Array());
+    p_probes = MAX(int64_t(1), MIN(int64_t(p_probes), list_count));
+
+    // Pick the `p_probes` lists whose centroid is the closest to the query,
+    // by the metric of the search: the cosine distance ignores the norm of
+    // the centroids.
+    sqlite3_stmt *stmt = prepare_or_print(
+        p_db, "SELECT list, centroid FROM " +
+                  SQLite::quote_identifier(centroids_table) + ";");
+    ERR_FAIL_COND_V(stmt == nullptr, Array());
+    KnnHeap lists(p_probes);
+    const bool ok = knn_scan(stmt, kernels, p_metric, query, dims, lists);
+    sqlite3_finalize(stmt);
+    ERR_FAIL_COND_V_MSG(!ok, Array(),
+                        "SQL Error: " + String(sqlite3_errmsg(p_db)));
+
+    stmt = prepare_or_print(
+        p_db, "SELECT t.rowid, t." + SQLite::quote_identifier(p_column) +
+                  " FROM " +
+                  SQLite::quote_identifier(
+                      index_lists_table(p_table, p_column)) +
+                  " AS l JOIN " + SQLite::quote_identifier(p_table) +
+                  " AS t ON t.rowid = l.id WHERE l.list = ?;");
+    ERR_FAIL_COND_V(stmt == nullptr, Array());
+    const LocalVector<KnnCandidate> probed = lists.take_sorted();
+    for (const KnnCandidate &list : probed) {
+      sqlite3_bind_int64(stmt, 1, list.rowid);
+      if (!knn_scan(stmt, kernels, p_metric, query, dims, heap)) {
+        sqlite3_finalize(stmt);
+        ERR_FAIL_V_MSG(Array(), "SQL Error: " + String(sqlite3_errmsg(p_db)));
+      }
+      sqlite3_reset(stmt);
+    }
+    sqlite3_finalize(stmt);
+  } else {
+    sqlite3_stmt *stmt = prepare_or_print(
+        p_db, "SELECT rowid, " + SQLite::quote_identifier(p_column) +
+                  " FROM " + SQLite::quote_identifier(p_table) + ";");
+    ERR_FAIL_COND_V(stmt == nullptr, Array());
+    const bool ok = knn_scan(stmt, kernels, p_metric, query, dims, heap);
+    sqlite3_finalize(stmt);
+    ERR_FAIL_COND_V_MSG(!ok, Array(),
+                        "SQL Error: " + String(sqlite3_errmsg(p_db)));
+  }
+
+  const LocalVector<KnnCandidate> found = heap.take_sorted();
+  Array result;
+  result.resize(found.size());
+  for (uint32_t i = 0; i < found.size(); i += 1) {
+    Dictionary row;
+    row["rowid"] = found[i].rowid;
+    row["distance"] = p_metric == SQLITE_VECTOR_METRIC_L2
+                          ? Math::sqrt(found[i].distance)
+                          : found[i].distance;
+    result[i] = row;
+  }
+  return result;
+}
+
+// -------------------------------------------------------------- IVF index
+
+static bool exec_or_print(sqlite3 *p_db, const String &p_sql) {
+  char *err = nullptr;
+  const int res = sqlite3_exec(p_db, p_sql.utf8().get_data(), nullptr,
+                               nullptr, &err);
+  if (res != SQLITE_OK) {
+    ERR_PRINT("SQL Error: " + String(err ? err : sqlite3_errmsg(p_db)));
+    sqlite3_free(err);
+    return false;
+  }
+  return true;
+}
+
+static uint32_t nearest_centroid(const VectorKernels &p_kernels,
+                                 const float *p_centroids, uint32_t p_count,
+                                 const void *p_vector, int p_dims) {
+  uint32_t best = 0;
+  float best_distance = Math_INF;
+  for (uint32_t c = 0; c < p_count; c += 1) {
+    const float d =
+        p_kernels.l2_squared(p_centroids + c * p_dims, p_vector, p_dims);
+    if (d < best_distance) {
+      best_distance = d;
+      best = c;
+    }
+  }
+  return best;
+}
+
+/// Runs k-means on a sample of the column and returns the centroids.
+static bool train_centroids(sqlite3 *p_db, const String &p_table,
+                            const String &p_column, int p_lists,
+                            int p_iterations, int &r_dims,
+                            LocalVector<float> &r_centroids) {
+  const String column = SQLite::quote_identifier(p_column);
+  const String from = " FROM " + SQLite::quote_identifier(p_table) +
+                      " WHERE " + column + " IS NOT NULL";
+
+  sqlite3_stmt *stmt =
+      prepare_or_print(p_db, "SELECT count(*), length(" + column + ")" + from +
+                                 " LIMIT 1;");
+  ERR_FAIL_COND_V(stmt == nullptr, false);
+  int64_t count = 0;
+  int bytes = 0;
+  if (sqlite3_step(stmt) == SQLITE_ROW) {
+    count = sqlite3_column_int64(stmt, 0);
+    bytes = sqlite3_column_int(stmt, 1);
+  }
+  sqlite3_finalize(stmt);
+  ERR_FAIL_COND_V_MSG(count == 0 || bytes == 0 || bytes % sizeof(float) != 0,
+                      false, "The column doesn't contain float32 vectors.");
+
+  r_dims = bytes / sizeof(float);
+  const uint32_t lists = MIN(int64_t(p_lists), count);
+
+  // Training on ~64 vectors per list is plenty for an IVF index, and keeps
+  // the build time independent of the table size.
+  const int64_t sample_target = MIN(count, int64_t(lists) * 64);
+  const int64_t stride = MAX(int64_t(1), count / sample_target);
+
+  LocalVector<float> samples;
+  samples.reserve(sample_target * r_dims);
+  stmt = prepare_or_print(p_db, "SELECT " + column + from + ";");
+  ERR_FAIL_COND_V(stmt == nullptr, false);
+  int64_t row = 0;
+  uint32_t sample_count = 0;
+  while (sqlite3_step(stmt) == SQLITE_ROW && sample_count < sample_target) {
+    if (row++ % stride != 0 || sqlite3_column_bytes(stmt, 0) != bytes) {
+      continue;
+    }
+    samples.resize(samples.size() + r_dims);
+    memcpy(samples.ptr() + sample_count * r_dims, sqlite3_column_blob(stmt, 0),
+           bytes);
+    sample_count += 1;
+  }
+  sqlite3_finalize(stmt);
+  ERR_FAIL_COND_V(sample_count < lists, false);
+
+  // Deterministic initialization: evenly spaced samples.
+  r_centroids.resize(lists * r_dims);
+  for (uint32_t c = 0; c < lists; c += 1) {
+    memcpy(r_centroids.ptr() + c * r_dims,
+           samples.ptr() + (uint64_t(c) * sample_count / lists) * r_dims,
+           bytes);
+  }
+
+  const VectorKernels &kernels = get_kernels();
+  LocalVector<double> sums;
+  LocalVector<uint32_t> counts;
+  sums.resize(lists * r_dims);
+  counts.resize(lists);
+  for (int it = 0; it < p_iterations; it += 1) {
+    memset(sums.ptr(), 0, sums.size() * sizeof(double));
+    memset(counts.ptr(), 0, counts.size() * sizeof(uint32_t));
+    for (uint32_t s = 0; s < sample_count; s += 1) {
+      const float *sample = samples.ptr() + s * r_dims;
+      const uint32_t c =
+          nearest_centroid(kernels, r_centroids.ptr(), lists, sample, r_dims);
+      counts[c] += 1;
+      double *sum = sums.ptr() + c * r_dims;
+      for (int d = 0; d < r_dims; d += 1) {
+        sum[d] += sample[d];
+      }
+    }
+    for (uint32_t c = 0; c < lists; c += 1) {
+      // An empty list keeps its previous centroid.
+      if (counts[c] == 0) {
+        continue;
+      }
+      for (int d = 0; d < r_dims; d += 1) {
+        r_centroids[c * r_dims + d] = sums[c * r_dims + d] / counts[c];
+      }
+    }
+  }
+  return true;
+}
+
+static bool fill_index(sqlite3 *p_db, const String &p_table,
+                       const String &p_column,
+                       const LocalVector<float> &p_centroids, int p_dims) {
+  const String centroids_table =
+      SQLite::quote_identifier(index_centroids_table(p_table, p_column));
+  const String lists_table =
+      SQLite::quote_identifier(index_lists_table(p_table, p_column));
+  const String info_table =
+      SQLite::quote_identifier(index_info_table(p_table, p_column));
+  const uint32_t lists = p_centroids.size() / p_dims;
+  const int bytes = p_dims * sizeof(float);
+
+  if (!exec_or_print(p_db, "DROP TABLE IF EXISTS " + centroids_table + ";" +
+                               "DROP TABLE IF EXISTS " + lists_table + ";" +
+                               "DROP TABLE IF EXISTS " + info_table + ";" +
+                               "CREATE TABLE " + centroids_table +
+                               " (list INTEGER PRIMARY KEY, centroid BLOB);" +
+                               "CREATE TABLE " + lists_table +
+                               " (list INTEGER, id INTEGER, PRIMARY KEY "
+                               "(list, id)) WITHOUT ROWID;" +
+                               "CREATE TABLE " + info_table +
+                               " (max_rowid INTEGER);")) {
+    return false;
+  }
+
+  sqlite3_stmt *insert = prepare_or_print(
+      p_db, "INSERT INTO " + centroids_table + " VALUES (?, ?);");
+  ERR_FAIL_COND_V(insert == nullptr, false);
+  for (uint32_t c = 0; c < lists; c += 1) {
+    sqlite3_bind_int64(insert, 1, c);
+    sqlite3_bind_blob(insert, 2, p_centroids.ptr() + c * p_dims, bytes,
+                      SQLITE_STATIC);
+    if (sqlite3_step(insert) != SQLITE_DONE) {
+      sqlite3_finalize(insert);
+      ERR_FAIL_V_MSG(false, "SQL Error: " + String(sqlite3_errmsg(p_db)));
+    }
+    sqlite3_reset(insert);
+  }
+  sqlite3_finalize(insert);
+
+  sqlite3_stmt *select = prepare_or_print(
+      p_db, "SELECT rowid, " + SQLite::quote_identifier(p_column) + " FROM " +
+                SQLite::quote_identifier(p_table) + ";");
+  ERR_FAIL_COND_V(select == nullptr, false);
+  insert = prepare_or_print(p_db,
+                            "INSERT INTO " + lists_table + " VALUES (?, ?);");
+  if (insert == nullptr) {
+    sqlite3_finalize(select);
+    return false;
+  }
+
+  const VectorKernels &kernels = get_kernels();
+  bool ok = true;
+  int64_t max_rowid = 0;
+  while (ok && sqlite3_step(select) == SQLITE_ROW) {
+    max_rowid = MAX(max_rowid, sqlite3_column_int64(select, 0));
+    const void *vector = sqlite3_column_blob(select, 1);
+    if (vector == nullptr || sqlite3_column_bytes(select, 1) != bytes) {
+      continue;
+    }
+    const uint32_t c =
+        nearest_centroid(kernels, p_centroids.ptr(), lists, vector, p_dims);
+    sqlite3_bind_int64(insert, 1, c);
+    sqlite3_bind_int64(insert, 2, sqlite3_column_int64(select, 0));
+    ok = sqlite3_step(insert) == SQLITE_DONE;
+    sqlite3_reset(insert);
+  }
+  if (!ok) {
+    ERR_PRINT("SQL Error: " + String(sqlite3_errmsg(p_db)));
+  }
+  sqlite3_finalize(insert);
+  sqlite3_finalize(select);
+  return ok && exec_or_print(p_db, "INSERT INTO " + info_table + " VALUES (" +
+                                       itos(max_rowid) + ");");
+}
+
+bool sqlite_vector_create_index(sqlite3 *p_db, const String &p_table,
+                                const String &p_column, int p_lists,
+                                int p_iterations) {
+  ERR_FAIL_COND_V(p_db == nullptr, false);
+  ERR_FAIL_COND_V(p_lists <= 0 || p_iterations < 0, false);
+
+  int dims = 0;
+  LocalVector<float> centroids;
+  if (!train_centroids(p_db, p_table, p_column, p_lists, p_iterations, dims,
+                       centroids)) {
+    return false;
+  }
+
+  // A savepoint, so this also works inside a user transaction.
+  if (!exec_or_print(p_db, "SAVEPOINT gdsqlite_vector_index;")) {
+    return false;
+  }
+  if (!fill_index(p_db, p_table, p_column, centroids, dims)) {
+    exec_or_print(p_db, "ROLLBACK TO gdsqlite_vector_index;"
+                        "RELEASE gdsqlite_vector_index;");
+    return false;
+  }
+  return exec_or_print(p_db, "RELEASE gdsqlite_vector_index;");
+}
+
+bool sqlite_vector_drop_index(sqlite3 *p_db, const String &p_table,
+                              const String &p_column) {
+  ERR_FAIL_COND_V(p_db == nullptr, false);
+  return exec_or_print(
+      p_db, "DROP TABLE IF EXISTS " +
+                SQLite::quote_identifier(
+                    index_centroids_table(p_table, p_column)) +
+                ";DROP TABLE IF EXISTS " +
+                SQLite::quote_identifier(index_lists_table(p_table, p_column)) +
+                ";DROP TABLE IF EXISTS " +
+                SQLite::quote_identifier(index_info_table(p_table, p_column)) +
+                ";");
+}
@@ -0,0 +1,52 @@
+#ifndef GDSQLITE_VECTOR_H
+#define GDSQLITE_VECTOR_H
+
+#include "core/variant/array.h"
+#include "core/variant/variant.h"
+
+#include "thirdparty/sqlite/sqlite3.h"
+
+/// Vectors are stored as BLOBs of packed float32 values, which is what
+/// `PackedFloat32Array.to_byte_array()` produces.
+enum SQLiteVectorMetric {
+  SQLITE_VECTOR_METRIC_L2,
+  SQLITE_VECTOR_METRIC_COSINE,
+  SQLITE_VECTOR_METRIC_DOT,
+};
+
+/// Distance between two float32 vectors of `p_dims` elements, using the
+/// fastest kernel available on this CPU (AVX2, SSE, NEON or scalar).
+/// Smaller is closer for every metric: `DOT` returns the negated dot product.
+float sqlite_vector_distance(SQLiteVectorMetric p_metric, const void *p_a,
+                             const void *p_b, int p_dims);
+
+/// Name of the kernel set selected at runtime, for diagnostics.
+const char *sqlite_vector_kernel_name();
+
+/// Registers `vec_distance_l2`, `vec_distance_cosine`, `vec_distance_dot`
+/// and `vec_dims` on the connection.
+bool sqlite_register_vector_functions(sqlite3 *p_db);
+
+/// Returns the `p_k` rows of `p_table` closest to `p_query` as an Array of
+/// `{ "rowid": int, "distance": float }`, sorted by distance.
+/// When an IVF index built by `sqlite_vector_create_index` exists, only the
+/// `p_probes` lists closest by `p_metric` are scanned, at most all of them;
+/// pass 0 to force a full scan. The whole table is also scanned, with a
+/// warning, once rows were inserted after the index was built.
+Array sqlite_vector_knn(sqlite3 *p_db, const String &p_table,
+                        const String &p_column,
+                        const PackedFloat32Array &p_query, int p_k,
+                        SQLiteVectorMetric p_metric, int p_probes);
+
+/// Builds an IVF (inverted file) index: the vectors are clustered in
+/// `p_lists` groups with k-means, and each row is assigned to its closest
+/// centroid. The index is a snapshot: rebuild it after large changes, and
+/// after updating vectors, which isn't detected.
+bool sqlite_vector_create_index(sqlite3 *p_db, const String &p_table,
+                                const String &p_column, int p_lists,
+                                int p_iterations);
+
+bool sqlite_vector_drop_index(sqlite3 *p_db, const String &p_table,
+                              const String &p_column);
+
+#endif
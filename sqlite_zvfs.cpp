@@ -0,0 +1,377 @@
+#include "sqlite_zvfs.h"
+
+#include "core/config/project_settings.h"
+#include "core/io/file_access.h"
+#include "core/io/marshalls.h"
+#include "core/templates/local_vector.h"
+
+// File layout, little endian:
+//   header:  magic (8 bytes), version, compression mode, group size,
+//            group count (uint32 each), database size (uint64)
+//   index:   offset (uint64) and compressed size (uint32) of each group
+//   groups:  compressed data
+static const uint8_t ZVFS_MAGIC[8] = {'G', 'D', 'S', 'Q', 'L', 'Z', 'V', 'F'};
+static const uint32_t ZVFS_VERSION = 1;
+static const int ZVFS_HEADER_SIZE = 32;
+static const int ZVFS_INDEX_ENTRY_SIZE = 12;
+
+static sqlite3_vfs zvfs;
+static int cached_groups = 16;
+
+struct ZGroup {
+  uint64_t offset = 0;
+  uint32_t size = 0;
+};
+
+struct ZCachedGroup {
+  int64_t index = -1;
+  uint64_t last_use = 0;
+  Vector<uint8_t> data;
+};
+
+struct ZFile {
+  // First member: SQLite only sees this part.
+  sqlite3_file base;
+  Ref<FileAccess> file;
+  Compression::Mode mode = Compression::MODE_ZSTD;
+  int64_t group_size = 0;
+  int64_t database_size = 0;
+  LocalVector<ZGroup> groups;
+  LocalVector<ZCachedGroup> cache;
+  uint64_t use_count = 0;
+  Vector<uint8_t> compressed;
+};
+
+// Returns the decompressed group, or nullptr on error.
+static const uint8_t *zfile_group(ZFile *p_file, int64_t p_index) {
+  p_file->use_count += 1;
+  ZCachedGroup *slot = nullptr;
+  for (ZCachedGroup &cached : p_file->cache) {
+    if (cached.index == p_index) {
+      cached.last_use = p_file->use_count;
+      return cached.data.ptr();
+    }
+    if (slot == nullptr || cached.last_use < slot->last_use) {
+      slot = &cached;
+    }
+  }
+
+  const ZGroup &group = p_file->groups[p_index];
+  p_file->compressed.resize(group.size);
+  p_file->file->seek(group.offset);
+  if (p_file->file->get_buffer(p_file->compressed.ptrw(), group.size) !=
+      group.size) {
+    return nullptr;
+  }
+
+  const int64_t expected = MIN(p_file->group_size,
+                               p_file->database_size -
+                                   p_index * p_file->group_size);
+  slot->index = -1;
+  slot->data.resize(p_file->group_size);
+  const int size =
+      Compression::decompress(slot->data.ptrw(), expected,
+                              p_file->compressed.ptr(), group.size,
+                              p_file->mode);
+  if (size != expected) {
+    return nullptr;
+  }
+  slot->index = p_index;
+  slot->last_use = p_file->use_count;
+  return slot->data.ptr();
+}
+
+static int zfile_close(sqlite3_file *p_file) {
+  reinterpret_cast<ZFile *>(p_file)->~ZFile();
+  return SQLITE_OK;
+}
+
+static int zfile_read(sqlite3_file *p_file, void *p_buffer, int p_amount,
+                      sqlite3_int64 p_offset) {
+  ZFile *file = reinterpret_cast<ZFile *>(p_file);
+  uint8_t *buffer = static_cast<uint8_t *>(p_buffer);
+
+  int64_t offset = p_offset;
+  int64_t remaining = p_amount;
+  while (remaining > 0 && offset < file->database_size) {
+    const int64_t index = offset / file->group_size;
+    const int64_t start = offset - index * file->group_size;
+    const int64_t available =
+        MIN(file->group_size, file->database_size - index * file->group_size) -
+        start;
+    const int64_t count = MIN(remaining, available);
+
+    const uint8_t *group = zfile_group(file, index);
+    if (group == nullptr) {
+      return SQLITE_IOERR_READ;
+    }
+    memcpy(buffer, group + start, count);
+    buffer += count;
+    offset += count;
+    remaining -= count;
+  }
+
+  if (remaining > 0) {
+    // SQLite requires the missing part to be zeroed.
+    memset(buffer, 0, remaining);
+    return SQLITE_IOERR_SHORT_READ;
+  }
+  return SQLITE_OK;
+}
+
+static int zfile_write(sqlite3_file *p_file, const void *p_buffer,
+                       int p_amount, sqlite3_int64 p_offset) {
+  return SQLITE_READONLY;
+}
+
+static int zfile_truncate(sqlite3_file *p_file, sqlite3_int64 p_size) {
+  return SQLITE_READONLY;
+}
+
+static int zfile_sync(sqlite3_file *p_file, int p_flags) { return SQLITE_OK; }
+
+static int zfile_file_size(sqlite3_file *p_file, sqlite3_int64 *r_size) {
+  *r_size = reinterpret_cast<ZFile *>(p_file)->database_size;
+  return SQLITE_OK;
+}
+
+// The file can't change, so there is nothing to lock.
+static int zfile_lock(sqlite3_file *p_file, int p_lock) { return SQLITE_OK; }
+
+static int zfile_unlock(sqlite3_file *p_file, int p_lock) { return SQLITE_OK; }
+
+static int zfile_check_reserved_lock(sqlite3_file *p_file, int *r_reserved) {
+  *r_reserved = 0;
+  return SQLITE_OK;
+}
+
+static int zfile_file_control(sqlite3_file *p_file, int p_op, void *p_arg) {
+  return SQLITE_NOTFOUND;
+}
+
+static int zfile_sector_size(sqlite3_file *p_file) { return 4096; }
+
+static int zfile_device_characteristics(sqlite3_file *p_file) {
+  return SQLITE_IOCAP_IMMUTABLE;
+}
+
+static const sqlite3_io_methods zfile_methods = {
+    1,                            // iVersion: no WAL.
+    zfile_close,                  // xClose
+    zfile_read,                   // xRead
+    zfile_write,                  // xWrite
+    zfile_truncate,               // xTruncate
+    zfile_sync,                   // xSync
+    zfile_file_size,              // xFileSize
+    zfile_lock,                   // xLock
+    zfile_unlock,                 // xUnlock
+    zfile_check_reserved_lock,    // xCheckReservedLock
+    zfile_file_control,           // xFileControl
+    zfile_sector_size,            // xSectorSize
+    zfile_device_characteristics, // xDeviceCharacteristics
+    nullptr,                      // xShmMap
+    nullptr,                      // xShmLock
+    nullptr,                      // xShmBarrier
+    nullptr,                      // xShmUnmap
+    nullptr,                      // xFetch
+    nullptr,                      // xUnfetch
+};
+
+static bool zfile_load(ZFile *p_file, const String &p_path) {
+  p_file->file = FileAccess::open(p_path, FileAccess::READ);
+  if (p_file->file.is_null()) {
+    return false;
+  }
+
+  uint8_t header[ZVFS_HEADER_SIZE];
+  if (p_file->file->get_buffer(header, ZVFS_HEADER_SIZE) != ZVFS_HEADER_SIZE ||
+      memcmp(header, ZVFS_MAGIC, sizeof(ZVFS_MAGIC)) != 0) {
+    return false;
+  }
+  ERR_FAIL_COND_V_MSG(decode_uint32(header + 8) != ZVFS_VERSION, false,
+                      "Unsupported compressed database version: " + p_path);
+  p_file->mode = Compression::Mode(decode_uint32(header + 12));
+  p_file->group_size = decode_uint32(header + 16);
+  const uint32_t group_count = decode_uint32(header + 20);
+  p_file->database_size = decode_uint64(header + 24);
+  if (p_file->group_size <= 0 ||
+      group_count != (p_file->database_size + p_file->group_size - 1) /
+                         p_file->group_size) {
+    return false;
+  }
+
+  Vector<uint8_t> index;
+  index.resize(group_count * ZVFS_INDEX_ENTRY_SIZE);
+  if (p_file->file->get_buffer(index.ptrw(), index.size()) !=
+      uint64_t(index.size())) {
+    return false;
+  }
+  p_file->groups.resize(group_count);
+  for (uint32_t i = 0; i < group_count; i += 1) {
+    const uint8_t *entry = index.ptr() + i * ZVFS_INDEX_ENTRY_SIZE;
+    p_file->groups[i].offset = decode_uint64(entry);
+    p_file->groups[i].size = decode_uint32(entry + 8);
+  }
+  p_file->cache.resize(MAX(cached_groups, 1));
+  return true;
+}
+
+static int zvfs_open(sqlite3_vfs *p_vfs, const char *p_name,
+                     sqlite3_file *r_file, int p_flags, int *r_out_flags) {
+  sqlite3_vfs *parent = static_cast<sqlite3_vfs *>(p_vfs->pAppData);
+  if (!(p_flags & SQLITE_OPEN_MAIN_DB)) {
+    // Temporary files, for sorting or temporary tables.
+    return parent->xOpen(parent, p_name, r_file, p_flags, r_out_flags);
+  }
+
+  ZFile *file = memnew_placement(r_file, ZFile);
+  if (!zfile_load(file, String::utf8(p_name))) {
+    file->~ZFile();
+    // SQLite calls xClose only when the open succeeds.
+    r_file->pMethods = nullptr;
+    return SQLITE_CANTOPEN;
+  }
+  file->base.pMethods = &zfile_methods;
+  if (r_out_flags != nullptr) {
+    *r_out_flags = SQLITE_OPEN_READONLY | SQLITE_OPEN_MAIN_DB;
+  }
+  return SQLITE_OK;
+}
+
+static int zvfs_delete(sqlite3_vfs *p_vfs, const char *p_name, int p_sync) {
+  sqlite3_vfs *parent = static_cast<sqlite3_vfs *>(p_vfs->pAppData);
+  return parent->xDelete(parent, p_name, p_sync);
+}
+
+static int zvfs_access(sqlite3_vfs *p_vfs, const char *p_name, int p_flags,
+                       int *r_result) {
+  // Journals never exist: the database is read only.
+  *r_result = 0;
+  return SQLITE_OK;
+}
+
+static int zvfs_full_pathname(sqlite3_vfs *p_vfs, const char *p_name,
+                              int p_size, char *r_name) {
+  // Keeps `res://` paths as they are, FileAccess resolves them.
+  sqlite3_snprintf(p_size, r_name, "%s", p_name);
+  return SQLITE_OK;
+}
+
+static int zvfs_randomness(sqlite3_vfs *p_vfs, int p_size, char *r_buffer) {
+  sqlite3_vfs *parent = static_cast<sqlite3_vfs *>(p_vfs->pAppData);
+  return parent->xRandomness(parent, p_size, r_buffer);
+}
+
+static int zvfs_sleep(sqlite3_vfs *p_vfs, int p_microseconds) {
+  sqlite3_vfs *parent = static_cast<sqlite3_vfs *>(p_vfs->pAppData);
+  return parent->xSleep(parent, p_microseconds);
+}
+
+static int zvfs_current_time(sqlite3_vfs *p_vfs, double *r_time) {
+  sqlite3_vfs *parent = static_cast<sqlite3_vfs *>(p_vfs->pAppData);
+  return parent->xCurrentTime(parent, r_time);
+}
+
+static int zvfs_get_last_error(sqlite3_vfs *p_vfs, int p_size, char *r_error) {
+  sqlite3_vfs *parent = static_cast<sqlite3_vfs *>(p_vfs->pAppData);
+  return parent->xGetLastError(parent, p_size, r_error);
+}
+
+static int zvfs_current_time_int64(sqlite3_vfs *p_vfs, sqlite3_int64 *r_time) {
+  sqlite3_vfs *parent = static_cast<sqlite3_vfs *>(p_vfs->pAppData);
+  return parent->xCurrentTimeInt64(parent, r_time);
+}
+
+void sqlite_zvfs_initialize() {
+  cached_groups = GLOBAL_DEF("sqlite/compressed/cached_groups", 16);
+
+  sqlite3_vfs *parent = sqlite3_vfs_find(nullptr);
+  ERR_FAIL_COND_MSG(parent == nullptr, "SQLite has no default VFS.");
+  memset(&zvfs, 0, sizeof(zvfs));
+  zvfs.iVersion = 2;
+  // Temporary files are opened by the default VFS in the same memory.
+  zvfs.szOsFile = MAX(int(sizeof(ZFile)), parent->szOsFile);
+  zvfs.mxPathname = parent->mxPathname;
+  zvfs.zName = SQLITE_ZVFS_NAME;
+  zvfs.pAppData = parent;
+  zvfs.xOpen = zvfs_open;
+  zvfs.xDelete = zvfs_delete;
+  zvfs.xAccess = zvfs_access;
+  zvfs.xFullPathname = zvfs_full_pathname;
+  zvfs.xRandomness = zvfs_randomness;
+  zvfs.xSleep = zvfs_sleep;
+  zvfs.xCurrentTime = zvfs_current_time;
+  zvfs.xGetLastError = zvfs_get_last_error;
+  zvfs.xCurrentTimeInt64 = zvfs_current_time_int64;
+  sqlite3_vfs_register(&zvfs, 0);
+}
+
+bool sqlite_zvfs_is_compressed(const String &p_path) {
+  Ref<FileAccess> file = FileAccess::open(p_path, FileAccess::READ);
+  if (file.is_null()) {
+    return false;
+  }
+  uint8_t magic[sizeof(ZVFS_MAGIC)];
+  return file->get_buffer(magic, sizeof(magic)) == sizeof(magic) &&
+         memcmp(magic, ZVFS_MAGIC, sizeof(magic)) == 0;
+}
+
+Vector<uint8_t> sqlite_zvfs_compress(const Vector<uint8_t> &p_database,
+                                     Compression::Mode p_mode,
+                                     int p_group_size) {
+  ERR_FAIL_COND_V_MSG(p_group_size < 4096 || p_group_size > 16777216 ||
+                          (p_group_size & (p_group_size - 1)) != 0,
+                      Vector<uint8_t>(),
+                      "The group size must be a power of two between 4 KiB "
+                      "and 16 MiB.");
+  ERR_FAIL_COND_V_MSG(p_database.size() < 100 ||
+                          memcmp(p_database.ptr(), "SQLite format 3", 16) != 0,
+                      Vector<uint8_t>(), "This isn't an SQLite database.");
+
+  const int64_t database_size = p_database.size();
+  const uint32_t group_count =
+      (database_size + p_group_size - 1) / p_group_size;
+  const int64_t data_offset =
+      ZVFS_HEADER_SIZE + int64_t(group_count) * ZVFS_INDEX_ENTRY_SIZE;
+
+  Vector<uint8_t> first_group;
+  first_group.resize(MIN(database_size, int64_t(p_group_size)));
+  memcpy(first_group.ptrw(), p_database.ptr(), first_group.size());
+  // Read and write versions of the file format: a WAL database (2) needs
+  // shared memory, that this VFS doesn't have.
+  first_group.write[18] = 1;
+  first_group.write[19] = 1;
+
+  Vector<uint8_t> result;
+  result.resize(data_offset);
+  uint8_t *header = result.ptrw();
+  memcpy(header, ZVFS_MAGIC, sizeof(ZVFS_MAGIC));
+  encode_uint32(ZVFS_VERSION, header + 8);
+  encode_uint32(p_mode, header + 12);
+  encode_uint32(p_group_size, header + 16);
+  encode_uint32(group_count, header + 20);
+  encode_uint64(database_size, header + 24);
+
+  Vector<uint8_t> compressed;
+  compressed.resize(
+      Compression::get_max_compressed_buffer_size(p_group_size, p_mode));
+  for (uint32_t i = 0; i < group_count; i += 1) {
+    const int64_t start = int64_t(i) * p_group_size;
+    const int size = MIN(int64_t(p_group_size), database_size - start);
+    const uint8_t *source =
+        i == 0 ? first_group.ptr() : p_database.ptr() + start;
+    const int compressed_size =
+        Compression::compress(compressed.ptrw(), source, size, p_mode);
+    ERR_FAIL_COND_V_MSG(compressed_size < 0, Vector<uint8_t>(),
+                        "Cannot compress the database.");
+
+    const int64_t offset = result.size();
+    uint8_t *entry =
+        result.ptrw() + ZVFS_HEADER_SIZE + i * ZVFS_INDEX_ENTRY_SIZE;
+    encode_uint64(offset, entry);
+    encode_uint32(compressed_size, entry + 8);
+    result.resize(offset + compressed_size);
+    memcpy(result.ptrw() + offset, compressed.ptr(), compressed_size);
+  }
+  return result;
+}
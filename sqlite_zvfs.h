@@ -0,0 +1,29 @@
+#ifndef GDSQLITE_ZVFS_H
+#define GDSQLITE_ZVFS_H
+
+#include "core/io/compression.h"
+#include "core/string/ustring.h"
+#include "core/templates/vector.h"
+
+#include "thirdparty/sqlite/sqlite3.h"
+
+/// Name of the VFS reading compressed databases.
+#define SQLITE_ZVFS_NAME "godot_zvfs"
+
+/// Registers the VFS of compressed databases. A compressed database is
+/// split in groups of pages compressed independently, so SQLite reads it
+/// through `FileAccess` and only decompresses the groups it needs, keeping
+/// the most recently used ones (`sqlite/compressed/cached_groups`).
+void sqlite_zvfs_initialize();
+
+/// Returns true if the file at `p_path` is a compressed database, which
+/// must be opened read only with the `SQLITE_ZVFS_NAME` VFS.
+bool sqlite_zvfs_is_compressed(const String &p_path);
+
+/// Compresses a database file content, in groups of `p_group_size` bytes.
+/// Returns an empty Vector on failure.
+Vector<uint8_t> sqlite_zvfs_compress(const Vector<uint8_t> &p_database,
+                                     Compression::Mode p_mode,
+                                     int p_group_size);
+
+#endif
@@ -492,6 +492,11 @@ void spmemvfs_env_fini()
 }
 
 int spmemvfs_open_db( spmemvfs_db_t * db, const char * path, spmembuffer_t * mem )
+{
+	return spmemvfs_open_db_vfs( db, path, mem, SPMEMVFS_NAME );
+}
+
+int spmemvfs_open_db_vfs( spmemvfs_db_t * db, const char * path, spmembuffer_t * mem, const char * vfs )
 {
 	int ret = 0;
 
@@ -511,7 +516,7 @@ int spmemvfs_open_db( spmemvfs_db_t * db, const char * path, spmembuffer_t * mem
 	sqlite3_mutex_leave( g_spmemvfs_env->mutex );
 
 	ret = sqlite3_open_v2( path, &(db->handle),
-			SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE, SPMEMVFS_NAME );
+			SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE, vfs );
 
 	if( 0 == ret ) {
 		db->mem = mem;
@@ -55,6 +55,9 @@ void spmemvfs_env_fini();
 
 int spmemvfs_open_db( spmemvfs_db_t * db, const char * path, spmembuffer_t * mem );
 
+/* Same as spmemvfs_open_db, through `vfs`: a shim layered over spmemvfs. */
+int spmemvfs_open_db_vfs( spmemvfs_db_t * db, const char * path, spmembuffer_t * mem, const char * vfs );
+
 int spmemvfs_close_db( spmemvfs_db_t * db );
 
 #ifdef __cplusplus